@@ -0,0 +1,332 @@
+/*
+ * node_features_cpuinfo_stress.c
+ *
+ * Concurrent-caller stress benchmark for the node_features/cpuinfo plugin.
+ * slurmd and slurmctld call into the plugin from registration, reconfigure
+ * and RPC handler threads at once, and every entry point that touches the
+ * node snapshot serializes on the plugin's configuration lock.  This
+ * program drives N threads issuing node_features_p_node_state(),
+ * node_features_p_reconfig() and node_features_p_node_xlate() in a
+ * configurable mix and reports per-entry-point latency and lock-wait
+ * percentiles.
+ *
+ * The plugin source is included directly with lock statistics enabled and
+ * the program is linked against the Slurm libraries, so the plugin's
+ * cpuinfo.conf is found alongside the slurm.conf named by SLURM_CONF.
+ *
+ */
+
+#define NODE_FEATURE_CPUINFO_LOCK_STATS
+#include "../node_features_cpuinfo.c"
+
+#include <getopt.h>
+
+/**
+ * @brief   Entry points exercised by the benchmark
+ */
+enum {
+    stress_op_node_state = 0,
+    stress_op_reconfig,
+    stress_op_node_xlate,
+    stress_op_MAX
+};
+
+/**
+ * @brief   Names reported for the stress_op_* entry points
+ */
+static const char* stress_op_strings[] = {
+        "node_state",
+        "reconfig",
+        "node_xlate"
+    };
+
+/**
+ * @brief   Timing of a single call
+ */
+typedef struct stress_sample {
+    uint64_t        latency_ns;     /**< wall time of the call */
+    uint64_t        wait_ns;        /**< time spent waiting for config_mutex */
+} stress_sample_t;
+
+/**
+ * @brief   Per-thread state
+ */
+typedef struct stress_thread {
+    pthread_t       thread;         /**< the thread */
+    unsigned int    seed;           /**< rand_r() state used to pick entry points */
+    size_t          n_samples[stress_op_MAX];   /**< samples collected per entry point */
+    stress_sample_t *samples[stress_op_MAX];    /**< sample arrays, sized for every call */
+} stress_thread_t;
+
+/* Benchmark parameters: */
+static unsigned int stress_n_threads = 8;
+static unsigned int stress_n_calls = 1000;
+static unsigned int stress_weights[stress_op_MAX] = { 8, 1, 8 };
+static unsigned int stress_weight_total = 17;
+
+/* Feature lists presented to node_xlate: */
+static char *stress_new_features = NULL;
+static const char *stress_orig_features = "gpu,bigmem,ib,VENDOR::GenuineIntel,MODEL::OLD,ISA::sse,ISA::sse2,scratch";
+
+/* All threads start together: */
+static pthread_barrier_t stress_barrier;
+
+/**
+ * @brief   Nanoseconds on the CLOCK_MONOTONIC clock
+ */
+static uint64_t
+stress_now_ns(void)
+{
+    struct timespec     ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief   Issue one call to the given entry point
+ */
+static void
+stress_call(
+    int             op
+)
+{
+    switch ( op ) {
+        case stress_op_node_state: {
+            char    *avail_modes = NULL, *current_mode = NULL;
+            
+            node_features_p_node_state(&avail_modes, &current_mode);
+            xfree(avail_modes);
+            xfree(current_mode);
+            break;
+        }
+        case stress_op_reconfig:
+            node_features_p_reconfig();
+            break;
+        case stress_op_node_xlate: {
+            char    *out = node_features_p_node_xlate(stress_new_features, (char*)stress_orig_features, NULL);
+            
+            xfree(out);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief   Body of a benchmark thread
+ */
+static void*
+stress_thread_main(
+    void            *arg
+)
+{
+    stress_thread_t *self = (stress_thread_t*)arg;
+    unsigned int    i;
+    
+    pthread_barrier_wait(&stress_barrier);
+    for ( i = 0; i < stress_n_calls; i++ ) {
+        unsigned int    pick = rand_r(&self->seed) % stress_weight_total;
+        int             op = 0;
+        uint64_t        t0;
+        stress_sample_t *sample;
+        
+        while ( pick >= stress_weights[op] ) pick -= stress_weights[op++];
+        config_mutex_wait_ns = 0;
+        t0 = stress_now_ns();
+        stress_call(op);
+        sample = &self->samples[op][self->n_samples[op]++];
+        sample->latency_ns = stress_now_ns() - t0;
+        sample->wait_ns = config_mutex_wait_ns;
+    }
+    return NULL;
+}
+
+/**
+ * @brief   qsort() comparator for uint64_t values
+ */
+static int
+stress_cmp_u64(
+    const void      *a,
+    const void      *b
+)
+{
+    uint64_t        A = *((const uint64_t*)a), B = *((const uint64_t*)b);
+    
+    return (A < B) ? -1 : ((A > B) ? 1 : 0);
+}
+
+/**
+ * @brief   Value at the given quantile of a sorted array
+ */
+static uint64_t
+stress_quantile(
+    const uint64_t  *sorted,
+    size_t          n,
+    double          q
+)
+{
+    size_t          i = (size_t)ceil(q * n);
+    
+    if ( i > 0 ) i--;
+    if ( i >= n ) i = n - 1;
+    return sorted[i];
+}
+
+/**
+ * @brief   Parse the --mix option, "<node_state>:<reconfig>:<node_xlate>"
+ * @return  Boolean false if the weights are malformed or all zero
+ */
+static bool
+stress_parse_mix(
+    const char      *text
+)
+{
+    unsigned int    w[stress_op_MAX];
+    
+    if ( sscanf(text, "%u:%u:%u", &w[0], &w[1], &w[2]) != stress_op_MAX ) return false;
+    if ( ! (w[0] + w[1] + w[2]) ) return false;
+    memcpy(stress_weights, w, sizeof(w));
+    stress_weight_total = w[0] + w[1] + w[2];
+    return true;
+}
+
+static void
+usage(
+    const char      *exe
+)
+{
+    printf(
+            "usage:\n\n"
+            "    %s {options}\n\n"
+            "  options:\n\n"
+            "    -h/--help                      show this information\n"
+            "    -t/--threads <N>               number of calling threads (default %u)\n"
+            "    -n/--calls <N>                 calls issued by each thread (default %u)\n"
+            "    -m/--mix <state>:<reconf>:<xlate>\n"
+            "                                   relative weights of the entry points\n"
+            "                                   (default %u:%u:%u)\n"
+            "    -r/--root <dir>                read /proc and /sys beneath <dir>\n"
+            "    -o/--orig <features>           original node features presented to\n"
+            "                                   node_xlate\n"
+            "\n",
+            exe, stress_n_threads, stress_n_calls,
+            stress_weights[0], stress_weights[1], stress_weights[2]
+        );
+}
+
+static struct option cli_options[] = {
+        { "help",       no_argument,        0,  'h' },
+        { "threads",    required_argument,  0,  't' },
+        { "calls",      required_argument,  0,  'n' },
+        { "mix",        required_argument,  0,  'm' },
+        { "root",       required_argument,  0,  'r' },
+        { "orig",       required_argument,  0,  'o' },
+        { NULL,         0,                  0,   0  }
+    };
+
+int
+main(
+    int             argc,
+    char*           argv[]
+)
+{
+    stress_thread_t *threads;
+    unsigned int    i;
+    int             opt, op;
+    uint64_t        t0, elapsed_ns;
+    char            *avail_modes = NULL, *current_mode = NULL;
+    
+    while ( (opt = getopt_long(argc, argv, "ht:n:m:r:o:", cli_options, NULL)) != -1 ) {
+        switch ( opt ) {
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            case 't':
+                stress_n_threads = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                stress_n_calls = strtoul(optarg, NULL, 0);
+                break;
+            case 'm':
+                if ( ! stress_parse_mix(optarg) ) {
+                    fprintf(stderr, "ERROR:  invalid mix: %s\n", optarg);
+                    return EINVAL;
+                }
+                break;
+            case 'r':
+                sysfs_root = optarg;
+                break;
+            case 'o':
+                stress_orig_features = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return EINVAL;
+        }
+    }
+    if ( ! stress_n_threads || ! stress_n_calls ) {
+        fprintf(stderr, "ERROR:  thread and call counts must be non-zero\n");
+        return EINVAL;
+    }
+    
+    slurm_init(NULL);
+    init();
+    
+    /* The node's own features are the "new" list for node_xlate: */
+    node_features_p_node_state(&avail_modes, &current_mode);
+    stress_new_features = avail_modes ? avail_modes : xstrdup("");
+    xfree(current_mode);
+    
+    threads = calloc(stress_n_threads, sizeof(stress_thread_t));
+    pthread_barrier_init(&stress_barrier, NULL, stress_n_threads + 1);
+    for ( i = 0; i < stress_n_threads; i++ ) {
+        threads[i].seed = i + 1;
+        for ( op = 0; op < stress_op_MAX; op++ ) threads[i].samples[op] = calloc(stress_n_calls, sizeof(stress_sample_t));
+        pthread_create(&threads[i].thread, NULL, stress_thread_main, &threads[i]);
+    }
+    pthread_barrier_wait(&stress_barrier);
+    t0 = stress_now_ns();
+    for ( i = 0; i < stress_n_threads; i++ ) pthread_join(threads[i].thread, NULL);
+    elapsed_ns = stress_now_ns() - t0;
+    
+    printf("%u threads x %u calls, mix %u:%u:%u, %.3f s, %.0f calls/s\n\n",
+            stress_n_threads, stress_n_calls, stress_weights[0], stress_weights[1], stress_weights[2],
+            1e-9 * elapsed_ns, (double)stress_n_threads * stress_n_calls / (1e-9 * elapsed_ns));
+    printf("%-12s %8s %11s %11s %11s %11s %11s %11s %11s\n", "entry point", "calls",
+            "p50 (us)", "p99 (us)", "p999 (us)", "max (us)", "wait p50", "wait p99", "wait p999");
+    for ( op = 0; op < stress_op_MAX; op++ ) {
+        size_t      n = 0, k = 0;
+        uint64_t    *latency, *wait;
+        
+        for ( i = 0; i < stress_n_threads; i++ ) n += threads[i].n_samples[op];
+        if ( ! n ) continue;
+        latency = calloc(n, sizeof(uint64_t));
+        wait = calloc(n, sizeof(uint64_t));
+        for ( i = 0; i < stress_n_threads; i++ ) {
+            size_t  j;
+            
+            for ( j = 0; j < threads[i].n_samples[op]; j++, k++ ) {
+                latency[k] = threads[i].samples[op][j].latency_ns;
+                wait[k] = threads[i].samples[op][j].wait_ns;
+            }
+        }
+        qsort(latency, n, sizeof(uint64_t), stress_cmp_u64);
+        qsort(wait, n, sizeof(uint64_t), stress_cmp_u64);
+        printf("%-12s %8zu %11.1f %11.1f %11.1f %11.1f %11.1f %11.1f %11.1f\n", stress_op_strings[op], n,
+                1e-3 * stress_quantile(latency, n, 0.50), 1e-3 * stress_quantile(latency, n, 0.99),
+                1e-3 * stress_quantile(latency, n, 0.999), 1e-3 * latency[n - 1],
+                1e-3 * stress_quantile(wait, n, 0.50), 1e-3 * stress_quantile(wait, n, 0.99),
+                1e-3 * stress_quantile(wait, n, 0.999));
+        free(latency);
+        free(wait);
+    }
+    
+    for ( i = 0; i < stress_n_threads; i++ ) {
+        for ( op = 0; op < stress_op_MAX; op++ ) free(threads[i].samples[op]);
+    }
+    free(threads);
+    pthread_barrier_destroy(&stress_barrier);
+    xfree(stress_new_features);
+    fini();
+    return 0;
+}
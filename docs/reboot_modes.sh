@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# Stand-in RebootCommand for exercising the SNC/NPS/HBM modes without BIOS
+# tooling.  State lives under $REBOOT_MODES_STATE (default /tmp/reboot_modes):
+#
+#   <MODE>.values   values the node can boot into (SNC is created on first use)
+#   <MODE>.current  value in effect
+#   <MODE>.next     value staged for the next boot
+#
+#   reboot_modes.sh query <MODE>        print "1 [2] 4"; exit 1 if unsupported
+#   reboot_modes.sh set <MODE> <value>  stage <value>
+#   reboot_modes.sh boot                apply staged values (simulated reboot)
+#
+STATE="${REBOOT_MODES_STATE:-/tmp/reboot_modes}"
+mkdir -p "$STATE" || exit 1
+if [ ! -f "$STATE/SNC.values" ]; then
+    echo "1 2 4" > "$STATE/SNC.values"
+    echo "1" > "$STATE/SNC.current"
+fi
+
+case "$1" in
+    query)
+        [ -f "$STATE/$2.values" ] || exit 1
+        current="$(cat "$STATE/$2.current")"
+        for v in $(cat "$STATE/$2.values"); do
+            if [ "$v" = "$current" ]; then printf '%s[%s]' "$sep" "$v"; else printf '%s%s' "$sep" "$v"; fi
+            sep=" "
+        done
+        echo
+        ;;
+    set)
+        [ -f "$STATE/$2.values" ] || exit 1
+        for v in $(cat "$STATE/$2.values"); do
+            if [ "$v" = "$3" ]; then echo "$3" > "$STATE/$2.next"; exit 0; fi
+        done
+        exit 1
+        ;;
+    boot)
+        for next in "$STATE"/*.next; do
+            [ -f "$next" ] && mv "$next" "${next%.next}.current"
+        done
+        ;;
+    *)
+        echo "usage: $0 query <MODE> | set <MODE> <value> | boot" >&2
+        exit 2
+        ;;
+esac
@@ -0,0 +1,247 @@
+/*
+ * node_features_cpuinfo_bench.c
+ *
+ * Worst-case throughput guards for the text parsers in the
+ * node_features/cpuinfo plugin.  Each parser is timed on an adversarial
+ * input of size N and again at 4N; a parser whose running time grows by
+ * much more than 4x is reported and the program exits non-zero.
+ *
+ */
+
+#define NODE_FEATURE_CPUINFO_TESTING
+#define NODE_FEATURE_CPUINFO_NO_MAIN
+#include "../node_features_cpuinfo.c"
+
+/**
+ * @brief   Largest acceptable growth in time when the input grows 4x
+ * @details Linear work gives a ratio of ~4; quadratic work gives ~16.
+ *          The allowance absorbs timer noise and cache effects.
+ */
+#define BENCH_MAX_RATIO     8.0
+
+/**
+ * @brief   Inputs smaller than this many bytes are timed more than once
+ */
+#define BENCH_BASE_SIZE     (256 * 1024)
+
+/**
+ * @brief   Type of a function that builds an adversarial input of (roughly)
+ *          the given size
+ */
+typedef char* (*bench_input_cb)(size_t size);
+
+/**
+ * @brief   Type of a function that presents an input to a parser
+ */
+typedef void (*bench_run_cb)(const char *input, size_t size);
+
+/**
+ * @brief   Registration record for a benchmark
+ */
+typedef struct bench {
+    const char          *name;          /**< name reported */
+    bench_input_cb      input_cb;       /**< builds the input */
+    bench_run_cb        run_cb;         /**< exercises the parser */
+} bench_t;
+
+/**
+ * @brief   Build a string consisting of a repeated pattern
+ */
+static char*
+bench_repeat(
+    const char      *prefix,
+    const char      *pattern,
+    size_t          size
+)
+{
+    size_t          prefix_len = strlen(prefix), pattern_len = strlen(pattern), n = prefix_len;
+    char            *s = malloc(size + prefix_len + pattern_len + 1);
+    
+    memcpy(s, prefix, prefix_len);
+    while ( n < size ) {
+        memcpy(s + n, pattern, pattern_len);
+        n += pattern_len;
+    }
+    s[n] = '\0';
+    return s;
+}
+
+/**
+ * @brief   Build a comma-separated list of distinct feature names
+ */
+static char*
+bench_distinct_features(
+    const char      *prefix,
+    char            delim,
+    size_t          size
+)
+{
+    char            *s = malloc(size + 64);
+    size_t          n = 0;
+    unsigned long   i = 0;
+    
+    while ( n < size ) n += sprintf(s + n, "%s%s%lu", (n ? (char[]){ delim, '\0' } : ""), prefix, i++);
+    return s;
+}
+
+static char* bench_input_line(size_t size) { return bench_repeat("flags\t\t: ", "x", size); }
+static char* bench_input_flags(size_t size) { return bench_repeat("", "sss", size); }
+static char* bench_input_model_name(size_t size) { return bench_repeat("", "aaaa ", size); }
+/* A value is cut off at CPUINFO_STRTOD_MAX_LEN characters, so time a stream of
+ * lines that each carry the longest accepted value: */
+static char* bench_input_cache_size(size_t size) { return bench_repeat("", "cache size\t: 00000000000000000000000000000000000000000000000000000000000512 KB\n", size); }
+static char* bench_input_job_xlate(size_t size) { return bench_distinct_features("job", '&', size); }
+static char* bench_input_hwloc_xml(size_t size) { return bench_repeat("<topology>", "<object type=\"PCIDev\" pci_busid=\"0:0:0.0\" pci_type=\"0 [1:2]\" value=\"&&amp;&\"/>", size); }
+
+static char*
+bench_input_node_xlate(
+    size_t          size
+)
+{
+    /* New and original lists are presented as "new\norig": */
+    char            *new_list = bench_distinct_features("new", ',', size / 2),
+                    *orig_list = bench_distinct_features("orig", ',', size / 2),
+                    *s = malloc(strlen(new_list) + strlen(orig_list) + 2);
+    
+    sprintf(s, "%s\n%s", new_list, orig_list);
+    free(new_list);
+    free(orig_list);
+    return s;
+}
+
+static void
+bench_run_line_reader(
+    const char      *input,
+    size_t          size
+)
+{
+    FILE            *stream = fmemopen((void*)input, size, "r");
+    line_reader_t   *line_reader = stream ? line_reader_create_stream(stream, 0) : NULL;
+    cpuinfo_features_t  cif;
+    
+    cpuinfo_features_init(&cif);
+    while ( line_reader && line_reader_nextline(line_reader) ) cpuinfo_parse_line(&cif, line_reader_getline(line_reader));
+    cpuinfo_features_reset(&cif);
+    line_reader_free(&line_reader);
+}
+
+static void
+bench_run_parser(
+    const char      *feature_str,
+    const char      *input
+)
+{
+    cpuinfo_feature_parser_t    *parser = cpuinfo_feature_parsers_lookup(feature_str, strlen(feature_str));
+    cpuinfo_features_t          cif;
+    
+    cpuinfo_features_init(&cif);
+    parser->parse_cb(parser, &cif, input);
+    cpuinfo_features_reset(&cif);
+}
+
+static void bench_run_flags(const char *input, size_t size) { bench_run_parser("flags", input); }
+static void bench_run_model_name(const char *input, size_t size) { bench_run_parser("model name", input); }
+
+static void
+bench_run_job_xlate(
+    const char      *input,
+    size_t          size
+)
+{
+    char            *out = cpuinfo_job_features_xlate(input);
+    
+    xfree(out);
+}
+
+static void
+bench_run_node_xlate(
+    const char      *input,
+    size_t          size
+)
+{
+    char            *copy = strdup(input), *orig = strchr(copy, '\n'), *out;
+    
+    *orig++ = '\0';
+    out = cpuinfo_node_features_xlate(copy, orig, NULL);
+    xfree(out);
+    free(copy);
+}
+
+static void
+bench_run_hwloc_xml(
+    const char      *input,
+    size_t          size
+)
+{
+    static hwloc_topology_results_t results;
+    
+    hwloc_xml_parse(input, size, &results);
+}
+
+/**
+ * @brief   The list of benchmarks
+ */
+static bench_t benches[] = {
+        { "line_reader", bench_input_line, bench_run_line_reader },
+        { "flags", bench_input_flags, bench_run_flags },
+        { "model_name", bench_input_model_name, bench_run_model_name },
+        { "cache_size", bench_input_cache_size, bench_run_line_reader },
+        { "node_xlate", bench_input_node_xlate, bench_run_node_xlate },
+        { "job_xlate", bench_input_job_xlate, bench_run_job_xlate },
+        { "hwloc_xml", bench_input_hwloc_xml, bench_run_hwloc_xml },
+        { NULL, NULL, NULL }
+    };
+
+/**
+ * @brief   Time a benchmark on an input of the given size
+ * @return  The best of several runs, in seconds
+ */
+static double
+bench_time(
+    bench_t         *bench,
+    size_t          size
+)
+{
+    char            *input = bench->input_cb(size);
+    size_t          input_len = strlen(input);
+    double          best = -1.0;
+    int             i;
+    
+    for ( i = 0; i < 5; i++ ) {
+        struct timespec t0, t1;
+        double          dt;
+        
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        bench->run_cb(input, input_len);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        dt = (t1.tv_sec - t0.tv_sec) + 1e-9 * (t1.tv_nsec - t0.tv_nsec);
+        if ( (best < 0.0) || (dt < best) ) best = dt;
+    }
+    free(input);
+    return best;
+}
+
+int
+main(
+    int             argc,
+    char*           argv[]
+)
+{
+    bench_t         *bench = benches;
+    size_t          size = BENCH_BASE_SIZE;
+    int             rc = 0;
+    
+    if ( argc > 1 ) size = strtoul(argv[1], NULL, 0);
+    printf("%-12s %12s %12s %8s\n", "parser", "N (s)", "4N (s)", "ratio");
+    while ( bench->name ) {
+        double      t1 = bench_time(bench, size),
+                    t4 = bench_time(bench, 4 * size),
+                    ratio = (t1 > 0.0) ? (t4 / t1) : 0.0;
+        bool        is_ok = (ratio <= BENCH_MAX_RATIO) || (t4 < 1e-3);
+        
+        printf("%-12s %12.6f %12.6f %8.2f%s\n", bench->name, t1, t4, ratio, is_ok ? "" : "  SUPERLINEAR");
+        if ( ! is_ok ) rc = 1;
+        bench++;
+    }
+    return rc;
+}
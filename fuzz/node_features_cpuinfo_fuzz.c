@@ -0,0 +1,137 @@
+/*
+ * node_features_cpuinfo_fuzz.c
+ *
+ * libFuzzer entry points for the text parsers in the node_features/cpuinfo
+ * plugin.  The plugin source is included directly (in its testing
+ * configuration) so the static parsers are reachable.  Exactly one of the
+ * FUZZ_TARGET_* macros selects the entry point compiled into a given
+ * executable:
+ *
+ *     FUZZ_TARGET_line_reader     line_reader_nextline() over a stream
+ *     FUZZ_TARGET_parse_line      cpuinfo_parse_line()
+ *     FUZZ_TARGET_flags           the "flags" parser
+ *     FUZZ_TARGET_model_name      the "model name" parser
+ *     FUZZ_TARGET_cache_size      the "cache size" parser
+ *     FUZZ_TARGET_node_xlate      cpuinfo_node_features_xlate()
+ *     FUZZ_TARGET_job_xlate       cpuinfo_job_features_xlate()
+ *     FUZZ_TARGET_hwloc_xml       hwloc_xml_parse()
+ *
+ */
+
+#define NODE_FEATURE_CPUINFO_TESTING
+#define NODE_FEATURE_CPUINFO_NO_MAIN
+#include "../node_features_cpuinfo.c"
+
+#if ! defined(FUZZ_TARGET_hwloc_xml) && ! defined(FUZZ_TARGET_line_reader)
+
+/**
+ * @brief   Produce a NUL-terminated copy of the fuzzer's input
+ * @return  @a NULL if memory could not be allocated
+ */
+static char*
+fuzz_strndup(
+    const uint8_t   *data,
+    size_t          size
+)
+{
+    char            *s = malloc(size + 1);
+    
+    if ( s ) {
+        memcpy(s, data, size);
+        s[size] = '\0';
+    }
+    return s;
+}
+
+#endif
+
+#if defined(FUZZ_TARGET_flags) || defined(FUZZ_TARGET_model_name) || defined(FUZZ_TARGET_cache_size)
+
+/**
+ * @brief   Present the input text to a single registered cpuinfo parser
+ */
+static void
+fuzz_one_parser(
+    const char          *feature_str,
+    const char          *text
+)
+{
+    cpuinfo_feature_parser_t    *parser = cpuinfo_feature_parsers_lookup(feature_str, strlen(feature_str));
+    cpuinfo_features_t          cif;
+    
+    cpuinfo_features_init(&cif);
+    parser->parse_cb(parser, &cif, text);
+    cpuinfo_features_reset(&cif);
+}
+
+#endif
+
+int
+LLVMFuzzerTestOneInput(
+    const uint8_t   *data,
+    size_t          size
+)
+{
+#if defined(FUZZ_TARGET_hwloc_xml)
+    /* The scanner takes a length, so the input is used in place: */
+    static hwloc_topology_results_t results;
+    
+    hwloc_xml_parse((const char*)data, size, &results);
+#elif defined(FUZZ_TARGET_line_reader)
+    FILE            *stream;
+    line_reader_t   *line_reader;
+    
+    if ( ! size ) return 0;
+    if ( (stream = fmemopen((void*)data, size, "r")) ) {
+        /* Vary the chunk size so line ends fall on chunk boundaries: */
+        if ( (line_reader = line_reader_create_stream(stream, data[0])) ) {
+            while ( line_reader_nextline(line_reader) ) {
+                if ( line_reader_getline(line_reader) ) line_reader_trim(line_reader);
+            }
+            line_reader_free(&line_reader);
+        }
+    }
+#else
+    char            *text = fuzz_strndup(data, size);
+    
+    if ( ! text ) return 0;
+#   if defined(FUZZ_TARGET_parse_line)
+    {
+        cpuinfo_features_t  cif;
+        
+        cpuinfo_features_init(&cif);
+        cpuinfo_parse_line(&cif, text);
+        cpuinfo_features_reset(&cif);
+    }
+#   elif defined(FUZZ_TARGET_flags)
+    fuzz_one_parser("flags", text);
+#   elif defined(FUZZ_TARGET_model_name)
+    fuzz_one_parser("model name", text);
+#   elif defined(FUZZ_TARGET_cache_size)
+    fuzz_one_parser("cache size", text);
+#   elif defined(FUZZ_TARGET_node_xlate)
+    {
+        /* The input is split at newlines into new, original and (optional)
+           available feature lists: */
+        char        *orig = strchr(text, '\n'), *avail = NULL, *out;
+        
+        if ( orig ) {
+            *orig++ = '\0';
+            if ( (avail = strchr(orig, '\n')) ) *avail++ = '\0';
+        }
+        out = cpuinfo_node_features_xlate(text, orig, avail);
+        xfree(out);
+    }
+#   elif defined(FUZZ_TARGET_job_xlate)
+    {
+        char        *out = cpuinfo_job_features_xlate(text);
+        
+        xfree(out);
+    }
+#   else
+#       error No FUZZ_TARGET_* selected
+#   endif
+    free(text);
+#endif
+    return 0;
+}
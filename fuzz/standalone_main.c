@@ -0,0 +1,90 @@
+/*
+ * standalone_main.c
+ *
+ * Corpus-replay driver for the fuzz targets when the compiler does not
+ * provide libFuzzer (e.g. gcc).  Each file named on the command line (or
+ * each regular file in a named directory) is read and presented once to
+ * LLVMFuzzerTestOneInput().
+ *
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/**
+ * @brief   Read a file and present its content to the fuzz target
+ * @return  Zero on success, an errno value otherwise
+ */
+static int
+replay_file(
+    const char      *path
+)
+{
+    FILE            *fptr = fopen(path, "rb");
+    uint8_t         *data = NULL;
+    size_t          size = 0, capacity = 0, n;
+    
+    if ( ! fptr ) {
+        fprintf(stderr, "ERROR:  unable to open %s (errno = %d)\n", path, errno);
+        return errno;
+    }
+    do {
+        if ( size == capacity ) {
+            uint8_t *new_data = realloc(data, capacity = capacity ? 2 * capacity : 4096);
+            
+            if ( ! new_data ) {
+                free(data);
+                fclose(fptr);
+                return ENOMEM;
+            }
+            data = new_data;
+        }
+        n = fread(data + size, 1, capacity - size, fptr);
+        size += n;
+    } while ( n > 0 );
+    fclose(fptr);
+    
+    LLVMFuzzerTestOneInput(data, size);
+    free(data);
+    printf("%s: %zu bytes\n", path, size);
+    return 0;
+}
+
+int
+main(
+    int             argc,
+    char*           argv[]
+)
+{
+    int             argn = 1, rc = 0;
+    
+    while ( argn < argc ) {
+        struct stat finfo;
+        
+        if ( (stat(argv[argn], &finfo) == 0) && S_ISDIR(finfo.st_mode) ) {
+            DIR             *dir = opendir(argv[argn]);
+            struct dirent   *entry;
+            
+            while ( dir && (entry = readdir(dir)) ) {
+                char        path[4096];
+                
+                if ( entry->d_name[0] == '.' ) continue;
+                snprintf(path, sizeof(path), "%s/%s", argv[argn], entry->d_name);
+                if ( (stat(path, &finfo) == 0) && S_ISREG(finfo.st_mode) && replay_file(path) ) rc = 1;
+            }
+            if ( dir ) closedir(dir);
+        }
+        else if ( replay_file(argv[argn]) ) {
+            rc = 1;
+        }
+        argn++;
+    }
+    return rc;
+}
@@ -13,6 +13,13 @@
  *              MODEL       succinct CPU model name
  *              CACHE       kilobytes of cache reported
  *              ISA         ISA extensions
+ *              PERF        performance-index tiers relative to
+ *                          a configured reference node
+ *              MEM         memory configuration
+ *              HEALTH      hardware health markers
+ *              IOMMU       IOMMU translation mode
+ *              ISOL        CPUs isolated from the scheduler
+ *              NOHZ        tickless CPU configuration
  *
  *          There will typically be multiple ISA features
  *          present -- but not every ISA feature is noted.
@@ -21,25 +28,59 @@
  *          ISA complement.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <ctype.h>
 #include <pthread.h>
 #include <errno.h>
+#include <fnmatch.h>
+#include <glob.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <linux/netlink.h>
 
 #ifdef NODE_FEATURE_CPUINFO_TESTING
 
-#include <stdarg.h>
-
 #define xstrfmtcat(__p, __fmt, args...) _xstrfmtcat(&(__p), __fmt, ## args)
 #define xfree(__p) _xfree((void **)&(__p))
+#define xstrdup(__s) _xstrdup(__s)
+#define xmalloc(__n) _xmalloc(__n)
+#define debug(__fmt, args...) _cpuinfo_log(true, __fmt, ## args)
+#define info(__fmt, args...) _cpuinfo_log(false, __fmt, ## args)
+#define error(__fmt, args...) _cpuinfo_log(false, "ERROR: " __fmt, ## args)
 
 void _xstrfmtcat(char **str, const char *fmt, ...)
         __attribute__((format(printf, 2, 3)));
 void _xfree(void **ptr);
+char* _xstrdup(const char *s);
+void* _xmalloc(size_t n);
+void _cpuinfo_log(bool is_debug, const char *fmt, ...)
+        __attribute__((format(printf, 2, 3)));
+
+/**
+ * @var     cpuinfo_log_debug
+ * @brief   Should debug() messages be written by the test program
+ */
+static bool cpuinfo_log_debug = false;
         
 void
 _xstrfmtcat(
@@ -50,16 +91,10 @@ _xstrfmtcat(
 {
     va_list     argv;
     char        *s = *str;
-    int         s_len, new_len, need_nul;
+    int         s_len, new_len;
     
     /* Current length of the string: */
-    if ( s ) {
-        s_len = 1 + (*s ? strlen(s) : 0);
-        need_nul = 0;
-    } else {
-        s_len = 0;
-        need_nul = 1;
-    }
+    s_len = ( s ? strlen(s) : 0 );
     
     /* Length of new string: */
     va_start(argv, fmt);
@@ -68,14 +103,14 @@ _xstrfmtcat(
     
     if ( new_len > 0 ) {
         /* Resize: */
-        s = (char*)realloc(s, s_len + new_len + need_nul);
+        s = (char*)realloc(s, s_len + new_len + 1);
         if ( ! s ) {
             perror("Memory allocation failure in _xstrfmtcat");
             exit(errno);
         }
         *str = s;
         va_start(argv, fmt);
-        vsnprintf(s, s_len + new_len + need_nul, fmt, argv);
+        vsnprintf(s + s_len, new_len + 1, fmt, argv);
         va_end(argv);
     }
 }
@@ -90,6 +125,93 @@ void _xfree(
     }
 }
 
+void*
+_xmalloc(
+    size_t      n
+)
+{
+    void        *p = calloc(1, n);
+    
+    if ( ! p ) {
+        perror("Memory allocation failure in _xmalloc");
+        exit(errno);
+    }
+    return p;
+}
+
+char*
+_xstrdup(
+    const char  *s
+)
+{
+    char        *copy = NULL;
+    
+    if ( s && ! (copy = strdup(s)) ) {
+        perror("Memory allocation failure in _xstrdup");
+        exit(errno);
+    }
+    return copy;
+}
+
+void
+_cpuinfo_log(
+    bool        is_debug,
+    const char  *fmt,
+    ...
+)
+{
+    va_list     argv;
+    
+    if ( is_debug && ! cpuinfo_log_debug ) return;
+    va_start(argv, fmt);
+    vfprintf(stderr, fmt, argv);
+    va_end(argv);
+    fputc('\n', stderr);
+}
+
+#else
+
+#include <dlfcn.h>
+
+#include "slurm/slurm.h"
+
+#include "src/common/assoc_mgr.h"
+#include "src/common/bitstring.h"
+#include "src/common/fd.h"
+#include "src/common/gres.h"
+#include "src/common/list.h"
+#include "src/common/macros.h"
+#include "src/common/node_conf.h"
+#include "src/common/pack.h"
+#include "src/common/parse_config.h"
+#include "src/common/read_config.h"
+#include "src/common/slurm_protocol_api.h"
+#include "src/common/timers.h"
+#include "src/common/uid.h"
+#include "src/common/xmalloc.h"
+#include "src/common/xstring.h"
+#include "src/slurmctld/job_scheduler.h"
+#include "src/slurmctld/locks.h"
+#include "src/slurmctld/node_scheduler.h"
+#include "src/slurmctld/reservation.h"
+#include "src/slurmctld/slurmctld.h"
+#include "src/slurmctld/state_save.h"
+#include "src/slurmd/slurmd/req.h"
+
+#endif
+
+/**
+ * @def     HARNESS_UNUSED
+ * @brief   Marks an entry point the fuzzing and benchmark harnesses skip
+ * @details The harnesses include this file with NODE_FEATURE_CPUINFO_NO_MAIN
+ *          to reach its static parsers, leaving the probes, modes and
+ *          translations they do not drive uncalled.  Elsewhere the marker
+ *          is empty, so genuinely unused functions are still reported.
+ */
+#ifdef NODE_FEATURE_CPUINFO_NO_MAIN
+#define HARNESS_UNUSED  __attribute__((unused))
+#else
+#define HARNESS_UNUSED
 #endif
 
 /**
@@ -129,6 +251,9 @@ typedef struct line_reader {
     size_t      capacity;       /**< maximum byte capacity of the buffer */
     size_t      used;           /**< number of bytes in-use in the buffer */
     
+    size_t      max_line;       /**< longer lines are truncated to this many bytes */
+    bool        is_truncating;  /**< discarding the remainder of an over-long line */
+    
     size_t      chunk_size;     /**< read the file this many bytes at a time */
     char        *buffer_ptr;    /**< current position in the chunk buffer */
     char        *buffer_end;    /**< pointer just beyond the last used byte of the chunk buffer */
@@ -136,36 +261,40 @@ typedef struct line_reader {
 } line_reader_t;
 
 /**
- * @brief   Allocate and initialize a new line reader
- * @details The file given by @a filename is opened for reading and, if
- *          successful, a new line reader pseudo-object is created to
- *          handle i/o.
- * @param   filename    file to read
+ * @brief   Default limit on the length of a line returned by a line reader
+ * @details No file the plugin reads legitimately has lines anywhere near
+ *          this long; the limit keeps a corrupt or hostile file from
+ *          growing the line buffer without bound.
+ */
+#define LINE_READER_MAX_LINE    65536
+
+/**
+ * @brief   Allocate and initialize a new line reader on an open stream
+ * @details The line reader takes ownership of @a stream and closes it when
+ *          freed (or if it cannot be created).
+ * @param   stream      stdio stream to read
  * @param   chunk_size  read the file in chunks of this size; if less
  *                      than 128, defaults to 128
  * @return  Returns @a NULL on error, a new object otherwise
  */
 static line_reader_t*
-line_reader_create(
-    const char      *filename,
+line_reader_create_stream(
+    FILE            *stream,
     size_t          chunk_size
 )
 {
-    FILE            *stream = NULL;
     size_t          line_reader_bytes;
     line_reader_t   *new_line_reader = NULL;
     
     if ( chunk_size < 128 ) chunk_size = 128;
     
-    stream = fopen(filename, "r");
-    if ( ! stream ) return NULL;
-    
     line_reader_bytes = sizeof(line_reader_t) + chunk_size;
     new_line_reader = (line_reader_t*)malloc(line_reader_bytes);
     if ( new_line_reader ) {
         memset(new_line_reader, 0, sizeof(*new_line_reader));
         
         new_line_reader->stream = stream;
+        new_line_reader->max_line = LINE_READER_MAX_LINE;
         
         new_line_reader->chunk_size = chunk_size;
         new_line_reader->buffer_ptr = &new_line_reader->buffer[0];
@@ -176,6 +305,28 @@ line_reader_create(
     return new_line_reader;
 }
 
+/**
+ * @brief   Allocate and initialize a new line reader
+ * @details The file given by @a filename is opened for reading and, if
+ *          successful, a new line reader pseudo-object is created to
+ *          handle i/o.
+ * @param   filename    file to read
+ * @param   chunk_size  read the file in chunks of this size; if less
+ *                      than 128, defaults to 128
+ * @return  Returns @a NULL on error, a new object otherwise
+ */
+static line_reader_t*
+line_reader_create(
+    const char      *filename,
+    size_t          chunk_size
+)
+{
+    FILE            *stream = fopen(filename, "r");
+    
+    if ( ! stream ) return NULL;
+    return line_reader_create_stream(stream, chunk_size);
+}
+
 /**
  * @brief   Destroy a line reader object
  * @param   this        a pointer to the pointer to the line reader;
@@ -228,7 +379,7 @@ line_reader_trim(
         /* Strip trailing whitespace; p starts out pointing just past the NUL
            character: */
         p--;
-        while ( (p > e) && isspace(*(p - 1)) ) {
+        while ( (p > e) && isspace((unsigned char)*(p - 1)) ) {
             p--, this->used--;
             *p = '\0';
         }
@@ -236,7 +387,7 @@ line_reader_trim(
         /* Check for leading whitespace: */
         p = this->line_buffer;
         e = p + this->used;
-        while ( (p < e) && isspace(*p) ) p++;
+        while ( (p < e) && isspace((unsigned char)*p) ) p++;
         if ( (d = p - this->line_buffer) > 0 ) {
             memmove(this->line_buffer, p, this->used - d);
             this->used -= d;
@@ -270,6 +421,18 @@ line_reader_nextline(
         while ( ! is_done && (this->buffer_ptr < this->buffer_end) ) {
             char        c;
             
+            if ( this->is_truncating ) {
+                /* Discard the rest of an over-long line: */
+                c = *this->buffer_ptr++;
+                if ( (c == '\0') || (c == '\n') ) this->is_truncating = false;
+                continue;
+            }
+            if ( this->used == this->max_line ) {
+                /* Return what we have and drop the rest of the line: */
+                this->is_truncating = true;
+                is_done = true;
+                break;
+            }
             if ( this->used == this->capacity ) {
                 size_t      new_capacity = this->capacity ? (2 * this->capacity) : 128;
                 char        *new_line_buffer = (char*)realloc(this->line_buffer, new_capacity);
@@ -287,19 +450,23 @@ line_reader_nextline(
         }
         
         /* If we're not done, then we must be at the end of the chunk
-           buffer; read another: */
-        if ( this->buffer_ptr == this->buffer_end ) {
+           buffer; read another.  At end-of-file a partial final line
+           (one lacking a newline) is still returned: */
+        if ( ! is_done ) {
             size_t      bytes_read;
             
             this->buffer_ptr = &this->buffer[0];
+            this->buffer_end = this->buffer_ptr;
             bytes_read = fread(this->buffer_ptr, 1, this->chunk_size, this->stream);
             if ( bytes_read <= 0 ) {
                 this->err_code = ( ferror(this->stream) ? -1 : 0 );
-                return NULL;
+                if ( this->err_code || (this->used == 0) ) return NULL;
+                is_done = true;
+            } else {
+                this->buffer_end = this->buffer_ptr + bytes_read;
             }
-            this->buffer_end = this->buffer_ptr + bytes_read;
         }
-        else if ( is_done ) {
+        if ( is_done ) {
             if ( this->used == this->capacity ) {
                 size_t      new_capacity = this->capacity ? (2 * this->capacity) : 128;
                 char        *new_line_buffer = (char*)realloc(this->line_buffer, new_capacity);
@@ -317,6 +484,160 @@ line_reader_nextline(
     }
 }
 
+/**
+ * @var     sysfs_root
+ * @brief   Directory prepended to every /proc and /sys path the probes
+ *          read
+ * @details Empty for the plugin; the test program can point it at a
+ *          captured directory tree so probes can be checked without the
+ *          hardware in question.
+ */
+static const char *sysfs_root = "";
+
+/**
+ * @brief   Construct a path below the sysfs root
+ * @param   buffer      the character buffer to fill-in
+ * @param   buffer_len  the capacity of @a buffer
+ * @param   fmt         printf-style format of the path (starting
+ *                      with a slash)
+ * @return  Returns @a buffer (for chaining operations) or @a NULL if the
+ *          path did not fit
+ */
+static char*
+sysfs_path(
+    char        *buffer,
+    size_t      buffer_len,
+    const char  *fmt,
+    ...
+) __attribute__((format(printf, 3, 4)));
+
+static char*
+sysfs_path(
+    char        *buffer,
+    size_t      buffer_len,
+    const char  *fmt,
+    ...
+)
+{
+    va_list     argv;
+    int         root_len = snprintf(buffer, buffer_len, "%s", sysfs_root), path_len;
+    
+    if ( (root_len < 0) || (root_len >= buffer_len) ) return NULL;
+    va_start(argv, fmt);
+    path_len = vsnprintf(buffer + root_len, buffer_len - root_len, fmt, argv);
+    va_end(argv);
+    if ( (path_len < 0) || (path_len >= buffer_len - root_len) ) return NULL;
+    return buffer;
+}
+
+/**
+ * @brief   Read the first line of a (sysfs) file
+ * @details Trailing whitespace is removed from the value.
+ * @param   path        the file to read
+ * @param   buffer      the character buffer to fill-in
+ * @param   buffer_len  the capacity of @a buffer
+ * @return  Boolean true if a value was read
+ */
+static bool
+sysfs_read_str(
+    const char  *path,
+    char        *buffer,
+    size_t      buffer_len
+)
+{
+    FILE        *fptr = fopen(path, "r");
+    bool        is_okay = false;
+    
+    if ( fptr ) {
+        if ( fgets(buffer, buffer_len, fptr) ) {
+            size_t  len = strlen(buffer);
+            
+            while ( len && isspace(buffer[len - 1]) ) buffer[--len] = '\0';
+            is_okay = true;
+        }
+        fclose(fptr);
+    }
+    return is_okay;
+}
+
+/**
+ * @brief   Read an unsigned integer from a (sysfs) file
+ * @param   path        the file to read
+ * @param   value       pointer to the value to fill-in
+ * @return  Boolean true if a value was read
+ */
+static bool
+sysfs_read_u64(
+    const char          *path,
+    unsigned long long  *value
+)
+{
+    char                buffer[64], *endp = NULL;
+    
+    if ( ! sysfs_read_str(path, buffer, sizeof(buffer)) ) return false;
+    *value = strtoull(buffer, &endp, 0);
+    return ( endp > buffer );
+}
+
+/**
+ * @brief   Read the kernel command line
+ * @param   buffer      the character buffer to fill-in
+ * @param   buffer_len  the capacity of @a buffer
+ * @return  Boolean true if the command line was read
+ */
+static bool
+kernel_cmdline_read(
+    char        *buffer,
+    size_t      buffer_len
+)
+{
+    char        path[PATH_MAX];
+    
+    return sysfs_path(path, sizeof(path), "/proc/cmdline") && sysfs_read_str(path, buffer, buffer_len);
+}
+
+/**
+ * @brief   Find a parameter on the kernel command line
+ * @details As with the kernel itself, the last occurrence of @a key
+ *          wins.  A parameter given without a value yields an empty
+ *          string.
+ * @param   cmdline     the kernel command line
+ * @param   key         the parameter name (without the '=')
+ * @param   value       the character buffer to fill-in with the value
+ * @param   value_len   the capacity of @a value
+ * @return  Boolean true if the parameter was present
+ */
+static bool
+kernel_cmdline_value(
+    const char  *cmdline,
+    const char  *key,
+    char        *value,
+    size_t      value_len
+)
+{
+    size_t      key_len = strlen(key);
+    bool        is_found = false;
+    
+    while ( *cmdline ) {
+        const char  *e;
+        
+        while ( *cmdline && isspace(*cmdline) ) cmdline++;
+        e = cmdline;
+        while ( *e && ! isspace(*e) ) e++;
+        if ( (e - cmdline >= key_len) && ! strncmp(cmdline, key, key_len) && ((cmdline[key_len] == '=') || (cmdline + key_len == e)) ) {
+            const char  *v = cmdline + key_len + (cmdline[key_len] == '=');
+            size_t      v_len = e - v;
+            
+            if ( v_len >= value_len ) v_len = value_len - 1;
+            memcpy(value, v, v_len);
+            value[v_len] = '\0';
+            is_found = true;
+        }
+        cmdline = e;
+    }
+    return is_found;
+}
+
 /**
  * @brief cpuinfo ISA flag bit indices
  */
@@ -369,9 +690,38 @@ typedef struct cpuinfo_features {
     const char          *vendor_id;         /**< E.g. GenuineIntel, AuthenticAMD */
     const char          *model_name;        /**< Succinct CPU model name */
     unsigned int        cache_kb;           /**< Kilobytes of on-die cache */
+    unsigned int        cpu_mhz;            /**< Reported clock frequency in MHz */
+    unsigned int        cpu_family;         /**< CPUID family */
+    unsigned int        cpu_model;          /**< CPUID model */
+    unsigned int        cpu_stepping;       /**< CPUID stepping */
     unsigned int        flags;              /**< ISA flags (bitmap w.r.t. cpuinfo_flags_t) */
 } cpuinfo_features_t;
 
+/**
+ * @var     cpuinfo_feature_namespaces
+ * @brief   the <TYPE>:: prefixes of the features this plugin produces
+ */
+static const char* cpuinfo_feature_namespaces[] = {
+        "VENDOR::",
+        "MODEL::",
+        "CACHE::",
+        "ISA::",
+        "PERF::",
+        "MEM::",
+        "HEALTH::",
+        "IOMMU::",
+        "ISOL::",
+        "NOHZ::",
+        "POWER::",
+        "FS::",
+        "MODE::",
+#ifdef HAVE_PCI_DETECTION
+        "PCI::",
+        "GPU::",
+#endif
+        NULL
+    };
+
 /**
  * @brief   Determine is a Slurm feature string is one that this
  *          plugin added
@@ -390,14 +740,13 @@ cpuinfo_features_is_str_ours(
     int         feature_str_len
 )
 {
+    const char  **namespaces = cpuinfo_feature_namespaces;
+    
     if ( feature_str_len <= 0 ) feature_str_len = strlen(feature_str);
-    if ( str_startswith(feature_str, "VENDOR::", feature_str_len) ) return true;
-    if ( str_startswith(feature_str, "MODEL::", feature_str_len) ) return true;
-    if ( str_startswith(feature_str, "CACHE::", feature_str_len) ) return true;
-    if ( str_startswith(feature_str, "ISA::", feature_str_len) ) return true;
-#ifdef HAVE_PCI_DETECTION
-    if ( str_startswith(feature_str, "PCI::", feature_str_len) ) return true;
-#endif
+    while ( *namespaces ) {
+        if ( str_startswith(feature_str, *namespaces, feature_str_len) ) return true;
+        namespaces++;
+    }
     return false;
 }
 
@@ -433,25 +782,29 @@ cpuinfo_features_reset(
 }
 
 /**
- * @brief   Write a summary of the cpuinfo_features_t fields to stdout
- * @param   cif     pointer to the cpuinfo_features_t
+ * @brief   Append the features for the cpuinfo_features_t fields to a
+ *          feature string
+ * @param   cif         pointer to the cpuinfo_features_t
+ * @param   features    pointer to the feature string to extend
+ * @param   delim       pointer to the current delimiter; set to a comma
+ *                      once a feature has been appended
  */
 static void
-cpuinfo_features_summarize(
-    cpuinfo_features_t  *cif
+cpuinfo_features_fmtcat(
+    cpuinfo_features_t  *cif,
+    char                **features,
+    const char          **delim
 )
 {
     unsigned int        i = cpuinfo_flags_START, mask = 1;
-    const char          *delim = "";
     
-    if ( cif->vendor_id ) printf("%sVENDOR::%s", delim, cif->vendor_id), delim = ",";
-    if ( cif->model_name ) printf("%sMODEL::%s", delim, cif->model_name), delim = ",";
-    if ( cif->cache_kb ) printf("%sCACHE::%uKB", delim, cif->cache_kb), delim = ",";
+    if ( cif->vendor_id ) xstrfmtcat(*features, "%sVENDOR::%s", *delim, cif->vendor_id), *delim = ",";
+    if ( cif->model_name ) xstrfmtcat(*features, "%sMODEL::%s", *delim, cif->model_name), *delim = ",";
+    if ( cif->cache_kb ) xstrfmtcat(*features, "%sCACHE::%uKB", *delim, cif->cache_kb), *delim = ",";
     while ( i < cpuinfo_flags_MAX ) {
-        if ( (cif->flags & mask) == mask ) printf("%sISA::%s", delim, cpuinfo_flags_strings[i]), delim = ",";
+        if ( (cif->flags & mask) == mask ) xstrfmtcat(*features, "%sISA::%s", *delim, cpuinfo_flags_strings[i]), *delim = ",";
         i++, mask <<= 1;
     }
-    printf("\n");
 }
 
 /**
@@ -510,6 +863,46 @@ cpuinfo_parse_strdup(
     return true;
 }
 
+/**
+ * @brief   Maximum length of the numeric text accepted by cpuinfo_strtod()
+ */
+#define CPUINFO_STRTOD_MAX_LEN  64
+
+/**
+ * @brief   Bounded wrapper around strtod()
+ * @details The C library's strtod() converts in arbitrary precision, so its
+ *          running time grows faster than linearly with the number of
+ *          digits presented to it.  No legitimate cpuinfo value comes close
+ *          to CPUINFO_STRTOD_MAX_LEN characters; longer numeric text is
+ *          rejected before it reaches strtod().  Only decimal notation is
+ *          accepted.
+ * @param   text        C string to convert
+ * @param   endp        set to the character following the converted value
+ *                      (or @a text if nothing was converted)
+ * @return  The converted value, or 0.0 if nothing was converted
+ */
+static double
+cpuinfo_strtod(
+    const char      *text,
+    char            **endp
+)
+{
+    char            numeric[CPUINFO_STRTOD_MAX_LEN + 1], *numeric_end = NULL;
+    size_t          n = 0;
+    double          val;
+    
+    *endp = (char*)text;
+    while ( text[n] && (isspace((unsigned char)text[n]) || isdigit((unsigned char)text[n]) || strchr("+-.eE", text[n])) ) {
+        if ( n == CPUINFO_STRTOD_MAX_LEN ) return 0.0;
+        numeric[n] = text[n];
+        n++;
+    }
+    numeric[n] = '\0';
+    val = strtod(numeric, &numeric_end);
+    *endp = (char*)text + (numeric_end - numeric);
+    return val;
+}
+
 /**
  * @brief   Parser callback that handles cache size
  * @param   parser_registry the registry struct for the feature
@@ -526,11 +919,11 @@ cpuinfo_parse_cache_size(
 )
 {
     char                            *endp = NULL;
-    double                          numerical_val = strtod(text, &endp);
+    double                          numerical_val = cpuinfo_strtod(text, &endp);
     
     if ( endp > text ) {
-        while ( *endp && isspace(*endp) ) endp++;
-        switch ( toupper(*endp) ) {
+        while ( *endp && isspace((unsigned char)*endp) ) endp++;
+        switch ( toupper((unsigned char)*endp) ) {
             case 'G':
                 numerical_val *= 1024.0;
             case 'M':
@@ -542,9 +935,11 @@ cpuinfo_parse_cache_size(
                 numerical_val /= 1024.0;
                 break;
         }
-        switch ( toupper(*endp) ) {
+        switch ( toupper((unsigned char)*endp) ) {
             case 'B':
             case '\0':
+                /* Reject inf/nan and anything an unsigned int cannot hold: */
+                if ( ! isfinite(numerical_val) || (numerical_val < 0.0) || (numerical_val >= 4294967296.0) ) return false;
                 cif->cache_kb = (unsigned int)numerical_val;
                 return true;
         }
@@ -552,6 +947,36 @@ cpuinfo_parse_cache_size(
     return false;
 }
 
+/**
+ * @brief   Parser callback that handles an unsigned integer value
+ * @details The @a arg_offset in the @a parser_registry locates the
+ *          unsigned int field that will be set to the value of @a text.
+ *          Fractional values are truncated.
+ * @param   parser_registry the registry struct for the feature
+ * @param   cif             pointer to the cpuinfo_features data structure to
+ *                          fill-in
+ * @param   text            immutable C string containing the feature value
+ *                          from the cpuinfo file
+ */
+static bool
+cpuinfo_parse_unsigned(
+    cpuinfo_feature_parser_ref      parser_registry,
+    cpuinfo_features_t              *cif,
+    const char                      *text
+)
+{
+    void                            *p = (void*)cif;
+    char                            *endp = NULL;
+    double                          numerical_val = cpuinfo_strtod(text, &endp);
+    
+    if ( (endp > text) && (numerical_val >= 0.0) && (numerical_val < 4294967296.0) ) {
+        p += parser_registry->arg_offset;
+        *((unsigned int*)p) = (unsigned int)numerical_val;
+        return true;
+    }
+    return false;
+}
+
 /**
  * @brief   Parser callback that handles processor model name
  * @details The model name field tends to be extremely verbose.  This function
@@ -590,26 +1015,26 @@ cpuinfo_parse_model_name(
     }
     
     if ( prefix ) {
-        if ( isalnum(*s) ) {
+        if ( isalnum((unsigned char)*s) ) {
             /* Skip past the first alnum character: */
             e = s;
             e++;
             /* Zero or more alpha and dash characters: */
-            while ( *e && (isalpha(*e) || (*e == '-')) ) e++;
+            while ( *e && (isalpha((unsigned char)*e) || (*e == '-')) ) e++;
             /* A single digit character: */
-            if ( isdigit(*e) ) {
+            if ( isdigit((unsigned char)*e) ) {
                 char                *p;
                 size_t              d;
                 
                 /* Skip past the digit: */
                 e++;
                 /* Zero or more alnum or dash characters: */
-                while ( *e && (isalnum(*e) || (*e == '-')) ) e++;
+                while ( *e && (isalnum((unsigned char)*e) || (*e == '-')) ) e++;
                 
                 /* Characters [s,e) are the model: */
                 if ( cif->model_name ) free((void*)cif->model_name);
                 d = e - prefix;
-                p = (char*)malloc(d + 1);
+                if ( ! (p = (char*)malloc(d + 1)) ) return false;
                 memcpy(p, prefix, d);
                 p[d] = '\0';
                 cif->model_name = (const char*)p;
@@ -626,33 +1051,33 @@ cpuinfo_parse_model_name(
     }
     
     while ( *s ) {
-        while ( ! isalnum(*s) ) s++;
+        while ( *s && ! isalnum((unsigned char)*s) ) s++;
         if ( *s ) {
             /* Skip past the first alnum character: */
             e = s;
             e++;
             /* Zero or more alpha and dash characters: */
-            while ( *e && (isalpha(*e) || (*e == '-')) ) e++;
+            while ( *e && (isalpha((unsigned char)*e) || (*e == '-')) ) e++;
             /* A single digit character: */
-            if ( isdigit(*e) ) {
+            if ( isdigit((unsigned char)*e) ) {
                 char                *p;
                 size_t              d;
                 
                 /* Skip past the digit: */
                 e++;
                 /* Zero or more alnum or dash characters: */
-                while ( *e && (isalnum(*e) || (*e == '-')) ) e++;
+                while ( *e && (isalnum((unsigned char)*e) || (*e == '-')) ) e++;
                 
                 /* Optional " v\d+": */
-                if ( (*e == ' ') && (*(e+1) == 'v') && isdigit(*(e+2)) ) {
+                if ( (*e == ' ') && (*(e+1) == 'v') && isdigit((unsigned char)*(e+2)) ) {
                     e += 2;
-                    while ( isdigit(*e) ) e++;
+                    while ( isdigit((unsigned char)*e) ) e++;
                 }
                 
                 /* Characters [s,e) are the model: */
                 if ( cif->model_name ) free((void*)cif->model_name);
                 d = e - s;
-                p = (char*)malloc(d + 1);
+                if ( ! (p = (char*)malloc(d + 1)) ) return false;
                 memcpy(p, s, d);
                 p[d] = '\0';
                 cif->model_name = (const char*)p;
@@ -663,18 +1088,25 @@ cpuinfo_parse_model_name(
                 }
                 return true;
             }
+            /* No model can start inside the alpha/dash run just scanned,
+               so resume after it (this keeps the scan linear): */
+            s = e;
         }
-        s++;
     }
     return false;
 }
 
 /**
  * @brief   Does one string occur within the other with only adjoining whitespace
- * @details The @a haystack is searched for an occurrence of @a needle and is trailed
- *          only by whitespace or the NUL terminator.
+ * @details The @a haystack is searched for an occurrence of @a needle that is
+ *          preceded by a delimiter or the start of the string and trailed by
+ *          a delimiter or the NUL terminator.  Each search resumes beyond
+ *          the previous occurrence, so the work is linear in the length of
+ *          @a haystack.
  * @param   haystack    the C string to search
  * @param   needle      the C string to find in the @a haystack
+ * @param   delimiter   the delimiter characters (whitespace if @a NULL
+ *                      or empty)
  * @return  Returns boolean true if the @a needle was found, false otherwise
  */
 static bool
@@ -691,13 +1123,15 @@ __contains_str(
     
     if ( ! delimiter || ! *delimiter ) delimiter = " \t";
     
+    if ( ! needle_len ) return false;
     while ( *p ) {
-        char    *found = strstr(p, needle);
-        char    *next_char = found + needle_len;
+        const char  *found = strstr(p, needle), *next_char;
         
         if ( ! found ) break;
-        if ( (*next_char == '\0') || (strchr(delimiter, *next_char) != NULL) ) return true;
-        p = next_char;
+        next_char = found + needle_len;
+        if ( ((found == haystack) || strchr(delimiter, *(found - 1)))
+                && ((*next_char == '\0') || (strchr(delimiter, *next_char) != NULL)) ) return true;
+        p = found + 1;
     }
     return false;
 }
@@ -736,8 +1170,12 @@ cpuinfo_parse_flags(
  */
 static cpuinfo_feature_parser_t cpuinfo_feature_parsers[] = {
         { "cache size", cpuinfo_parse_cache_size, 0, NULL },
+        { "cpu family", cpuinfo_parse_unsigned, offsetof(cpuinfo_features_t, cpu_family), NULL },
+        { "cpu MHz", cpuinfo_parse_unsigned, offsetof(cpuinfo_features_t, cpu_mhz), NULL },
         { "flags", cpuinfo_parse_flags, 0, NULL },
+        { "model", cpuinfo_parse_unsigned, offsetof(cpuinfo_features_t, cpu_model), NULL },
         { "model name", cpuinfo_parse_model_name, 0, NULL },
+        { "stepping", cpuinfo_parse_unsigned, offsetof(cpuinfo_features_t, cpu_stepping), NULL },
         { "vendor_id", cpuinfo_parse_strdup, offsetof(cpuinfo_features_t, vendor_id), NULL },
         { NULL, NULL, 0, NULL }
     };
@@ -787,7 +1225,7 @@ cpuinfo_parse_line(
     const char                  *feature_start, *feature_end;
     
     /* Drop any leading whitespace: */
-    while ( *line && isspace(*line) ) line++;
+    while ( *line && isspace((unsigned char)*line) ) line++;
     if ( ! *line ) return false;
     
     /* Skip ahead to the colon: */
@@ -797,7 +1235,7 @@ cpuinfo_parse_line(
     /* Now backtrack from the colon, past any whitespace to
        the first non-whitespace character: */
     feature_end = line;
-    while ( (feature_end > feature_start) && isspace(*(feature_end - 1)) ) feature_end--;
+    while ( (feature_end > feature_start) && isspace((unsigned char)*(feature_end - 1)) ) feature_end--;
     /* At this point the feature name lies from [feature_start, feature_end) */
     parser = cpuinfo_feature_parsers_lookup(feature_start, feature_end - feature_start);
     if ( ! parser ) return false;
@@ -805,7 +1243,7 @@ cpuinfo_parse_line(
     /* Pickup from where we left off with line pointing to the colon and skip past
        any whitespace: */
     line++;
-    while ( *line && isspace(*line) ) line++;
+    while ( *line && isspace((unsigned char)*line) ) line++;
     
     /* Present this to the parser: */
     return parser->parse_cb(parser, cif, line);
@@ -842,263 +1280,7771 @@ cpuinfo_parse_file(
 }
 
 
-#ifdef HAVE_PCI_DETECTION
-
-#include <pciaccess.h>
-
-/**
- * @brief   Map a feature name to a PCI device id
- */
-typedef struct pci_device_feature {
-    uint32_t                device_id;      /**< 16-bit PCI device id */
-    const char              *feature_name;  /**< Slurm feature name */
-} pci_device_feature_t;
-
 /**
- * @brief   Map a list of device-feature matches to a PCI vendor id
+ * @brief   Maximum number of values in a tier list
  */
-typedef struct pci_vendor_devices {
-    uint32_t                vendor_id;          /**< 16-bit PCI vendor id */
-    pci_device_feature_t    device_features[];  /**< array of device-to-feature mappings */
-} pci_vendor_devices_t;
+#define CPUINFO_TIER_LIST_MAX   16
 
 /**
- * @brief   Pointer to a vendor device list
+ * @brief   An ordered list of threshold values
+ * @details Tier lists are used to publish "at least" or "at most" style
+ *          features (e.g. PERF::GE::1.5x) for every threshold a node
+ *          satisfies.  Values are kept sorted in ascending order.
  */
-typedef pci_vendor_devices_t * pci_vendor_devices_ptr; 
+typedef struct cpuinfo_tier_list {
+    unsigned int        count;                          /**< number of values in use */
+    double              value[CPUINFO_TIER_LIST_MAX];   /**< the threshold values */
+} cpuinfo_tier_list_t;
 
 /**
- * @brief   Summarize a vendor device list to stdout
- * @details Writes a summary of the vendors and each device associated
- *          with that vendor from the @a vendor_devices list
- * @param   vendor_devices  NUL-terminated list of vendor device pointers
+ * @brief   Parse a comma-separated tier list
+ * @details The values are sorted into ascending order; at most
+ *          CPUINFO_TIER_LIST_MAX values are accepted.  An empty string
+ *          yields an empty list.
+ * @param   tiers   the tier list to fill-in (unaltered on error)
+ * @param   text    immutable C string containing the list
+ * @return  Boolean false if the list is invalid
  */
-static void
-pci_vendor_devices_summary(
-    pci_vendor_devices_ptr  *vendor_devices
+static bool
+cpuinfo_config_parse_tiers_str(
+    cpuinfo_tier_list_t         *tiers,
+    const char                  *text
 )
 {
-    while ( vendor_devices && *vendor_devices ) {
-        pci_vendor_devices_t    *dev = *vendor_devices;
-        pci_device_feature_t    *features = &dev->device_features[0];
+    cpuinfo_tier_list_t         new_tiers = { .count = 0 };
+    
+    while ( *text ) {
+        char                    *endp = NULL;
+        double                  v = strtod(text, &endp);
+        unsigned int            i;
         
-        printf("0x%04X\n", dev->vendor_id);
-        while ( features->device_id ) {
-            printf("0x%04X 0x%04X %s\n", dev->vendor_id, features->device_id, features->feature_name);
-            features++;
+        if ( (endp == text) || ! (v >= 0.0) || (v > 1e15) ) return false;
+        if ( new_tiers.count == CPUINFO_TIER_LIST_MAX ) return false;
+        /* Insertion sort: */
+        i = new_tiers.count++;
+        while ( (i > 0) && (new_tiers.value[i - 1] > v) ) {
+            new_tiers.value[i] = new_tiers.value[i - 1];
+            i--;
         }
+        new_tiers.value[i] = v;
         
-        vendor_devices++;
+        while ( *endp && isspace(*endp) ) endp++;
+        if ( *endp == ',' ) endp++;
+        else if ( *endp ) return false;
+        while ( *endp && isspace(*endp) ) endp++;
+        text = endp;
     }
+    *tiers = new_tiers;
+    return true;
 }
 
 /**
- * @brief   Iterate the PCI buses and compile features associated with
- *          found devices
- * @details Find all devices matching the PCI @a device_class (as masked by
- *          @a device_class_mask) and if any appear in the @a vendor_devices
- *          list add their feature names to @out_features.
+ * @brief   Calibrated performance probe components
+ */
+typedef enum {
+    perf_component_fma          = 0,    /**< multiply-add throughput, GFLOP/s */
+    perf_component_membw        = 1,    /**< memory bandwidth, GB/s */
+    perf_component_memlat       = 2,    /**< memory latency, ns (lower is better) */
+    perf_component_freq         = 3,    /**< maximum core frequency, MHz */
+    perf_component_MAX,                 /**< Index just beyond the last defined component */
+    perf_component_START        = 0     /**< Index of the first component */
+} perf_component_t;
+
+/**
+ * @var     perf_component_strings
+ * @brief   names of the performance components
+ * @details ordered to match the @a perf_component_t enumeration; used in
+ *          configuration keywords, the cache file, and reported scores
+ */
+static const char* perf_component_strings[] = {
+        "FMA",
+        "MemBW",
+        "MemLat",
+        "Freq",
+        NULL
+    };
+
+/**
+ * @brief   Plugin configuration
+ * @details Fields in this data structure are filled-in by reading
+ *          the cpuinfo.conf file.  Any keyword not present in the file
+ *          retains the default value set by cpuinfo_config_init().
+ */
+typedef struct cpuinfo_config {
+    bool                perf_index;                             /**< run calibrated probes, publish PERF tiers */
+    const char          *perf_cache_file;                       /**< file in which probe results are cached */
+    unsigned int        perf_threads;                           /**< threads used by the throughput probes (0 = all CPUs) */
+    unsigned int        perf_buffer_mb;                         /**< megabytes of memory used by the memory probes */
+    double              perf_reference[perf_component_MAX];     /**< reference node component values */
+    cpuinfo_tier_list_t perf_tiers;                             /**< PERF::GE::<tier>x thresholds */
+    unsigned int        edac_ce_threshold;                      /**< correctable error growth marking a node unhealthy */
+    cpuinfo_tier_list_t mem_speed_tiers;                        /**< MEM::SPEED::GE::<tier> thresholds, MT/s */
+    cpuinfo_tier_list_t power_cap_tiers;                        /**< POWER::CAP::LE::<tier>W thresholds, watts */
+    const char          *fs_paths;                              /**< paths whose filesystems are reported */
+    cpuinfo_tier_list_t fs_tmpfs_tiers;                         /**< FS::TMPFS::GE::<tier>GB thresholds, GiB */
+    bool                hotplug_listener;                       /**< re-probe on CPU/PCI hotplug uevents */
+    unsigned int        hotplug_debounce_ms;                    /**< quiet period before re-probing, milliseconds */
+    unsigned int        probe_timeout_ms;                       /**< per-probe deadline, milliseconds (0 = none) */
+    unsigned int        probe_backoff;                          /**< seconds before a timed-out probe is retried */
+    const char          *catalog_file;                          /**< hardware catalog consulted before costly probes */
+    const char          *manifest_file;                         /**< image-baked feature manifest */
+    const char          *hwloc_xml_file;                        /**< slurmd's cached hwloc topology */
+    const char          *feature_allow;                         /**< namespaces/patterns that may be published */
+    const char          *feature_deny;                          /**< namespaces/patterns never published */
+    unsigned int        feature_max;                            /**< maximum features published (0 = unlimited) */
+    bool                isa_highest_only;                       /**< publish only the highest ISA feature */
+    const char          *mode_allow;                            /**< MODE:: namespaces/patterns jobs may select */
+    const char          *mode_users;                            /**< users (besides root and SlurmUser) who may change modes */
+    unsigned int        llc_ways;                               /**< L3 ways reserved by MODE::LLC::exclusive (0 = half) */
+    unsigned int        llc_mba_percent;                        /**< memory bandwidth left to other tasks under MODE::LLC::exclusive */
+    unsigned int        memclean_budget_ms;                     /**< longest MODE::MEMCLEAN::on may delay a job, milliseconds */
+    const char          *mode_state_file;                       /**< node-local record of the modes jobs changed */
+    const char          *reboot_command;                        /**< site command that queries and stages BIOS modes */
+    const char          *reboot_history_file;                   /**< shared file of measured reboot times */
+    unsigned int        reboot_time;                            /**< seconds a reboot takes before any is measured */
+    unsigned int        reboot_weight;                          /**< scheduling weight of nodes that need a reboot */
+    bool                reboot_power_save;                      /**< nodes are rebooted through PowerSave */
+} cpuinfo_config_t;
+
+/**
+ * @brief   Initialize a cpuinfo_config_t data structure to default values
+ * @param   config  pointer to the cpuinfo_config_t
+ * @return  Returns @a config (for chaining operations)
+ */
+static cpuinfo_config_t*
+cpuinfo_config_init(
+    cpuinfo_config_t    *config
+)
+{
+    memset(config, 0, sizeof(*config));
+    config->perf_threads = 1;
+    config->perf_buffer_mb = 64;
+    config->perf_tiers.count = 3;
+    config->perf_tiers.value[0] = 1.0;
+    config->perf_tiers.value[1] = 1.5;
+    config->perf_tiers.value[2] = 2.0;
+    config->edac_ce_threshold = 1;
+    cpuinfo_config_parse_tiers_str(&config->mem_speed_tiers, "2133,2400,2666,2933,3200,4800,5600,6400");
+    cpuinfo_config_parse_tiers_str(&config->power_cap_tiers, "150,200,250,300,350,400,500");
+    cpuinfo_config_parse_tiers_str(&config->fs_tmpfs_tiers, "16,32,64,128,256,512");
+    config->hotplug_debounce_ms = 2000;
+    config->probe_timeout_ms = 3000;
+    config->probe_backoff = 300;
+    config->llc_mba_percent = 50;
+    config->memclean_budget_ms = 10000;
+    config->reboot_time = 600;
+    config->reboot_weight = 0xFFFFFFFE;
+    return config;
+}
+
+/**
+ * @brief   Reset a cpuinfo_config_t data structure
+ * @details Disposes of any external memory associated with @a config --
+ *          namely any strings -- then restores all default values
+ * @param   config  pointer to the cpuinfo_config_t
+ * @return  Returns @a config (for chaining operations)
+ */
+static cpuinfo_config_t*
+cpuinfo_config_reset(
+    cpuinfo_config_t    *config
+)
+{
+    if ( config->perf_cache_file ) free((void*)config->perf_cache_file);
+    if ( config->catalog_file ) free((void*)config->catalog_file);
+    if ( config->manifest_file ) free((void*)config->manifest_file);
+    if ( config->hwloc_xml_file ) free((void*)config->hwloc_xml_file);
+    if ( config->feature_allow ) free((void*)config->feature_allow);
+    if ( config->feature_deny ) free((void*)config->feature_deny);
+    if ( config->fs_paths ) free((void*)config->fs_paths);
+    if ( config->mode_allow ) free((void*)config->mode_allow);
+    if ( config->mode_users ) free((void*)config->mode_users);
+    if ( config->mode_state_file ) free((void*)config->mode_state_file);
+    if ( config->reboot_command ) free((void*)config->reboot_command);
+    if ( config->reboot_history_file ) free((void*)config->reboot_history_file);
+    return cpuinfo_config_init(config);
+}
+
+/**
+ * @brief   Copy a cpuinfo_config_t data structure
+ * @details Strings are duplicated so that @a dst is independent of @a src
+ * @param   dst     pointer to the (uninitialized) cpuinfo_config_t to fill-in
+ * @param   src     pointer to the cpuinfo_config_t to copy
+ * @return  Returns @a dst (for chaining operations)
+ */
+static cpuinfo_config_t*
+cpuinfo_config_copy(
+    cpuinfo_config_t        *dst,
+    const cpuinfo_config_t  *src
+)
+{
+    *dst = *src;
+    if ( src->perf_cache_file ) dst->perf_cache_file = strdup(src->perf_cache_file);
+    if ( src->catalog_file ) dst->catalog_file = strdup(src->catalog_file);
+    if ( src->manifest_file ) dst->manifest_file = strdup(src->manifest_file);
+    if ( src->hwloc_xml_file ) dst->hwloc_xml_file = strdup(src->hwloc_xml_file);
+    if ( src->feature_allow ) dst->feature_allow = strdup(src->feature_allow);
+    if ( src->feature_deny ) dst->feature_deny = strdup(src->feature_deny);
+    if ( src->fs_paths ) dst->fs_paths = strdup(src->fs_paths);
+    if ( src->mode_allow ) dst->mode_allow = strdup(src->mode_allow);
+    if ( src->mode_users ) dst->mode_users = strdup(src->mode_users);
+    if ( src->mode_state_file ) dst->mode_state_file = strdup(src->mode_state_file);
+    if ( src->reboot_command ) dst->reboot_command = strdup(src->reboot_command);
+    if ( src->reboot_history_file ) dst->reboot_history_file = strdup(src->reboot_history_file);
+    return dst;
+}
+
+/**
+ * @brief   Opaque pointer to a configuration keyword record
+ */
+typedef struct cpuinfo_config_option * cpuinfo_config_option_ref;
+
+/**
+ * @brief   Type of a callback function that parses a configuration value
+ * @param   option  the registry struct for this keyword
+ * @param   config  pointer to the cpuinfo_config_t to fill-in
+ * @param   text    immutable C string containing the value
+ * @return  Boolean false should be returned if the value is invalid,
+ *          otherwise boolean true.
+ */
+typedef bool (*cpuinfo_config_parse_cb)(cpuinfo_config_option_ref option, cpuinfo_config_t *config, const char *text);
+
+/**
+ * @brief   Registration data structure for a configuration keyword
+ */
+typedef struct cpuinfo_config_option {
+    const char                  *keyword;       /**< The keyword to match in the config file */
+    cpuinfo_config_parse_cb     parse_cb;       /**< The parsing callback */
+    size_t                      arg_offset;     /**< Offset of the field in cpuinfo_config_t */
+    void                        *arg_pointer;   /**< Optional pointer associated with keyword */
+} cpuinfo_config_option_t;
+
+/**
+ * @brief   Config callback that parses a boolean value
+ * @details Accepts yes/no, true/false, on/off, and 1/0
+ */
+static bool
+cpuinfo_config_parse_bool(
+    cpuinfo_config_option_ref   option,
+    cpuinfo_config_t            *config,
+    const char                  *text
+)
+{
+    bool                        *b = (bool*)((void*)config + option->arg_offset);
+    
+    if ( ! strcasecmp(text, "yes") || ! strcasecmp(text, "true") || ! strcasecmp(text, "on") || ! strcmp(text, "1") ) {
+        *b = true;
+        return true;
+    }
+    if ( ! strcasecmp(text, "no") || ! strcasecmp(text, "false") || ! strcasecmp(text, "off") || ! strcmp(text, "0") ) {
+        *b = false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief   Config callback that copies a string value
+ */
+static bool
+cpuinfo_config_parse_strdup(
+    cpuinfo_config_option_ref   option,
+    cpuinfo_config_t            *config,
+    const char                  *text
+)
+{
+    char                        **s = (char**)((void*)config + option->arg_offset);
+    
+    if ( *s != NULL ) free((void*)*s);
+    *s = *text ? strdup(text) : NULL;
+    return true;
+}
+
+/**
+ * @brief   Characters that cannot appear in a path published as a feature
+ */
+#define FS_PROBE_PATH_REJECT    " \t&|!*()[]:"
+
+/**
+ * @brief   Config callback that copies the FsPaths list
+ * @details Every entry must be an absolute path that can be spelled in a
+ *          Slurm feature name.
+ */
+static bool
+cpuinfo_config_parse_fs_paths(
+    cpuinfo_config_option_ref   option,
+    cpuinfo_config_t            *config,
+    const char                  *text
+)
+{
+    const char                  *p = text;
+    
+    while ( *p ) {
+        const char              *e;
+        
+        while ( isspace((unsigned char)*p) || (*p == ',') ) p++;
+        if ( ! *p ) break;
+        if ( *p != '/' ) return false;
+        e = p;
+        while ( *e && (*e != ',') ) e++;
+        while ( (e > p) && isspace((unsigned char)*(e - 1)) ) e--;
+        while ( p < e ) if ( strchr(FS_PROBE_PATH_REJECT, *p++) ) return false;
+        while ( *p && (*p != ',') ) p++;
+    }
+    return cpuinfo_config_parse_strdup(option, config, text);
+}
+
+/**
+ * @brief   Config callback that parses an unsigned integer value
+ */
+static bool
+cpuinfo_config_parse_unsigned(
+    cpuinfo_config_option_ref   option,
+    cpuinfo_config_t            *config,
+    const char                  *text
+)
+{
+    unsigned int                *u = (unsigned int*)((void*)config + option->arg_offset);
+    char                        *endp = NULL;
+    unsigned long               v = strtoul(text, &endp, 0);
+    
+    if ( (endp == text) || *endp || (v > 0xFFFFFFFFUL) ) return false;
+    *u = (unsigned int)v;
+    return true;
+}
+
+/**
+ * @brief   Config callback that parses a non-negative real value
+ */
+static bool
+cpuinfo_config_parse_double(
+    cpuinfo_config_option_ref   option,
+    cpuinfo_config_t            *config,
+    const char                  *text
+)
+{
+    double                      *d = (double*)((void*)config + option->arg_offset);
+    char                        *endp = NULL;
+    double                      v = strtod(text, &endp);
+    
+    if ( (endp == text) || *endp || ! (v >= 0.0) || (v > 1e15) ) return false;
+    *d = v;
+    return true;
+}
+
+/**
+ * @brief   Config callback that parses a comma-separated tier list
+ */
+static bool
+cpuinfo_config_parse_tiers(
+    cpuinfo_config_option_ref   option,
+    cpuinfo_config_t            *config,
+    const char                  *text
+)
+{
+    return cpuinfo_config_parse_tiers_str((cpuinfo_tier_list_t*)((void*)config + option->arg_offset), text);
+}
+
+/**
+ * @var     cpuinfo_config_options
+ * @brief   The list of configuration keywords
+ * @details The list of configuration keyword callbacks and their string
+ *          identifier.  A struct with both fields' being NULL/0 acts as
+ *          the list terminator.
+ */
+static cpuinfo_config_option_t cpuinfo_config_options[] = {
+        { "AllowedModes", cpuinfo_config_parse_strdup, offsetof(cpuinfo_config_t, mode_allow), NULL },
+        { "AllowedUsers", cpuinfo_config_parse_strdup, offsetof(cpuinfo_config_t, mode_users), NULL },
+        { "CatalogFile", cpuinfo_config_parse_strdup, offsetof(cpuinfo_config_t, catalog_file), NULL },
+        { "EdacCeThreshold", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, edac_ce_threshold), NULL },
+        { "FeatureAllow", cpuinfo_config_parse_strdup, offsetof(cpuinfo_config_t, feature_allow), NULL },
+        { "FeatureDeny", cpuinfo_config_parse_strdup, offsetof(cpuinfo_config_t, feature_deny), NULL },
+        { "FeatureMax", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, feature_max), NULL },
+        { "FsPaths", cpuinfo_config_parse_fs_paths, offsetof(cpuinfo_config_t, fs_paths), NULL },
+        { "FsTmpfsTiers", cpuinfo_config_parse_tiers, offsetof(cpuinfo_config_t, fs_tmpfs_tiers), NULL },
+        { "HotplugDebounceMS", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, hotplug_debounce_ms), NULL },
+        { "HotplugListener", cpuinfo_config_parse_bool, offsetof(cpuinfo_config_t, hotplug_listener), NULL },
+        { "HwlocXmlFile", cpuinfo_config_parse_strdup, offsetof(cpuinfo_config_t, hwloc_xml_file), NULL },
+        { "IsaHighestOnly", cpuinfo_config_parse_bool, offsetof(cpuinfo_config_t, isa_highest_only), NULL },
+        { "LlcMbaPercent", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, llc_mba_percent), NULL },
+        { "LlcWays", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, llc_ways), NULL },
+        { "ManifestFile", cpuinfo_config_parse_strdup, offsetof(cpuinfo_config_t, manifest_file), NULL },
+        { "MemCleanBudgetMS", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, memclean_budget_ms), NULL },
+        { "MemSpeedTiers", cpuinfo_config_parse_tiers, offsetof(cpuinfo_config_t, mem_speed_tiers), NULL },
+        { "ModeStateFile", cpuinfo_config_parse_strdup, offsetof(cpuinfo_config_t, mode_state_file), NULL },
+        { "PerfBufferMB", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, perf_buffer_mb), NULL },
+        { "PerfCacheFile", cpuinfo_config_parse_strdup, offsetof(cpuinfo_config_t, perf_cache_file), NULL },
+        { "PerfIndex", cpuinfo_config_parse_bool, offsetof(cpuinfo_config_t, perf_index), NULL },
+        { "PerfReferenceFMA", cpuinfo_config_parse_double, offsetof(cpuinfo_config_t, perf_reference[perf_component_fma]), NULL },
+        { "PerfReferenceFreq", cpuinfo_config_parse_double, offsetof(cpuinfo_config_t, perf_reference[perf_component_freq]), NULL },
+        { "PerfReferenceMemBW", cpuinfo_config_parse_double, offsetof(cpuinfo_config_t, perf_reference[perf_component_membw]), NULL },
+        { "PerfReferenceMemLat", cpuinfo_config_parse_double, offsetof(cpuinfo_config_t, perf_reference[perf_component_memlat]), NULL },
+        { "PerfThreads", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, perf_threads), NULL },
+        { "PerfTiers", cpuinfo_config_parse_tiers, offsetof(cpuinfo_config_t, perf_tiers), NULL },
+        { "PowerCapTiers", cpuinfo_config_parse_tiers, offsetof(cpuinfo_config_t, power_cap_tiers), NULL },
+        { "ProbeBackoff", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, probe_backoff), NULL },
+        { "ProbeTimeoutMS", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, probe_timeout_ms), NULL },
+        { "RebootCommand", cpuinfo_config_parse_strdup, offsetof(cpuinfo_config_t, reboot_command), NULL },
+        { "RebootHistoryFile", cpuinfo_config_parse_strdup, offsetof(cpuinfo_config_t, reboot_history_file), NULL },
+        { "RebootPowerSave", cpuinfo_config_parse_bool, offsetof(cpuinfo_config_t, reboot_power_save), NULL },
+        { "RebootTime", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, reboot_time), NULL },
+        { "RebootWeight", cpuinfo_config_parse_unsigned, offsetof(cpuinfo_config_t, reboot_weight), NULL },
+        { NULL, NULL, 0, NULL }
+    };
+
+/**
+ * @brief   Split a "Keyword=Value" line into its two components
+ * @details Leading and trailing whitespace around the keyword and the value
+ *          are dropped.  The @a keyword_len characters at @a *keyword
+ *          form the keyword.
+ * @param   line            the line to split
+ * @param   keyword         pointer to the start of the keyword on return
+ * @param   keyword_len     number of characters in the keyword on return
+ * @param   value           pointer to the NUL-terminated value on return
+ * @return  Boolean false if the line is not of the expected form
+ */
+static bool
+cpuinfo_split_keyword_value(
+    const char      *line,
+    const char      **keyword,
+    size_t          *keyword_len,
+    const char      **value
+)
+{
+    const char      *keyword_end;
+    
+    while ( *line && isspace(*line) ) line++;
+    *keyword = line;
+    while ( *line && (*line != '=') ) line++;
+    if ( *line != '=' ) return false;
+    keyword_end = line;
+    while ( (keyword_end > *keyword) && isspace(*(keyword_end - 1)) ) keyword_end--;
+    if ( keyword_end == *keyword ) return false;
+    *keyword_len = keyword_end - *keyword;
+    line++;
+    while ( *line && isspace((unsigned char)*line) ) line++;
+    *value = line;
+    return true;
+}
+
+/**
+ * @brief   Parse a plugin configuration file
+ * @details The file consists of "Keyword=Value" lines; blank lines and
+ *          text following a '#' are ignored.  Keywords are matched
+ *          case-insensitively.  A missing file is not an error, the
+ *          defaults are used in that case.
+ * @param   config      pointer to the cpuinfo_config_t to fill-in; it should
+ *                      have been initialized by the caller
+ * @param   filename    the file to read
+ * @return  Boolean false if the file contained invalid lines, otherwise
+ *          boolean true.
+ */
+static HARNESS_UNUSED bool
+cpuinfo_config_parse_file(
+    cpuinfo_config_t    *config,
+    const char          *filename
+)
+{
+    line_reader_t       *line_reader = line_reader_create(filename, 0);
+    bool                is_okay = true;
+    
+    if ( line_reader ) {
+        const char      *line;
+        unsigned int    line_no = 0;
+        
+        while ( (line = line_reader_nextline(line_reader)) ) {
+            cpuinfo_config_option_t *option = cpuinfo_config_options;
+            char                    *comment = strchr(line, '#');
+            const char              *keyword, *value;
+            size_t                  keyword_len;
+            
+            line_no++;
+            if ( comment ) *comment = '\0', line_reader->used = (comment - line) + 1;
+            line_reader_trim(line_reader);
+            if ( *line == '\0' ) continue;
+            if ( ! cpuinfo_split_keyword_value(line, &keyword, &keyword_len, &value) ) {
+                error("%s:%u: invalid configuration line", filename, line_no);
+                is_okay = false;
+                continue;
+            }
+            while ( option->keyword ) {
+                if ( (strlen(option->keyword) == keyword_len) && (strncasecmp(option->keyword, keyword, keyword_len) == 0) ) break;
+                option++;
+            }
+            if ( ! option->keyword ) {
+                error("%s:%u: unknown keyword %.*s", filename, line_no, (int)keyword_len, keyword);
+                is_okay = false;
+            }
+            else if ( ! option->parse_cb(option, config, value) ) {
+                error("%s:%u: invalid value for %s: %s", filename, line_no, option->keyword, value);
+                is_okay = false;
+            }
+        }
+        line_reader_free(&line_reader);
+    }
+    return is_okay;
+}
+
+/**
+ * @brief   Results of the calibrated performance probes
+ * @details The measured component values are kept in the units of the
+ *          @a perf_component_t enumeration.  Each score is the ratio of
+ *          the measured value to the configured reference node's value
+ *          (inverted for latency, so larger is always better) and the
+ *          index is the geometric mean of all scored components.
+ */
+typedef struct perf_probe_results {
+    bool                is_valid;                       /**< the values have been measured or loaded */
+    double              value[perf_component_MAX];      /**< measured component values */
+    double              score[perf_component_MAX];      /**< component scores (0 if not scored) */
+    double              index;                          /**< composite performance index */
+} perf_probe_results_t;
+
+/**
+ * @brief   Minimum number of seconds each timed probe kernel should run
+ */
+#define PERF_PROBE_MIN_SECONDS  0.05
+
+/**
+ * @brief   Current value of the monotonic clock in seconds
+ */
+static double
+perf_probe_now(void)
+{
+    struct timespec     ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+/**
+ * @brief   Sink for probe kernel results so the compiler cannot discard
+ *          the work
+ */
+static volatile double perf_probe_sink;
+
+/**
+ * @brief   Per-thread state for the throughput probes
+ */
+typedef struct perf_probe_thread {
+    pthread_t           thread;         /**< the thread running the kernel */
+    size_t              size;           /**< kernel-specific problem size */
+    double              rate;           /**< measured rate (kernel-specific units) */
+} perf_probe_thread_t;
+
+/**
+ * @brief   Multiply-add throughput kernel
+ * @details Sixteen independent multiply-add chains are iterated until at
+ *          least PERF_PROBE_MIN_SECONDS have elapsed.  The rate is
+ *          reported in GFLOP/s.
+ * @param   arg     pointer to the thread's perf_probe_thread_t
+ */
+static void*
+perf_probe_fma_kernel(
+    void                *arg
+)
+{
+    perf_probe_thread_t *t = (perf_probe_thread_t*)arg;
+    double              acc[16], m = 1.0000001, a = 1e-9, elapsed, sum = 0.0;
+    unsigned long       iterations = 1UL << 16, n, total = 0;
+    double              start = perf_probe_now();
+    int                 i;
+    
+    for ( i = 0; i < 16; i++ ) acc[i] = (double)i;
+    do {
+        for ( n = 0; n < iterations; n++ ) {
+            for ( i = 0; i < 16; i++ ) acc[i] = acc[i] * m + a;
+        }
+        total += iterations;
+        iterations *= 2;
+        elapsed = perf_probe_now() - start;
+    } while ( elapsed < PERF_PROBE_MIN_SECONDS );
+    for ( i = 0; i < 16; i++ ) sum += acc[i];
+    perf_probe_sink = sum;
+    t->rate = (2.0 * 16.0 * (double)total) / elapsed * 1e-9;
+    return NULL;
+}
+
+/**
+ * @brief   Memory bandwidth (triad) kernel
+ * @details Three arrays of @a size bytes total are allocated and the
+ *          a = b + s * c triad is repeated until at least
+ *          PERF_PROBE_MIN_SECONDS have elapsed.  The best pass is reported
+ *          in GB/s.
+ * @param   arg     pointer to the thread's perf_probe_thread_t
+ */
+static void*
+perf_probe_membw_kernel(
+    void                *arg
+)
+{
+    perf_probe_thread_t *t = (perf_probe_thread_t*)arg;
+    size_t              n = t->size / (3 * sizeof(double)), i;
+    double              *a, *b, *c, best = 0.0, start = perf_probe_now();
+    
+    t->rate = 0.0;
+    if ( n == 0 ) return NULL;
+    a = (double*)malloc(3 * n * sizeof(double));
+    if ( ! a ) return NULL;
+    b = a + n;
+    c = b + n;
+    for ( i = 0; i < n; i++ ) a[i] = 0.0, b[i] = 1.0, c[i] = 2.0;
+    do {
+        double          pass_start = perf_probe_now(), pass;
+        
+        for ( i = 0; i < n; i++ ) a[i] = b[i] + 3.0 * c[i];
+        pass = perf_probe_now() - pass_start;
+        if ( (pass > 0.0) && ((best == 0.0) || (pass < best)) ) best = pass;
+    } while ( perf_probe_now() - start < PERF_PROBE_MIN_SECONDS );
+    perf_probe_sink = a[n / 2];
+    if ( best > 0.0 ) t->rate = (3.0 * (double)n * sizeof(double)) / best * 1e-9;
+    free((void*)a);
+    return NULL;
+}
+
+/**
+ * @brief   Run a throughput kernel on several threads at once
+ * @param   kernel      the kernel function
+ * @param   nthreads    number of threads to run
+ * @param   size        kernel problem size per thread
+ * @return  The sum of the per-thread rates
+ */
+static double
+perf_probe_run_threads(
+    void*               (*kernel)(void*),
+    unsigned int        nthreads,
+    size_t              size
+)
+{
+    perf_probe_thread_t *threads = (perf_probe_thread_t*)calloc(nthreads, sizeof(perf_probe_thread_t));
+    unsigned int        i, started = 0;
+    double              rate = 0.0;
+    
+    if ( ! threads ) return 0.0;
+    for ( i = 0; i < nthreads; i++ ) {
+        threads[i].size = size;
+        if ( pthread_create(&threads[i].thread, NULL, kernel, &threads[i]) != 0 ) break;
+        started++;
+    }
+    for ( i = 0; i < started; i++ ) {
+        pthread_join(threads[i].thread, NULL);
+        rate += threads[i].rate;
+    }
+    free((void*)threads);
+    return rate;
+}
+
+/**
+ * @brief   Memory latency probe
+ * @details A single random cycle through a buffer of @a bytes bytes is
+ *          built with one element per 64-byte cache line, then chased
+ *          until at least PERF_PROBE_MIN_SECONDS have elapsed.
+ * @param   bytes   size of the buffer to chase through
+ * @return  The average load-to-use latency in nanoseconds (0 on error)
+ */
+static double
+perf_probe_memlat(
+    size_t              bytes
+)
+{
+    const size_t        stride = 64 / sizeof(size_t);
+    size_t              n = bytes / 64, i, p = 0, *chain;
+    unsigned long long  seed = 0x9E3779B97F4A7C15ULL, loads = 0;
+    double              start, elapsed;
+    
+    if ( n < 2 ) return 0.0;
+    chain = (size_t*)malloc(n * 64);
+    if ( ! chain ) return 0.0;
+    /* Sattolo's algorithm yields a single cycle through all n lines: */
+    for ( i = 0; i < n; i++ ) chain[i * stride] = i;
+    for ( i = n - 1; i > 0; i-- ) {
+        size_t          j, tmp;
+        
+        seed ^= seed << 13, seed ^= seed >> 7, seed ^= seed << 17;
+        j = (size_t)(seed % i);
+        tmp = chain[i * stride], chain[i * stride] = chain[j * stride], chain[j * stride] = tmp;
+    }
+    start = perf_probe_now();
+    do {
+        for ( i = 0; i < 65536; i++ ) p = chain[p * stride];
+        loads += 65536;
+        elapsed = perf_probe_now() - start;
+    } while ( elapsed < PERF_PROBE_MIN_SECONDS );
+    perf_probe_sink = (double)p;
+    free((void*)chain);
+    return elapsed / (double)loads * 1e9;
+}
+
+/**
+ * @brief   Maximum core frequency probe
+ * @details The cpufreq maximum frequency is preferred; the clock speed
+ *          reported in cpuinfo is used in its absence.
+ * @param   cif     the node's cpuinfo features
+ * @return  The frequency in MHz (0 if unknown)
+ */
+static double
+perf_probe_freq(
+    cpuinfo_features_t  *cif
+)
+{
+    FILE                *fptr = fopen("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", "r");
+    unsigned long       khz = 0;
+    
+    if ( fptr ) {
+        if ( fscanf(fptr, "%lu", &khz) != 1 ) khz = 0;
+        fclose(fptr);
+    }
+    if ( khz ) return (double)khz / 1000.0;
+    return (double)cif->cpu_mhz;
+}
+
+/**
+ * @brief   Load cached probe results
+ * @details The cache file is only honored if the CPU model recorded in it
+ *          matches the node's current model.
+ * @param   results     the results to fill-in
+ * @param   cif         the node's cpuinfo features
+ * @param   filename    the cache file to read
+ * @return  Boolean true if all components were loaded from the cache
+ */
+static bool
+perf_probe_cache_load(
+    perf_probe_results_t    *results,
+    cpuinfo_features_t      *cif,
+    const char              *filename
+)
+{
+    line_reader_t           *line_reader = line_reader_create(filename, 0);
+    unsigned int            found = 0;
+    bool                    is_model_okay = false;
+    
+    if ( ! line_reader ) return false;
+    memset(results, 0, sizeof(*results));
+    while ( line_reader_nextline(line_reader) ) {
+        const char          *line, *keyword, *value;
+        size_t              keyword_len;
+        perf_component_t    c;
+        
+        line_reader_trim(line_reader);
+        line = line_reader_getline(line_reader);
+        if ( (*line == '#') || ! cpuinfo_split_keyword_value(line, &keyword, &keyword_len, &value) ) continue;
+        if ( (keyword_len == 5) && ! strncasecmp(keyword, "Model", 5) ) {
+            is_model_okay = ! strcmp(value, cif->model_name ? cif->model_name : "");
+            continue;
+        }
+        for ( c = perf_component_START; c < perf_component_MAX; c++ ) {
+            if ( (strlen(perf_component_strings[c]) == keyword_len) && ! strncasecmp(keyword, perf_component_strings[c], keyword_len) ) {
+                results->value[c] = strtod(value, NULL);
+                found |= 1 << c;
+                break;
+            }
+        }
+    }
+    line_reader_free(&line_reader);
+    results->is_valid = is_model_okay && (found == (1 << perf_component_MAX) - 1);
+    return results->is_valid;
+}
+
+/**
+ * @brief   Save probe results to the cache file
+ * @param   results     the results to write
+ * @param   cif         the node's cpuinfo features
+ * @param   filename    the cache file to write
+ * @return  Boolean true if the file was written
+ */
+static bool
+perf_probe_cache_save(
+    perf_probe_results_t    *results,
+    cpuinfo_features_t      *cif,
+    const char              *filename
+)
+{
+    FILE                    *fptr = fopen(filename, "w");
+    perf_component_t        c;
+    bool                    is_okay;
+    
+    if ( ! fptr ) return false;
+    fprintf(fptr, "# node_features/cpuinfo calibrated probe results\nModel=%s\n", cif->model_name ? cif->model_name : "");
+    for ( c = perf_component_START; c < perf_component_MAX; c++ ) fprintf(fptr, "%s=%.6g\n", perf_component_strings[c], results->value[c]);
+    is_okay = ! ferror(fptr);
+    if ( fclose(fptr) != 0 ) is_okay = false;
+    return is_okay;
+}
+
+/**
+ * @brief   Compute the component scores and composite index
+ * @details Components for which no reference value is configured or no
+ *          value was measured are not scored.
+ * @param   results     the results to score
+ * @param   config      the plugin configuration
+ */
+static void
+perf_probe_score(
+    perf_probe_results_t    *results,
+    cpuinfo_config_t        *config
+)
+{
+    perf_component_t        c;
+    double                  log_sum = 0.0;
+    unsigned int            n_scored = 0;
+    
+    results->index = 0.0;
+    for ( c = perf_component_START; c < perf_component_MAX; c++ ) {
+        double              ref = config->perf_reference[c], value = results->value[c];
+        
+        results->score[c] = 0.0;
+        if ( (ref > 0.0) && (value > 0.0) ) {
+            results->score[c] = ( c == perf_component_memlat ) ? (ref / value) : (value / ref);
+            log_sum += log(results->score[c]);
+            n_scored++;
+        }
+    }
+    if ( n_scored ) results->index = exp(log_sum / (double)n_scored);
+}
+
+/**
+ * @brief   Measure (or load from cache) and score the calibrated probes
+ * @details If @a results is already valid, only the scoring is redone (so
+ *          a reconfiguration with new reference values does not re-run the
+ *          microbenchmarks).
+ * @param   results     the results to fill-in
+ * @param   config      the plugin configuration
+ * @param   cif         the node's cpuinfo features
+ * @return  Boolean true if @a results is valid on return
+ */
+static bool
+perf_probe_run(
+    perf_probe_results_t    *results,
+    cpuinfo_config_t        *config,
+    cpuinfo_features_t      *cif
+)
+{
+    if ( ! results->is_valid && ! (config->perf_cache_file && perf_probe_cache_load(results, cif, config->perf_cache_file)) ) {
+        unsigned int        nthreads = config->perf_threads;
+        size_t              bytes = (size_t)config->perf_buffer_mb << 20;
+        
+        if ( nthreads == 0 ) {
+            long            ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+            nthreads = ( ncpu > 0 ) ? (unsigned int)ncpu : 1;
+        }
+        memset(results, 0, sizeof(*results));
+        results->value[perf_component_fma] = perf_probe_run_threads(perf_probe_fma_kernel, nthreads, 0);
+        results->value[perf_component_membw] = perf_probe_run_threads(perf_probe_membw_kernel, nthreads, bytes / nthreads);
+        results->value[perf_component_memlat] = perf_probe_memlat(bytes);
+        results->value[perf_component_freq] = perf_probe_freq(cif);
+        results->is_valid = true;
+        debug("perf_probe_run: FMA=%.3g GFLOP/s, MemBW=%.3g GB/s, MemLat=%.3g ns, Freq=%.0f MHz",
+                    results->value[perf_component_fma], results->value[perf_component_membw],
+                    results->value[perf_component_memlat], results->value[perf_component_freq]);
+        if ( config->perf_cache_file && ! perf_probe_cache_save(results, cif, config->perf_cache_file) ) {
+            error("perf_probe_run: unable to write cache file %s", config->perf_cache_file);
+        }
+    }
+    perf_probe_score(results, config);
+    return results->is_valid;
+}
+
+/**
+ * @brief   Append a tier threshold to a feature string
+ * @details Integral thresholds are written with a single decimal place
+ *          (e.g. 1.0) and others with as many as they need (e.g. 0.75).
+ */
+static void
+cpuinfo_tier_fmtcat(
+    char                **features,
+    const char          *prefix,
+    double              tier,
+    const char          *suffix
+)
+{
+    if ( tier == floor(tier) ) {
+        xstrfmtcat(*features, "%s%.1f%s", prefix, tier, suffix);
+    } else {
+        xstrfmtcat(*features, "%s%g%s", prefix, tier, suffix);
+    }
+}
+
+/**
+ * @brief   Append the PERF::GE::<tier>x features the node satisfies
+ * @param   results     the scored probe results
+ * @param   config      the plugin configuration
+ * @param   features    pointer to the feature string to extend
+ * @param   delim       pointer to the current delimiter
+ */
+static void
+perf_probe_features(
+    perf_probe_results_t    *results,
+    cpuinfo_config_t        *config,
+    char                    **features,
+    const char              **delim
+)
+{
+    unsigned int            i;
+    
+    if ( ! results->is_valid || (results->index <= 0.0) ) return;
+    for ( i = 0; i < config->perf_tiers.count; i++ ) {
+        if ( results->index < config->perf_tiers.value[i] ) break;
+        xstrfmtcat(*features, "%s", *delim);
+        cpuinfo_tier_fmtcat(features, "PERF::GE::", config->perf_tiers.value[i], "x");
+        *delim = ",";
+    }
+}
+
+/**
+ * @brief   Maximum number of populated memory channels tracked by the
+ *          EDAC probe
+ */
+#define EDAC_PROBE_MAX_CHANNELS 256
+
+/**
+ * @brief   Results of the EDAC memory controller probe
+ */
+typedef struct edac_probe_results {
+    bool                is_present;         /**< EDAC DIMM records were found */
+    bool                is_balanced;        /**< every socket has the same channel population */
+    bool                is_ce_high;         /**< correctable errors grew past the threshold since the last probe */
+    bool                has_ce_baseline;    /**< @a ce_count holds a previous probe's total */
+    unsigned int        n_sockets;          /**< number of sockets with populated channels */
+    unsigned int        n_channels;         /**< number of populated channels */
+    unsigned long long  ce_count;           /**< total correctable error count */
+} edac_probe_results_t;
+
+/**
+ * @brief   A populated memory channel seen by the EDAC probe
+ */
+typedef struct edac_channel {
+    int                 socket;             /**< socket (NUMA node) of the memory controller */
+    int                 mc;                 /**< memory controller index */
+    int                 channel;            /**< channel index on the controller */
+    unsigned long long  size_mb;            /**< megabytes of memory on the channel */
+} edac_channel_t;
+
+/**
+ * @brief   Extract the channel index from an EDAC dimm_location string
+ * @details Locations look like "channel 1 slot 0" or "csrow 2 channel 0";
+ *          the value following the "channel" label is returned.
+ * @param   location    the dimm_location value
+ * @return  The channel index or -1 if none is present
+ */
+static int
+edac_location_channel(
+    const char  *location
+)
+{
+    const char  *s = location;
+    
+    while ( (s = strstr(s, "channel")) != NULL ) {
+        if ( (s == location) || isspace(*(s - 1)) ) {
+            char    *endp = NULL;
+            long    v;
+            
+            s += 7;
+            v = strtol(s, &endp, 10);
+            if ( (endp > s) && (v >= 0) && (v < 0x10000) ) return (int)v;
+        } else {
+            s += 7;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief   Probe the EDAC memory controllers
+ * @details Every /sys/devices/system/edac/mc/mc<N>/dimm<M> with a non-zero
+ *          size is assigned to a channel of its memory controller and the
+ *          controller to a socket (the controller's NUMA node if known,
+ *          its index otherwise).  The population is balanced when every
+ *          socket has the same number of populated channels and every
+ *          populated channel holds the same amount of memory.  The
+ *          correctable error counts are summed and compared with the
+ *          previous probe's total.
+ * @param   results     the results to update; on entry they hold the
+ *                      previous probe's values
+ * @param   ce_threshold    growth in correctable errors that marks the
+ *                          node as unhealthy
+ * @return  Boolean true (the absence of EDAC is not an error)
+ */
+static bool
+edac_probe_run(
+    edac_probe_results_t    *results,
+    unsigned int            ce_threshold
+)
+{
+    edac_channel_t          *channels = NULL;
+    unsigned int            n_channels = 0, i;
+    char                    pattern[PATH_MAX];
+    glob_t                  dimms;
+    unsigned long long      prev_ce_count = results->ce_count;
+    bool                    has_prev = results->has_ce_baseline;
+    
+    memset(results, 0, sizeof(*results));
+    if ( ! sysfs_path(pattern, sizeof(pattern), "/sys/devices/system/edac/mc/mc*/dimm*") ) return true;
+    if ( glob(pattern, 0, NULL, &dimms) != 0 ) return true;
+    channels = (edac_channel_t*)calloc(EDAC_PROBE_MAX_CHANNELS, sizeof(edac_channel_t));
+    if ( ! channels ) {
+        globfree(&dimms);
+        return true;
+    }
+    for ( i = 0; i < dimms.gl_pathc; i++ ) {
+        const char          *dimm = dimms.gl_pathv[i], *mc_str;
+        char                path[PATH_MAX], location[128];
+        unsigned long long  size_mb = 0, ce = 0, numa_node;
+        int                 mc, socket, channel;
+        unsigned int        j;
+        
+        /* Correctable errors count even on unpopulated records: */
+        if ( snprintf(path, sizeof(path), "%s/dimm_ce_count", dimm) < sizeof(path) && sysfs_read_u64(path, &ce) ) {
+            results->ce_count += ce;
+        }
+        if ( snprintf(path, sizeof(path), "%s/size", dimm) >= sizeof(path) || ! sysfs_read_u64(path, &size_mb) || ! size_mb ) continue;
+        results->is_present = true;
+        
+        /* Memory controller index from the parent directory name: */
+        mc_str = strstr(dimm, "/mc/mc");
+        mc = mc_str ? atoi(mc_str + 6) : 0;
+        socket = mc;
+        if ( sysfs_path(path, sizeof(path), "/sys/devices/system/edac/mc/mc%d/device/numa_node", mc) && sysfs_read_u64(path, &numa_node) && (numa_node < 0x10000) ) {
+            socket = (int)numa_node;
+        }
+        channel = -1;
+        if ( snprintf(path, sizeof(path), "%s/dimm_location", dimm) < sizeof(path) && sysfs_read_str(path, location, sizeof(location)) ) {
+            channel = edac_location_channel(location);
+        }
+        if ( channel < 0 ) channel = atoi(strrchr(dimm, '/') + 5);
+        
+        for ( j = 0; j < n_channels; j++ ) {
+            if ( (channels[j].mc == mc) && (channels[j].channel == channel) ) break;
+        }
+        if ( j == n_channels ) {
+            if ( n_channels == EDAC_PROBE_MAX_CHANNELS ) continue;
+            channels[n_channels].socket = socket;
+            channels[n_channels].mc = mc;
+            channels[n_channels].channel = channel;
+            n_channels++;
+        }
+        channels[j].size_mb += size_mb;
+    }
+    globfree(&dimms);
+    
+    if ( results->is_present ) {
+        int                 sockets[EDAC_PROBE_MAX_CHANNELS];
+        unsigned int        per_socket[EDAC_PROBE_MAX_CHANNELS], j;
+        
+        results->n_channels = n_channels;
+        results->is_balanced = true;
+        for ( i = 0; i < n_channels; i++ ) {
+            if ( channels[i].size_mb != channels[0].size_mb ) results->is_balanced = false;
+            for ( j = 0; j < results->n_sockets; j++ ) if ( sockets[j] == channels[i].socket ) break;
+            if ( j == results->n_sockets ) {
+                sockets[j] = channels[i].socket;
+                per_socket[j] = 0;
+                results->n_sockets++;
+            }
+            per_socket[j]++;
+        }
+        for ( j = 1; j < results->n_sockets; j++ ) {
+            if ( per_socket[j] != per_socket[0] ) results->is_balanced = false;
+        }
+    }
+    free((void*)channels);
+    
+    results->has_ce_baseline = true;
+    if ( has_prev && (results->ce_count > prev_ce_count) && (results->ce_count - prev_ce_count >= ce_threshold) ) {
+        results->is_ce_high = true;
+    }
+    return true;
+}
+
+/**
+ * @brief   Append the MEM::CHANNELS and HEALTH::ECC_CE features
+ * @param   results     the EDAC probe results
+ * @param   features    pointer to the feature string to extend
+ * @param   delim       pointer to the current delimiter
+ */
+static void
+edac_probe_features(
+    edac_probe_results_t    *results,
+    char                    **features,
+    const char              **delim
+)
+{
+    if ( results->is_present ) {
+        xstrfmtcat(*features, "%sMEM::CHANNELS::%s", *delim, results->is_balanced ? "balanced" : "unbalanced"), *delim = ",";
+    }
+    if ( results->is_ce_high ) xstrfmtcat(*features, "%sHEALTH::ECC_CE::high", *delim), *delim = ",";
+}
+
+/**
+ * @brief   A memory device (SMBIOS type 17) record
+ */
+typedef struct dmi_memory_device {
+    bool                is_installed;       /**< a module is present in the slot */
+    unsigned int        type;               /**< SMBIOS memory type code */
+    unsigned int        speed;              /**< configured (or else maximum) speed, MT/s */
+    unsigned int        ranks;              /**< number of ranks (0 if unknown) */
+} dmi_memory_device_t;
+
+/**
+ * @brief   Results of the DMI memory device probe
+ * @details The node's memory runs at the speed of its slowest module, so
+ *          the lowest speed and rank count of all installed modules are
+ *          kept.  The type is zero if the modules are of mixed types.
+ */
+typedef struct dmi_memory_results {
+    bool                is_present;         /**< installed memory devices were found */
+    unsigned int        n_devices;          /**< number of installed memory devices */
+    unsigned int        type;               /**< SMBIOS memory type code (0 if mixed) */
+    unsigned int        speed;              /**< lowest speed, MT/s (0 if unknown) */
+    unsigned int        ranks;              /**< lowest rank count (0 if unknown) */
+} dmi_memory_results_t;
+
+/**
+ * @brief   Map an SMBIOS memory type code to a feature name
+ */
+typedef struct dmi_memory_type {
+    unsigned int        type;               /**< SMBIOS memory type code */
+    const char          *name;              /**< name used in features */
+} dmi_memory_type_t;
+
+/**
+ * @var     dmi_memory_types
+ * @brief   The SMBIOS memory type codes the plugin names
+ * @details A struct with both fields' being NULL/0 acts as the list
+ *          terminator.
+ */
+static const dmi_memory_type_t dmi_memory_types[] = {
+        { 0x12, "DDR" },
+        { 0x13, "DDR2" },
+        { 0x18, "DDR3" },
+        { 0x1A, "DDR4" },
+        { 0x1B, "LPDDR" },
+        { 0x1C, "LPDDR2" },
+        { 0x1D, "LPDDR3" },
+        { 0x1E, "LPDDR4" },
+        { 0x20, "HBM" },
+        { 0x21, "HBM2" },
+        { 0x22, "DDR5" },
+        { 0x23, "LPDDR5" },
+        { 0x24, "HBM3" },
+        { 0x00, NULL }
+    };
+
+/**
+ * @brief   Lookup the feature name of an SMBIOS memory type code
+ * @return  @a NULL if the code is not named
+ */
+static const char*
+dmi_memory_type_name(
+    unsigned int    type
+)
+{
+    const dmi_memory_type_t *types = dmi_memory_types;
+    
+    while ( types->name ) {
+        if ( types->type == type ) return types->name;
+        types++;
+    }
+    return NULL;
+}
+
+/**
+ * @brief   Little-endian WORD at an offset in an SMBIOS structure
+ */
+#define DMI_WORD(__raw, __off) ((unsigned int)(__raw)[(__off)] | ((unsigned int)(__raw)[(__off) + 1] << 8))
+
+/**
+ * @brief   Little-endian DWORD at an offset in an SMBIOS structure
+ */
+#define DMI_DWORD(__raw, __off) (DMI_WORD(__raw, __off) | (DMI_WORD(__raw, (__off) + 2) << 16))
+
+/**
+ * @brief   Decode the formatted area of an SMBIOS type 17 structure
+ * @details Fields beyond the structure's declared length (older SMBIOS
+ *          versions) are treated as unknown.  The configured speed is
+ *          preferred over the maximum speed, and the extended speed
+ *          fields are used when the WORD fields hold 0xFFFF.
+ * @param   raw     the raw structure (as read from the DMI sysfs entry)
+ * @param   raw_len number of bytes at @a raw
+ * @param   dev     the memory device record to fill-in
+ * @return  Boolean false if @a raw is not a type 17 structure
+ */
+static bool
+dmi_memory_device_parse(
+    const unsigned char     *raw,
+    size_t                  raw_len,
+    dmi_memory_device_t     *dev
+)
+{
+    size_t                  len;
+    
+    memset(dev, 0, sizeof(*dev));
+    if ( (raw_len < 4) || (raw[0] != 17) ) return false;
+    len = raw[1];
+    if ( len > raw_len ) len = raw_len;
+    if ( len < 0x0E ) return false;
+    
+    dev->is_installed = ( DMI_WORD(raw, 0x0C) != 0 );
+    if ( len >= 0x13 ) dev->type = raw[0x12];
+    if ( len >= 0x17 ) {
+        dev->speed = DMI_WORD(raw, 0x15);
+        if ( dev->speed == 0xFFFF ) dev->speed = ( len >= 0x58 ) ? DMI_DWORD(raw, 0x54) : 0;
+    }
+    if ( len >= 0x1C ) dev->ranks = raw[0x1B] & 0x0F;
+    if ( len >= 0x22 ) {
+        unsigned int        configured = DMI_WORD(raw, 0x20);
+        
+        if ( configured == 0xFFFF ) configured = ( len >= 0x5C ) ? DMI_DWORD(raw, 0x58) : 0;
+        if ( configured ) dev->speed = configured;
+    }
+    return true;
+}
+
+/**
+ * @brief   Probe the DMI memory device records
+ * @details Every /sys/firmware/dmi/entries/17-<N>/raw is decoded and the
+ *          installed devices summarized.
+ * @param   results     the results to fill-in
+ * @return  Boolean true if the DMI entries could be read
+ */
+static bool
+dmi_memory_probe_run(
+    dmi_memory_results_t    *results
+)
+{
+    char                    pattern[PATH_MAX];
+    glob_t                  entries;
+    unsigned int            i;
+    
+    memset(results, 0, sizeof(*results));
+    if ( ! sysfs_path(pattern, sizeof(pattern), "/sys/firmware/dmi/entries/17-*/raw") ) return false;
+    if ( glob(pattern, 0, NULL, &entries) != 0 ) return false;
+    for ( i = 0; i < entries.gl_pathc; i++ ) {
+        unsigned char       raw[256];
+        size_t              raw_len = 0;
+        dmi_memory_device_t dev;
+        FILE                *fptr = fopen(entries.gl_pathv[i], "r");
+        
+        if ( ! fptr ) continue;
+        raw_len = fread(raw, 1, sizeof(raw), fptr);
+        fclose(fptr);
+        if ( ! dmi_memory_device_parse(raw, raw_len, &dev) || ! dev.is_installed ) continue;
+        
+        if ( results->n_devices++ == 0 ) {
+            results->is_present = true;
+            results->type = dev.type;
+            results->speed = dev.speed;
+            results->ranks = dev.ranks;
+        } else {
+            if ( dev.type != results->type ) results->type = 0;
+            if ( dev.speed && (! results->speed || (dev.speed < results->speed)) ) results->speed = dev.speed;
+            if ( dev.ranks && (! results->ranks || (dev.ranks < results->ranks)) ) results->ranks = dev.ranks;
+        }
+    }
+    globfree(&entries);
+    return true;
+}
+
+/**
+ * @brief   Append the MEM::<TYPE>::<speed>, MEM::SPEED::GE::<tier> and
+ *          MEM::RANKS::<n> features
+ * @param   results     the DMI memory probe results
+ * @param   config      the plugin configuration
+ * @param   features    pointer to the feature string to extend
+ * @param   delim       pointer to the current delimiter
+ */
+static void
+dmi_memory_probe_features(
+    dmi_memory_results_t    *results,
+    cpuinfo_config_t        *config,
+    char                    **features,
+    const char              **delim
+)
+{
+    const char              *type_name;
+    unsigned int            i;
+    
+    if ( ! results->is_present ) return;
+    if ( results->speed && (type_name = dmi_memory_type_name(results->type)) ) {
+        xstrfmtcat(*features, "%sMEM::%s::%u", *delim, type_name, results->speed), *delim = ",";
+    }
+    for ( i = 0; i < config->mem_speed_tiers.count; i++ ) {
+        if ( results->speed < config->mem_speed_tiers.value[i] ) break;
+        xstrfmtcat(*features, "%sMEM::SPEED::GE::%g", *delim, config->mem_speed_tiers.value[i]), *delim = ",";
+    }
+    if ( results->ranks ) xstrfmtcat(*features, "%sMEM::RANKS::%u", *delim, results->ranks), *delim = ",";
+}
+
+/**
+ * @brief   IOMMU DMA translation modes
+ */
+typedef enum {
+    iommu_mode_off          = 0,    /**< no IOMMU (or disabled) */
+    iommu_mode_pt           = 1,    /**< passthrough (identity) mapping */
+    iommu_mode_translated   = 2,    /**< DMA addresses are translated */
+    iommu_mode_MAX                  /**< Index just beyond the last defined mode */
+} iommu_mode_t;
+
+/**
+ * @var     iommu_mode_strings
+ * @brief   feature strings for the IOMMU modes
+ * @details ordered to match the @a iommu_mode_t enumeration
+ */
+static const char* iommu_mode_strings[] = {
+        "off",
+        "pt",
+        "translated",
+        NULL
+    };
+
+/**
+ * @brief   Results of the IOMMU probe
+ */
+typedef struct iommu_probe_results {
+    iommu_mode_t        mode;           /**< the DMA translation mode */
+    unsigned int        n_groups;       /**< number of IOMMU groups */
+} iommu_probe_results_t;
+
+/**
+ * @brief   Probe the IOMMU translation mode
+ * @details No IOMMU is in use if /sys/class/iommu is empty or no groups
+ *          exist.  Otherwise the default domain type of the groups
+ *          (identity versus DMA) is authoritative, with the kernel
+ *          command line (iommu=pt, iommu.passthrough=, intel_iommu=off,
+ *          amd_iommu=off) consulted on kernels that do not expose it.
+ * @param   results     the results to fill-in
+ * @return  Boolean true
+ */
+static bool
+iommu_probe_run(
+    iommu_probe_results_t   *results
+)
+{
+    char                    pattern[PATH_MAX], cmdline[4096], value[64];
+    glob_t                  matches;
+    unsigned int            i, n_identity = 0, n_dma = 0;
+    
+    memset(results, 0, sizeof(*results));
+    
+    /* Any IOMMU hardware units registered? */
+    if ( ! sysfs_path(pattern, sizeof(pattern), "/sys/class/iommu/*") || (glob(pattern, 0, NULL, &matches) != 0) ) return true;
+    globfree(&matches);
+    
+    /* Any groups, and of what type? */
+    if ( ! sysfs_path(pattern, sizeof(pattern), "/sys/kernel/iommu_groups/*") || (glob(pattern, 0, NULL, &matches) != 0) ) return true;
+    results->n_groups = matches.gl_pathc;
+    for ( i = 0; i < matches.gl_pathc; i++ ) {
+        char                path[PATH_MAX], type[32];
+        
+        if ( (snprintf(path, sizeof(path), "%s/type", matches.gl_pathv[i]) < sizeof(path)) && sysfs_read_str(path, type, sizeof(type)) ) {
+            if ( ! strcmp(type, "identity") ) n_identity++;
+            else if ( str_startswith(type, "DMA", -1) ) n_dma++;
+        }
+    }
+    globfree(&matches);
+    if ( n_dma ) {
+        results->mode = iommu_mode_translated;
+        return true;
+    }
+    if ( n_identity ) {
+        results->mode = iommu_mode_pt;
+        return true;
+    }
+    
+    /* Fall back to the kernel command line: */
+    results->mode = iommu_mode_translated;
+    if ( kernel_cmdline_read(cmdline, sizeof(cmdline)) ) {
+        if ( (kernel_cmdline_value(cmdline, "intel_iommu", value, sizeof(value)) && str_startswith(value, "off", -1)) ||
+             (kernel_cmdline_value(cmdline, "amd_iommu", value, sizeof(value)) && str_startswith(value, "off", -1)) ) {
+            results->mode = iommu_mode_off;
+        }
+        else if ( kernel_cmdline_value(cmdline, "iommu.passthrough", value, sizeof(value)) ) {
+            results->mode = ( (*value == '1') || (*value == 'y') || (*value == 'Y') ) ? iommu_mode_pt : iommu_mode_translated;
+        }
+        else if ( kernel_cmdline_value(cmdline, "iommu", value, sizeof(value)) ) {
+            if ( ! strcmp(value, "pt") ) results->mode = iommu_mode_pt;
+            else if ( ! strcmp(value, "off") ) results->mode = iommu_mode_off;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief   Maximum number of CPUs representable in a cpu_mask_t
+ */
+#define CPU_MASK_MAX_CPUS       8192
+
+/**
+ * @brief   A set of logical CPUs
+ */
+typedef struct cpu_mask {
+    uint64_t            bits[CPU_MASK_MAX_CPUS / 64];   /**< one bit per logical CPU */
+} cpu_mask_t;
+
+/**
+ * @brief   Parse a kernel CPU list (e.g. "0-3,8,10-11") into a mask
+ * @details A range may carry a ":<used>/<group>" stride suffix, which
+ *          selects the first <used> CPUs of each <group> CPUs in the range
+ *          (e.g. "0-7:2/4" is CPUs 0, 1, 4 and 5); a malformed stride
+ *          drops the range, as the kernel rejects it.  Non-numeric items
+ *          such as the "domain" and "managed_irq" flags accepted by
+ *          isolcpus are skipped, as are the "(null)" and empty values
+ *          sysfs uses for an empty list.  CPUs beyond CPU_MASK_MAX_CPUS
+ *          are ignored.
+ * @param   mask    the mask to fill-in (cleared first)
+ * @param   text    the CPU list
+ * @return  The number of CPUs in the mask
+ */
+static unsigned int
+cpu_mask_parse_list(
+    cpu_mask_t          *mask,
+    const char          *text
+)
+{
+    unsigned int        count = 0;
+    
+    memset(mask, 0, sizeof(*mask));
+    while ( *text ) {
+        if ( isdigit(*text) ) {
+            char            *endp = NULL;
+            unsigned long   first = strtoul(text, &endp, 10), last = first, used = 1, group = 1, cpu, i;
+            bool            is_valid = true;
+            
+            text = endp;
+            if ( (*text == '-') && isdigit(*(text + 1)) ) {
+                last = strtoul(text + 1, &endp, 10);
+                text = endp;
+                if ( *text == ':' ) {
+                    used = group = 0;
+                    if ( isdigit(*(text + 1)) ) {
+                        used = strtoul(text + 1, &endp, 10);
+                        text = endp;
+                        if ( (*text == '/') && isdigit(*(text + 1)) ) {
+                            group = strtoul(text + 1, &endp, 10);
+                            text = endp;
+                        }
+                    }
+                    is_valid = used && (used <= group);
+                }
+            }
+            while ( *text && (*text != ',') ) text++;
+            if ( last >= CPU_MASK_MAX_CPUS ) last = CPU_MASK_MAX_CPUS - 1;
+            for ( cpu = first; is_valid && (cpu <= last); cpu += group ) {
+                for ( i = cpu; (i < cpu + used) && (i <= last); i++ ) {
+                    if ( ! (mask->bits[i / 64] & (1ULL << (i % 64))) ) {
+                        mask->bits[i / 64] |= 1ULL << (i % 64);
+                        count++;
+                    }
+                }
+            }
+        } else {
+            while ( *text && (*text != ',') ) text++;
+        }
+        if ( *text == ',' ) text++;
+    }
+    return count;
+}
+
+/**
+ * @brief   Count the CPUs in a mask
+ */
+static unsigned int
+cpu_mask_count(
+    const cpu_mask_t    *mask
+)
+{
+    unsigned int        i, count = 0;
+    
+    for ( i = 0; i < CPU_MASK_MAX_CPUS / 64; i++ ) count += __builtin_popcountll(mask->bits[i]);
+    return count;
+}
+
+/**
+ * @brief   Results of the CPU isolation probe
+ */
+typedef struct isolation_probe_results {
+    cpu_mask_t          isolated;       /**< CPUs isolated from the scheduler (isolcpus) */
+    cpu_mask_t          nohz_full;      /**< CPUs running tickless (nohz_full) */
+    cpu_mask_t          rcu_nocbs;      /**< CPUs with RCU callbacks offloaded (rcu_nocbs) */
+    bool                has_rcu_nocbs;  /**< rcu_nocbs given, possibly without a CPU list */
+} isolation_probe_results_t;
+
+/**
+ * @brief   Probe the CPU isolation configuration
+ * @details The isolated and nohz_full CPU lists under
+ *          /sys/devices/system/cpu reflect what the kernel actually
+ *          applied; the isolcpus= and nohz_full= kernel parameters are
+ *          used only on kernels that lack those files.  The rcu_nocbs=
+ *          parameter is only available from the command line; given
+ *          without a CPU list it offloads no CPU at boot but lets cpusets
+ *          offload them at runtime, so it still counts.
+ * @param   results     the results to fill-in
+ * @return  Boolean true
+ */
+static bool
+isolation_probe_run(
+    isolation_probe_results_t   *results
+)
+{
+    char                        path[PATH_MAX], cmdline[4096], list[4096];
+    bool                        has_cmdline = kernel_cmdline_read(cmdline, sizeof(cmdline));
+    
+    memset(results, 0, sizeof(*results));
+    if ( sysfs_path(path, sizeof(path), "/sys/devices/system/cpu/isolated") && sysfs_read_str(path, list, sizeof(list)) ) {
+        cpu_mask_parse_list(&results->isolated, list);
+    }
+    else if ( has_cmdline && kernel_cmdline_value(cmdline, "isolcpus", list, sizeof(list)) ) {
+        cpu_mask_parse_list(&results->isolated, list);
+    }
+    if ( sysfs_path(path, sizeof(path), "/sys/devices/system/cpu/nohz_full") && sysfs_read_str(path, list, sizeof(list)) ) {
+        cpu_mask_parse_list(&results->nohz_full, list);
+    }
+    else if ( has_cmdline && kernel_cmdline_value(cmdline, "nohz_full", list, sizeof(list)) ) {
+        cpu_mask_parse_list(&results->nohz_full, list);
+    }
+    if ( has_cmdline && kernel_cmdline_value(cmdline, "rcu_nocbs", list, sizeof(list)) ) {
+        cpu_mask_parse_list(&results->rcu_nocbs, list);
+        results->has_rcu_nocbs = true;
+    }
+    return true;
+}
+
+/**
+ * @brief   Append the ISOL::cores::<n>, NOHZ::full and NOHZ::rcu_nocbs
+ *          features
+ * @param   results     the CPU isolation probe results
+ * @param   features    pointer to the feature string to extend
+ * @param   delim       pointer to the current delimiter
+ */
+static void
+isolation_probe_features(
+    isolation_probe_results_t   *results,
+    char                        **features,
+    const char                  **delim
+)
+{
+    unsigned int                n_isolated = cpu_mask_count(&results->isolated);
+    
+    if ( n_isolated ) xstrfmtcat(*features, "%sISOL::cores::%u", *delim, n_isolated), *delim = ",";
+    if ( cpu_mask_count(&results->nohz_full) ) xstrfmtcat(*features, "%sNOHZ::full", *delim), *delim = ",";
+    if ( results->has_rcu_nocbs ) xstrfmtcat(*features, "%sNOHZ::rcu_nocbs", *delim), *delim = ",";
+}
+
+/**
+ * @brief   RAPL power domains
+ */
+typedef enum {
+    rapl_domain_pkg     = 0,    /**< processor package */
+    rapl_domain_core,           /**< cores (PP0) */
+    rapl_domain_uncore,         /**< uncore/integrated graphics (PP1) */
+    rapl_domain_dram,           /**< memory */
+    rapl_domain_psys,           /**< platform */
+    rapl_domain_MAX
+} rapl_domain_t;
+
+/**
+ * @brief   Feature names of the rapl_domain_t values
+ */
+static const char* rapl_domain_strings[] = {
+        "pkg",
+        "core",
+        "uncore",
+        "dram",
+        "psys"
+    };
+
+/**
+ * @brief   Zone names (or name prefixes) the powercap framework uses for
+ *          the rapl_domain_t values
+ */
+static const char* rapl_domain_zone_names[] = {
+        "package",
+        "core",
+        "uncore",
+        "dram",
+        "psys"
+    };
+
+/**
+ * @brief   Results of the RAPL probe
+ */
+typedef struct rapl_probe_results {
+    unsigned int        domains;        /**< mask of rapl_domain_t with a readable energy counter */
+    unsigned long long  pkg_cap_uw;     /**< lowest enabled long-term package power limit, microwatts (0 = none) */
+} rapl_probe_results_t;
+
+/**
+ * @brief   Read a package zone's long-term power limit
+ * @details The constraint named "long_term" is preferred; zones lacking
+ *          constraint names use constraint 0, which the RAPL driver always
+ *          registers as the long-term limit.
+ * @param   zone        path to the powercap zone directory
+ * @param   limit_uw    pointer to the limit to fill-in
+ * @return  Boolean true if a non-zero limit was read
+ */
+static bool
+rapl_zone_power_limit(
+    const char          *zone,
+    unsigned long long  *limit_uw
+)
+{
+    char                path[PATH_MAX], name[64];
+    int                 constraint = 0, i;
+    
+    for ( i = 0; i < 8; i++ ) {
+        if ( snprintf(path, sizeof(path), "%s/constraint_%d_name", zone, i) >= sizeof(path) || ! sysfs_read_str(path, name, sizeof(name)) ) break;
+        if ( strcmp(name, "long_term") == 0 ) {
+            constraint = i;
+            break;
+        }
+    }
+    if ( snprintf(path, sizeof(path), "%s/constraint_%d_power_limit_uw", zone, constraint) >= sizeof(path) ) return false;
+    return sysfs_read_u64(path, limit_uw) && *limit_uw;
+}
+
+/**
+ * @brief   Probe the RAPL powercap zones
+ * @details Every intel-rapl* zone (MSR- and MMIO-based, top-level and
+ *          subzone) is examined.  A domain is available when its energy
+ *          counter can be read; the package cap is the lowest enabled
+ *          long-term limit across all package zones, since that is the
+ *          one the hardware enforces.
+ * @param   results     the results to fill-in
+ * @return  Boolean true
+ */
+static bool
+rapl_probe_run(
+    rapl_probe_results_t    *results
+)
+{
+    char                    pattern[PATH_MAX];
+    glob_t                  zones;
+    unsigned int            i;
+    
+    memset(results, 0, sizeof(*results));
+    if ( ! sysfs_path(pattern, sizeof(pattern), "/sys/class/powercap/intel-rapl*:*") ) return true;
+    if ( glob(pattern, 0, NULL, &zones) != 0 ) return true;
+    for ( i = 0; i < zones.gl_pathc; i++ ) {
+        const char          *zone = zones.gl_pathv[i];
+        char                path[PATH_MAX], name[64];
+        unsigned long long  value;
+        int                 domain;
+        
+        if ( snprintf(path, sizeof(path), "%s/name", zone) >= sizeof(path) || ! sysfs_read_str(path, name, sizeof(name)) ) continue;
+        for ( domain = 0; domain < rapl_domain_MAX; domain++ ) {
+            if ( str_startswith(name, rapl_domain_zone_names[domain], -1) ) break;
+        }
+        if ( domain == rapl_domain_MAX ) continue;
+        
+        if ( snprintf(path, sizeof(path), "%s/energy_uj", zone) < sizeof(path) && sysfs_read_u64(path, &value) ) {
+            results->domains |= 1 << domain;
+        }
+        if ( domain == rapl_domain_pkg ) {
+            if ( snprintf(path, sizeof(path), "%s/enabled", zone) < sizeof(path) && sysfs_read_u64(path, &value) && ! value ) continue;
+            if ( rapl_zone_power_limit(zone, &value) && (! results->pkg_cap_uw || (value < results->pkg_cap_uw)) ) {
+                results->pkg_cap_uw = value;
+            }
+        }
+    }
+    globfree(&zones);
+    return true;
+}
+
+/**
+ * @brief   Append the POWER::RAPL::<domain> and POWER::CAP::LE::<tier>W
+ *          features
+ * @details Every tier at or above the package cap is published, so a job
+ *          asking for POWER::CAP::LE::<n>W lands on any node capped at
+ *          <n> watts or less.
+ * @param   results     the RAPL probe results
+ * @param   config      the plugin configuration
+ * @param   features    pointer to the feature string to extend
+ * @param   delim       pointer to the current delimiter
+ */
+static void
+rapl_probe_features(
+    rapl_probe_results_t    *results,
+    cpuinfo_config_t        *config,
+    char                    **features,
+    const char              **delim
+)
+{
+    unsigned int            i;
+    
+    for ( i = 0; i < rapl_domain_MAX; i++ ) {
+        if ( results->domains & (1 << i) ) xstrfmtcat(*features, "%sPOWER::RAPL::%s", *delim, rapl_domain_strings[i]), *delim = ",";
+    }
+    if ( results->pkg_cap_uw ) {
+        double              cap_w = 1e-6 * results->pkg_cap_uw;
+        
+        for ( i = 0; i < config->power_cap_tiers.count; i++ ) {
+            if ( cap_w <= config->power_cap_tiers.value[i] ) {
+                xstrfmtcat(*features, "%sPOWER::CAP::LE::%gW", *delim, config->power_cap_tiers.value[i]), *delim = ",";
+            }
+        }
+    }
+}
+
+/**
+ * @brief   Maximum number of FsPaths examined by the filesystem probe
+ */
+#define FS_PROBE_MAX_PATHS      16
+
+/**
+ * @brief   A path of interest to the filesystem probe
+ */
+typedef struct fs_probe_path {
+    char                path[256];      /**< the path from FsPaths */
+    char                fs_type[32];    /**< type of the filesystem mounted there (empty if none found) */
+    unsigned long long  tmpfs_bytes;    /**< capacity if the filesystem is a tmpfs */
+} fs_probe_path_t;
+
+/**
+ * @brief   Results of the filesystem probe
+ */
+typedef struct fs_probe_results {
+    unsigned int        n_paths;                        /**< number of paths of interest */
+    fs_probe_path_t     paths[FS_PROBE_MAX_PATHS];      /**< the paths of interest */
+} fs_probe_results_t;
+
+/**
+ * @brief   Length of the part of a mount point that covers a path
+ * @details Mount points in mountinfo escape space, tab, newline and
+ *          backslash as three-digit octal sequences; the comparison
+ *          decodes them in place rather than copying the field.
+ * @param   mnt         the (escaped) mount point field
+ * @param   mnt_len     characters in @a mnt
+ * @param   path        the path of interest
+ * @return  -1 if the mount point does not contain @a path, otherwise the
+ *          length of the decoded mount point (so longer is more specific)
+ */
+static int
+mountinfo_mount_covers(
+    const char      *mnt,
+    size_t          mnt_len,
+    const char      *path
+)
+{
+    const char      *p = path, *e = mnt + mnt_len;
+    
+    if ( (mnt_len == 1) && (*mnt == '/') ) return 1;
+    while ( mnt < e ) {
+        char        c = *mnt++;
+        
+        if ( (c == '\\') && (e - mnt >= 3) && isdigit((unsigned char)mnt[0]) && isdigit((unsigned char)mnt[1]) && isdigit((unsigned char)mnt[2]) ) {
+            c = (char)(((mnt[0] - '0') << 6) | ((mnt[1] - '0') << 3) | (mnt[2] - '0'));
+            mnt += 3;
+        }
+        if ( *p != c ) return -1;
+        p++;
+    }
+    return ( (*p == '\0') || (*p == '/') ) ? (int)(p - path) : -1;
+}
+
+/**
+ * @brief   Read an entire (proc) file into memory
+ * @details Files under /proc report a size of zero, so the buffer grows
+ *          as the file is read.
+ * @param   path        the file to read
+ * @param   length      pointer to the number of bytes read on return
+ * @return  @a NULL on error, otherwise a NUL-terminated buffer the caller
+ *          must free()
+ */
+static char*
+proc_read_file(
+    const char      *path,
+    size_t          *length
+)
+{
+    int             fd = open(path, O_RDONLY | O_CLOEXEC);
+    char            *buffer = NULL;
+    size_t          capacity = 0, used = 0;
+    ssize_t         n;
+    
+    if ( fd < 0 ) return NULL;
+    do {
+        if ( capacity - used < 4096 ) {
+            char    *new_buffer = realloc(buffer, capacity += 65536);
+            
+            if ( ! new_buffer ) {
+                free(buffer);
+                close(fd);
+                return NULL;
+            }
+            buffer = new_buffer;
+        }
+        n = read(fd, buffer + used, capacity - used - 1);
+        if ( n > 0 ) used += n;
+    } while ( (n > 0) || ((n < 0) && (errno == EINTR)) );
+    close(fd);
+    buffer[used] = '\0';
+    *length = used;
+    return buffer;
+}
+
+/**
+ * @brief   Probe the filesystems mounted at the configured paths
+ * @details /proc/self/mountinfo is read once and scanned in place:  each
+ *          line is split into fields by pointer and length without being
+ *          copied.  For each path of interest the last-mounted, most
+ *          specific mount point covering it wins.  A tmpfs's capacity is
+ *          taken from its size= mount option, or from statvfs() when the
+ *          option is absent (below the sysfs root, like mountinfo).
+ * @param   results     the results to fill-in
+ * @param   fs_paths    comma-separated paths of interest
+ * @return  Boolean true
+ */
+static bool
+fs_probe_run(
+    fs_probe_results_t  *results,
+    const char          *fs_paths
+)
+{
+    char                path[PATH_MAX], *mountinfo, *line, *end;
+    size_t              mountinfo_len = 0;
+    int                 best_len[FS_PROBE_MAX_PATHS];
+    unsigned int        i;
+    
+    memset(results, 0, sizeof(*results));
+    while ( fs_paths && *fs_paths && (results->n_paths < FS_PROBE_MAX_PATHS) ) {
+        const char      *e;
+        size_t          path_len;
+        
+        while ( isspace((unsigned char)*fs_paths) || (*fs_paths == ',') ) fs_paths++;
+        e = fs_paths;
+        while ( *e && (*e != ',') ) e++;
+        path_len = e - fs_paths;
+        while ( path_len && isspace((unsigned char)fs_paths[path_len - 1]) ) path_len--;
+        /* Trailing slashes would defeat the mount point comparison: */
+        while ( (path_len > 1) && (fs_paths[path_len - 1] == '/') ) path_len--;
+        if ( path_len && (*fs_paths == '/') && (path_len < sizeof(results->paths[0].path)) ) {
+            char        *fsp_path = results->paths[results->n_paths].path;
+            
+            memcpy(fsp_path, fs_paths, path_len);
+            /* Paths that cannot be spelled in a Slurm feature are ignored: */
+            if ( strpbrk(fsp_path, FS_PROBE_PATH_REJECT) ) {
+                memset(fsp_path, 0, path_len);
+            } else {
+                best_len[results->n_paths++] = -1;
+            }
+        }
+        fs_paths = e;
+    }
+    if ( ! results->n_paths ) return true;
+    
+    if ( ! sysfs_path(path, sizeof(path), "/proc/self/mountinfo") || ! (mountinfo = proc_read_file(path, &mountinfo_len)) ) return true;
+    line = mountinfo;
+    end = mountinfo + mountinfo_len;
+    while ( line < end ) {
+        char            *eol = memchr(line, '\n', end - line), *p, *field[6];
+        size_t          field_len[6];
+        unsigned int    n_fields = 0;
+        
+        if ( ! eol ) eol = end;
+        
+        /* Fields 0-4 precede the optional fields; mount point is field 4: */
+        p = line;
+        while ( (p < eol) && (n_fields < 5) ) {
+            field[n_fields] = p;
+            while ( (p < eol) && (*p != ' ') ) p++;
+            field_len[n_fields] = p - field[n_fields];
+            n_fields++;
+            if ( p < eol ) p++;
+        }
+        /* Skip to the " - " separator, then the filesystem type and (past the
+           source) the super options: */
+        while ( (p < eol) && ! ((*p == '-') && (p + 1 < eol) && (p[1] == ' ') && (p[-1] == ' ')) ) p++;
+        if ( (n_fields == 5) && (p < eol) ) {
+            char        *fs_type = p + 2, *fs_type_end = fs_type, *options = NULL, *options_end = eol;
+            
+            while ( (fs_type_end < eol) && (*fs_type_end != ' ') ) fs_type_end++;
+            p = fs_type_end + 1;
+            while ( (p < eol) && (*p != ' ') ) p++;
+            if ( p < eol ) options = p + 1;
+            
+            for ( i = 0; i < results->n_paths; i++ ) {
+                fs_probe_path_t *fsp = &results->paths[i];
+                int             covers = mountinfo_mount_covers(field[4], field_len[4], fsp->path);
+                size_t          type_len = fs_type_end - fs_type;
+                
+                if ( (covers < 0) || (covers < best_len[i]) || (type_len >= sizeof(fsp->fs_type)) ) continue;
+                best_len[i] = covers;
+                memcpy(fsp->fs_type, fs_type, type_len);
+                fsp->fs_type[type_len] = '\0';
+                fsp->tmpfs_bytes = 0;
+                if ( strcmp(fsp->fs_type, "tmpfs") == 0 ) {
+                    const char  *size_opt = options;
+                    
+                    while ( size_opt && (size_opt < options_end) ) {
+                        if ( (options_end - size_opt > 5) && ! strncmp(size_opt, "size=", 5) ) {
+                            char                *unit = NULL;
+                            unsigned long long  size = strtoull(size_opt + 5, &unit, 10);
+                            
+                            switch ( *unit ) {
+                                case 'k': size <<= 10; break;
+                                case 'm': size <<= 20; break;
+                                case 'g': size <<= 30; break;
+                            }
+                            fsp->tmpfs_bytes = size;
+                            break;
+                        }
+                        size_opt = memchr(size_opt, ',', options_end - size_opt);
+                        if ( size_opt ) size_opt++;
+                    }
+                }
+            }
+        }
+        line = eol + 1;
+    }
+    free(mountinfo);
+    
+    for ( i = 0; i < results->n_paths; i++ ) {
+        fs_probe_path_t *fsp = &results->paths[i];
+        struct statvfs  fs_info;
+        
+        if ( (strcmp(fsp->fs_type, "tmpfs") == 0) && ! fsp->tmpfs_bytes && sysfs_path(path, sizeof(path), "%s", fsp->path) && (statvfs(path, &fs_info) == 0) ) {
+            fsp->tmpfs_bytes = (unsigned long long)fs_info.f_blocks * fs_info.f_frsize;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief   Append the FS::<type>::<path> and FS::TMPFS::GE::<tier>GB
+ *          features
+ * @details The tmpfs tiers reflect the largest tmpfs among the paths of
+ *          interest.
+ * @param   results     the filesystem probe results
+ * @param   config      the plugin configuration
+ * @param   features    pointer to the feature string to extend
+ * @param   delim       pointer to the current delimiter
+ */
+static void
+fs_probe_features(
+    fs_probe_results_t  *results,
+    cpuinfo_config_t    *config,
+    char                **features,
+    const char          **delim
+)
+{
+    unsigned long long  tmpfs_bytes = 0;
+    unsigned int        i;
+    
+    for ( i = 0; i < results->n_paths; i++ ) {
+        if ( ! *results->paths[i].fs_type ) continue;
+        xstrfmtcat(*features, "%sFS::%s::%s", *delim, results->paths[i].fs_type, results->paths[i].path), *delim = ",";
+        if ( results->paths[i].tmpfs_bytes > tmpfs_bytes ) tmpfs_bytes = results->paths[i].tmpfs_bytes;
+    }
+    for ( i = 0; i < config->fs_tmpfs_tiers.count; i++ ) {
+        if ( tmpfs_bytes < config->fs_tmpfs_tiers.value[i] * 1073741824.0 ) break;
+        xstrfmtcat(*features, "%sFS::TMPFS::GE::%gGB", *delim, config->fs_tmpfs_tiers.value[i]), *delim = ",";
+    }
+}
+
+/**
+ * @brief   Magic bytes at the start of a hardware catalog file
+ */
+#define CATALOG_MAGIC           "CPUICAT1"
+
+/**
+ * @brief   Header of a hardware catalog file
+ * @details A catalog is a header, @a n_slots catalog_slot_t records forming
+ *          an open-addressed hash table keyed by fingerprint, and a blob of
+ *          @a blob_len bytes holding the feature strings.  All integers are
+ *          in the byte order of the host that built the catalog.
+ */
+typedef struct catalog_header {
+    char                magic[8];       /**< CATALOG_MAGIC */
+    uint32_t            n_slots;        /**< number of hash table slots */
+    uint32_t            blob_len;       /**< bytes of feature strings */
+} catalog_header_t;
+
+/**
+ * @brief   A hash table slot in a hardware catalog file
+ * @details A zero @a fingerprint marks an empty slot; collisions are
+ *          resolved by linear probing.
+ */
+typedef struct catalog_slot {
+    uint64_t            fingerprint;        /**< platform fingerprint */
+    uint32_t            features_offset;    /**< offset of the features in the blob */
+    uint32_t            features_len;       /**< length of the features (no NUL) */
+} catalog_slot_t;
+
+/**
+ * @brief   Results of the hardware catalog probe
+ */
+typedef struct catalog_probe_results {
+    uint64_t            fingerprint;    /**< this node's platform fingerprint */
+    bool                is_hit;         /**< the catalog has an entry for the fingerprint */
+    char                *features;      /**< the catalogued features */
+} catalog_probe_results_t;
+
+/**
+ * @brief   Extend a 64-bit FNV-1a hash
+ * @param   hash    the hash so far (start with 0xcbf29ce484222325)
+ * @param   data    the bytes to add
+ * @param   len     number of bytes at @a data
+ * @return  The extended hash
+ */
+static uint64_t
+catalog_fnv1a(
+    uint64_t            hash,
+    const void          *data,
+    size_t              len
+)
+{
+    const unsigned char *p = (const unsigned char*)data;
+    
+    while ( len-- ) hash = (hash ^ *p++) * 0x100000001b3ULL;
+    return hash;
+}
+
+/**
+ * @brief   qsort comparator for PCI vendor/device ids
+ */
+static int
+catalog_pci_id_cmp(
+    const void          *a,
+    const void          *b
+)
+{
+    uint32_t            A = *(const uint32_t*)a, B = *(const uint32_t*)b;
+    
+    return ( A < B ) ? -1 : (( A > B ) ? 1 : 0);
+}
+
+/**
+ * @brief   Compute a node's platform fingerprint
+ * @details The fingerprint hashes only cheaply-obtained identity:  the CPU
+ *          vendor and family/model/stepping signature, the succinct model
+ *          name, the DMI product name, and the sorted multiset of PCI
+ *          vendor/device ids under /sys/bus/pci/devices.  Each component
+ *          is followed by a NUL so that adjacent fields cannot alias.
+ * @param   cif     the node's cpuinfo features
+ * @return  A non-zero fingerprint
+ */
+static uint64_t
+catalog_fingerprint(
+    const cpuinfo_features_t    *cif
+)
+{
+    uint64_t                    hash = 0xcbf29ce484222325ULL;
+    char                        path[PATH_MAX], text[256];
+    uint32_t                    signature[3] = { cif->cpu_family, cif->cpu_model, cif->cpu_stepping };
+    glob_t                      devices;
+    
+    hash = catalog_fnv1a(hash, cif->vendor_id ? cif->vendor_id : "", cif->vendor_id ? strlen(cif->vendor_id) + 1 : 1);
+    hash = catalog_fnv1a(hash, signature, sizeof(signature));
+    hash = catalog_fnv1a(hash, cif->model_name ? cif->model_name : "", cif->model_name ? strlen(cif->model_name) + 1 : 1);
+    if ( ! sysfs_path(path, sizeof(path), "/sys/class/dmi/id/product_name") || ! sysfs_read_str(path, text, sizeof(text)) ) text[0] = '\0';
+    hash = catalog_fnv1a(hash, text, strlen(text) + 1);
+    
+    if ( sysfs_path(path, sizeof(path), "/sys/bus/pci/devices/*") && (glob(path, 0, NULL, &devices) == 0) ) {
+        uint32_t                *ids = (uint32_t*)calloc(devices.gl_pathc, sizeof(uint32_t));
+        size_t                  i, n_ids = 0;
+        
+        if ( ids ) {
+            for ( i = 0; i < devices.gl_pathc; i++ ) {
+                unsigned long long  vendor, device;
+                
+                snprintf(path, sizeof(path), "%s/vendor", devices.gl_pathv[i]);
+                if ( ! sysfs_read_u64(path, &vendor) ) continue;
+                snprintf(path, sizeof(path), "%s/device", devices.gl_pathv[i]);
+                if ( ! sysfs_read_u64(path, &device) ) continue;
+                ids[n_ids++] = (uint32_t)((vendor & 0xffff) << 16 | (device & 0xffff));
+            }
+            qsort(ids, n_ids, sizeof(uint32_t), catalog_pci_id_cmp);
+            hash = catalog_fnv1a(hash, ids, n_ids * sizeof(uint32_t));
+            free(ids);
+        }
+        globfree(&devices);
+    }
+    return hash ? hash : 1;
+}
+
+/**
+ * @brief   Look up a fingerprint in a hardware catalog file
+ * @details The file is mapped read-only; every offset in it is
+ *          bounds-checked before use.
+ * @param   filename        the catalog file
+ * @param   fingerprint     the fingerprint to find
+ * @param   features        on a hit, set to a copy of the catalogued
+ *                          features (free with free())
+ * @return  Boolean true on a hit
+ */
+static bool
+catalog_lookup(
+    const char          *filename,
+    uint64_t            fingerprint,
+    char                **features
+)
+{
+    int                 fd = open(filename, O_RDONLY | O_CLOEXEC);
+    struct stat         finfo;
+    void                *base;
+    bool                is_hit = false;
+    
+    if ( fd < 0 ) {
+        debug("catalog_lookup: unable to open %s (errno = %d)", filename, errno);
+        return false;
+    }
+    if ( (fstat(fd, &finfo) == 0) && (finfo.st_size >= (off_t)sizeof(catalog_header_t)) ) {
+        base = mmap(NULL, finfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if ( base != MAP_FAILED ) {
+            const catalog_header_t  *header = (const catalog_header_t*)base;
+            const catalog_slot_t    *slots = (const catalog_slot_t*)(header + 1);
+            const char              *blob = (const char*)(slots + header->n_slots);
+            
+            if ( memcmp(header->magic, CATALOG_MAGIC, sizeof(header->magic)) || ! header->n_slots
+                    || ((uint64_t)finfo.st_size < sizeof(*header) + (uint64_t)header->n_slots * sizeof(*slots) + header->blob_len) ) {
+                error("catalog_lookup: %s is not a valid catalog", filename);
+            } else {
+                uint32_t            slot = fingerprint % header->n_slots, n_probed = 0;
+                
+                while ( (n_probed++ < header->n_slots) && slots[slot].fingerprint ) {
+                    if ( slots[slot].fingerprint == fingerprint ) {
+                        if ( (uint64_t)slots[slot].features_offset + slots[slot].features_len <= header->blob_len ) {
+                            *features = strndup(blob + slots[slot].features_offset, slots[slot].features_len);
+                            is_hit = ( *features != NULL );
+                        }
+                        break;
+                    }
+                    slot = (slot + 1) % header->n_slots;
+                }
+            }
+            munmap(base, finfo.st_size);
+        }
+    }
+    close(fd);
+    return is_hit;
+}
+
+/**
+ * @brief   Run the hardware catalog probe
+ * @details Any previous catalogued features are discarded first.  A miss
+ *          is a result like a hit:  the fingerprint and @a is_hit are kept
+ *          in the snapshot until a PCI hotplug event or invalidation, so
+ *          the fingerprint is not recomputed on every update of a node
+ *          the catalog does not know.
+ * @param   results     the results to fill-in
+ * @param   config      the plugin configuration
+ * @param   cif         the node's cpuinfo features
+ * @return  Boolean true
+ */
+static bool
+catalog_probe_run(
+    catalog_probe_results_t *results,
+    cpuinfo_config_t        *config,
+    const cpuinfo_features_t *cif
+)
+{
+    if ( results->features ) free(results->features);
+    memset(results, 0, sizeof(*results));
+    results->fingerprint = catalog_fingerprint(cif);
+    if ( config->catalog_file && *config->catalog_file ) {
+        results->is_hit = catalog_lookup(config->catalog_file, results->fingerprint, &results->features);
+        debug("catalog_probe_run: fingerprint %016llx %s", (unsigned long long)results->fingerprint, results->is_hit ? "found" : "not in catalog");
+    }
+    return true;
+}
+
+/**
+ * @brief   Maximum number of PCI devices kept from a hwloc topology
+ */
+#define HWLOC_PCI_MAX_DEVICES   256
+
+/**
+ * @brief   Cache levels recorded from a hwloc topology (index = level)
+ */
+#define HWLOC_CACHE_LEVELS      5
+
+/**
+ * @brief   A PCI device described by a hwloc topology
+ */
+typedef struct hwloc_pci_device {
+    uint16_t                vendor_id;      /**< 16-bit PCI vendor id */
+    uint16_t                device_id;      /**< 16-bit PCI device id */
+    uint16_t                class_id;       /**< PCI class and subclass */
+    uint16_t                domain;         /**< PCI domain */
+    uint8_t                 bus;            /**< PCI bus */
+    uint8_t                 dev;            /**< PCI device */
+    uint8_t                 func;           /**< PCI function */
+} hwloc_pci_device_t;
+
+/**
+ * @brief   What a hwloc XML topology says about the node
+ * @details String and numeric fields are left empty (or -1) when the
+ *          topology does not provide them, and the probes that consume
+ *          them probe the node directly for those.
+ */
+typedef struct hwloc_topology_results {
+    bool                    is_loaded;                          /**< a topology was read */
+    char                    cpu_vendor[64];                     /**< CPUVendor of the first package */
+    char                    cpu_model[128];                     /**< CPUModel of the first package */
+    int                     cpu_family;                         /**< CPUFamilyNumber */
+    int                     cpu_model_number;                   /**< CPUModelNumber */
+    int                     cpu_stepping;                       /**< CPUStepping */
+    unsigned int            cache_kb[HWLOC_CACHE_LEVELS];       /**< first data/unified cache of each level, KiB */
+    unsigned int            n_packages;                         /**< Package objects */
+    unsigned int            n_cores;                            /**< Core objects */
+    unsigned int            n_pus;                              /**< PU objects */
+    unsigned int            n_numa_nodes;                       /**< NUMANode objects */
+    unsigned int            n_pci_seen;                         /**< PCIDev objects */
+    unsigned int            n_pci;                              /**< entries in @a pci */
+    hwloc_pci_device_t      pci[HWLOC_PCI_MAX_DEVICES];         /**< the first PCIDev objects */
+} hwloc_topology_results_t;
+
+/**
+ * @brief   Copy an XML attribute value, decoding the predefined entities
+ * @details The copy is truncated to fit @a dst.
+ * @param   dst         buffer to fill-in
+ * @param   dst_len     capacity of @a dst
+ * @param   src         the value as it appears in the document
+ * @param   src_len     number of characters at @a src
+ */
+static void
+hwloc_xml_value_copy(
+    char                *dst,
+    size_t              dst_len,
+    const char          *src,
+    size_t              src_len
+)
+{
+    static const struct {
+        const char      *entity;
+        char            c;
+    }                   entities[] = { { "&amp;", '&' }, { "&lt;", '<' }, { "&gt;", '>' }, { "&quot;", '"' }, { "&apos;", '\'' }, { NULL, 0 } };
+    const char          *end = src + src_len;
+    size_t              n = 0;
+    
+    while ( (src < end) && (n + 1 < dst_len) ) {
+        char            c = *src++;
+        
+        if ( c == '&' ) {
+            int         i;
+            
+            for ( i = 0; entities[i].entity; i++ ) {
+                size_t  entity_len = strlen(entities[i].entity);
+                
+                if ( (end - src + 1 >= entity_len) && ! strncmp(src - 1, entities[i].entity, entity_len) ) {
+                    c = entities[i].c;
+                    src += entity_len - 1;
+                    break;
+                }
+            }
+        }
+        dst[n++] = c;
+    }
+    if ( dst_len ) dst[n] = '\0';
+}
+
+/**
+ * @brief   Apply one element of a hwloc topology to the results
+ * @details Only <object> and <info> elements matter.  hwloc 1.x names
+ *          caches "Cache" with a depth attribute; 2.x names them by level
+ *          (e.g. "L3Cache", "L1dCache").  Instruction caches are skipped.
+ */
+static void
+hwloc_xml_element(
+    hwloc_topology_results_t    *results,
+    const char                  *element,
+    size_t                      element_len,
+    const char                  *type,
+    const char                  *info_name,
+    const char                  *info_value,
+    unsigned long long          cache_size,
+    int                         cache_depth,
+    int                         cache_type,
+    const char                  *pci_busid,
+    const char                  *pci_type
+)
+{
+    if ( (element_len == 4) && ! strncmp(element, "info", 4) ) {
+        if ( ! strcmp(info_name, "CPUVendor") && ! *results->cpu_vendor ) {
+            snprintf(results->cpu_vendor, sizeof(results->cpu_vendor), "%s", info_value);
+        }
+        else if ( ! strcmp(info_name, "CPUModel") && ! *results->cpu_model ) {
+            snprintf(results->cpu_model, sizeof(results->cpu_model), "%s", info_value);
+        }
+        else if ( ! strcmp(info_name, "CPUFamilyNumber") && (results->cpu_family < 0) ) {
+            results->cpu_family = atoi(info_value);
+        }
+        else if ( ! strcmp(info_name, "CPUModelNumber") && (results->cpu_model_number < 0) ) {
+            results->cpu_model_number = atoi(info_value);
+        }
+        else if ( ! strcmp(info_name, "CPUStepping") && (results->cpu_stepping < 0) ) {
+            results->cpu_stepping = atoi(info_value);
+        }
+        return;
+    }
+    if ( (element_len != 6) || strncmp(element, "object", 6) ) return;
+    
+    if ( ! strcmp(type, "Package") || ! strcmp(type, "Socket") ) results->n_packages++;
+    else if ( ! strcmp(type, "Core") ) results->n_cores++;
+    else if ( ! strcmp(type, "PU") ) results->n_pus++;
+    else if ( ! strcmp(type, "NUMANode") ) results->n_numa_nodes++;
+    else if ( ! strcmp(type, "PCIDev") ) {
+        unsigned int        domain, bus, dev, func, class_id, vendor_id, device_id;
+        
+        results->n_pci_seen++;
+        if ( (results->n_pci < HWLOC_PCI_MAX_DEVICES)
+                    && (sscanf(pci_busid, "%x:%x:%x.%x", &domain, &bus, &dev, &func) == 4)
+                    && (sscanf(pci_type, "%x [%x:%x]", &class_id, &vendor_id, &device_id) == 3) ) {
+            hwloc_pci_device_t  *device = &results->pci[results->n_pci++];
+            
+            device->vendor_id = vendor_id;
+            device->device_id = device_id;
+            device->class_id = class_id;
+            device->domain = domain;
+            device->bus = bus;
+            device->dev = dev;
+            device->func = func;
+        }
+    }
+    else if ( (type[0] == 'L') && isdigit((unsigned char)type[1]) && strstr(type, "Cache") ) {
+        if ( strcmp(type + 2, "iCache") ) {
+            int             level = type[1] - '0';
+            
+            if ( (level < HWLOC_CACHE_LEVELS) && ! results->cache_kb[level] ) results->cache_kb[level] = cache_size / 1024;
+        }
+    }
+    else if ( ! strcmp(type, "Cache") ) {
+        if ( (cache_type != 2) && (cache_depth > 0) && (cache_depth < HWLOC_CACHE_LEVELS) && ! results->cache_kb[cache_depth] ) {
+            results->cache_kb[cache_depth] = cache_size / 1024;
+        }
+    }
+}
+
+/**
+ * @brief   Scan a hwloc XML topology
+ * @details A single forward pass over the document:  each element's
+ *          attributes of interest are gathered into small fixed buffers and
+ *          the element is applied to @a results as soon as its start tag
+ *          ends.  No tree is built and nesting is not tracked -- hwloc
+ *          writes objects depth-first, so the first package's info and
+ *          caches are the first ones seen.  Comments, processing
+ *          instructions and the DOCTYPE are skipped, as is the rest of a
+ *          malformed tag; an unterminated attribute value ends the scan.
+ * @param   xml         the document (need not be NUL-terminated)
+ * @param   xml_len     number of characters at @a xml
+ * @param   results     the results to fill-in
+ * @return  Boolean true if the document has a <topology> element
+ */
+static bool
+hwloc_xml_parse(
+    const char                  *xml,
+    size_t                      xml_len,
+    hwloc_topology_results_t    *results
+)
+{
+    const char                  *p = xml, *end = xml + xml_len;
+    bool                        is_topology = false;
+    
+    memset(results, 0, sizeof(*results));
+    results->cpu_family = results->cpu_model_number = results->cpu_stepping = -1;
+    while ( (p < end) && (p = memchr(p, '<', end - p)) ) {
+        const char              *element;
+        size_t                  element_len;
+        char                    type[32] = "", info_name[64] = "", info_value[256] = "", pci_busid[32] = "", pci_type[64] = "";
+        unsigned long long      cache_size = 0;
+        int                     cache_depth = 0, cache_type = 0;
+        
+        if ( ++p >= end ) break;
+        if ( (*p == '!') || (*p == '?') || (*p == '/') ) {
+            if ( (end - p >= 3) && ! strncmp(p, "!--", 3) ) {
+                for ( p += 3; (end - p >= 3) && strncmp(p, "-->", 3); p++ );
+            }
+            if ( ! (p = memchr(p, '>', end - p)) ) break;
+            continue;
+        }
+        element = p;
+        while ( (p < end) && (isalnum((unsigned char)*p) || (*p == '_') || (*p == ':') || (*p == '-')) ) p++;
+        element_len = p - element;
+        while ( p < end ) {
+            const char          *attr, *value;
+            size_t              attr_len, value_len;
+            char                quote;
+            
+            while ( (p < end) && isspace((unsigned char)*p) ) p++;
+            if ( (p >= end) || (*p == '>') || (*p == '/') ) break;
+            attr = p;
+            while ( (p < end) && (*p != '=') && (*p != '>') && ! isspace((unsigned char)*p) ) p++;
+            attr_len = p - attr;
+            while ( (p < end) && isspace((unsigned char)*p) ) p++;
+            if ( (p >= end) || (*p != '=') ) break;
+            p++;
+            while ( (p < end) && isspace((unsigned char)*p) ) p++;
+            if ( (p >= end) || ((*p != '"') && (*p != '\'')) ) break;
+            quote = *p++;
+            value = p;
+            if ( ! (p = memchr(p, quote, end - p)) ) return is_topology;
+            value_len = p++ - value;
+#define HWLOC_XML_ATTR(N)   ((attr_len == sizeof(N) - 1) && ! strncmp(attr, N, attr_len))
+            if ( HWLOC_XML_ATTR("type") ) hwloc_xml_value_copy(type, sizeof(type), value, value_len);
+            else if ( HWLOC_XML_ATTR("name") ) hwloc_xml_value_copy(info_name, sizeof(info_name), value, value_len);
+            else if ( HWLOC_XML_ATTR("value") ) hwloc_xml_value_copy(info_value, sizeof(info_value), value, value_len);
+            else if ( HWLOC_XML_ATTR("pci_busid") ) hwloc_xml_value_copy(pci_busid, sizeof(pci_busid), value, value_len);
+            else if ( HWLOC_XML_ATTR("pci_type") ) hwloc_xml_value_copy(pci_type, sizeof(pci_type), value, value_len);
+            else if ( HWLOC_XML_ATTR("cache_size") || HWLOC_XML_ATTR("depth") || HWLOC_XML_ATTR("cache_type") ) {
+                char            number[24];
+                
+                hwloc_xml_value_copy(number, sizeof(number), value, value_len);
+                if ( HWLOC_XML_ATTR("cache_size") ) cache_size = strtoull(number, NULL, 10);
+                else if ( HWLOC_XML_ATTR("depth") ) cache_depth = atoi(number);
+                else cache_type = atoi(number);
+            }
+#undef HWLOC_XML_ATTR
+        }
+        if ( (element_len == 8) && ! strncmp(element, "topology", 8) ) is_topology = true;
+        hwloc_xml_element(results, element, element_len, type, info_name, info_value, cache_size, cache_depth, cache_type, pci_busid, pci_type);
+    }
+    return is_topology;
+}
+
+/**
+ * @brief   Read the hwloc topology slurmd cached at startup
+ * @details Any previous results are discarded.  With no file configured
+ *          the results are simply left unloaded.
+ * @param   results     the results to fill-in
+ * @param   config      the plugin configuration
+ * @return  Boolean false if the configured file could not be read or is
+ *          not a hwloc topology
+ */
+static bool
+hwloc_probe_run(
+    hwloc_topology_results_t    *results,
+    cpuinfo_config_t            *config
+)
+{
+    char                        *xml;
+    size_t                      xml_len;
+    
+    memset(results, 0, sizeof(*results));
+    if ( ! config->hwloc_xml_file || ! *config->hwloc_xml_file ) return true;
+    if ( ! (xml = proc_read_file(config->hwloc_xml_file, &xml_len)) ) {
+        error("hwloc_probe_run: unable to read %s (errno = %d)", config->hwloc_xml_file, errno);
+        return false;
+    }
+    results->is_loaded = hwloc_xml_parse(xml, xml_len, results);
+    free(xml);
+    if ( ! results->is_loaded ) {
+        error("hwloc_probe_run: %s is not a hwloc topology", config->hwloc_xml_file);
+        return false;
+    }
+    debug("hwloc_probe_run: %u packages, %u cores, %u PUs, %u NUMA nodes, %u PCI devices",
+            results->n_packages, results->n_cores, results->n_pus, results->n_numa_nodes, results->n_pci_seen);
+    return true;
+}
+
+/**
+ * @brief   Fill-in cpuinfo fields from a hwloc topology
+ * @details Each field the topology provides is presented to the matching
+ *          cpuinfo parser, so the features are exactly those /proc/cpuinfo
+ *          would have produced.  The kernel's "cache size" is the L2 cache
+ *          on AMD and Hygon processors and the last-level cache on others;
+ *          the same one is chosen here.  ISA flags and the clock speed are
+ *          not in the topology.
+ * @param   cif         pointer to the cpuinfo_features_t to update
+ * @param   hwloc       the topology results
+ */
+static void
+hwloc_cpuinfo_overlay(
+    cpuinfo_features_t              *cif,
+    const hwloc_topology_results_t  *hwloc
+)
+{
+    char                            line[192];
+    unsigned int                    cache_kb = 0;
+    int                             level;
+    
+    if ( ! hwloc->is_loaded ) return;
+    if ( *hwloc->cpu_vendor ) {
+        snprintf(line, sizeof(line), "vendor_id: %s", hwloc->cpu_vendor);
+        cpuinfo_parse_line(cif, line);
+    }
+    if ( *hwloc->cpu_model ) {
+        snprintf(line, sizeof(line), "model name: %s", hwloc->cpu_model);
+        cpuinfo_parse_line(cif, line);
+    }
+    if ( hwloc->cpu_family >= 0 ) cif->cpu_family = hwloc->cpu_family;
+    if ( hwloc->cpu_model_number >= 0 ) cif->cpu_model = hwloc->cpu_model_number;
+    if ( hwloc->cpu_stepping >= 0 ) cif->cpu_stepping = hwloc->cpu_stepping;
+    if ( ! strcmp(hwloc->cpu_vendor, "AuthenticAMD") || ! strcmp(hwloc->cpu_vendor, "HygonGenuine") ) {
+        cache_kb = hwloc->cache_kb[2];
+    } else {
+        for ( level = HWLOC_CACHE_LEVELS - 1; (level > 0) && ! cache_kb; level-- ) cache_kb = hwloc->cache_kb[level];
+    }
+    if ( cache_kb ) cif->cache_kb = cache_kb;
+}
+
+#ifdef HAVE_PCI_DETECTION
+
+#include <pciaccess.h>
+
+/**
+ * @brief   Kinds of PCI devices of interest
+ */
+typedef enum {
+    pci_device_kind_other   = 0,    /**< no special handling */
+    pci_device_kind_gpu     = 1,    /**< GPU or other accelerator */
+    pci_device_kind_hca     = 2     /**< RDMA-capable network adapter */
+} pci_device_kind_t;
+
+/**
+ * @brief   Map a feature name to a PCI device id
+ */
+typedef struct pci_device_feature {
+    uint32_t                device_id;      /**< 16-bit PCI device id */
+    const char              *feature_name;  /**< Slurm feature name */
+    pci_device_kind_t       kind;           /**< what kind of device it is */
+    const char              *arch_feature;  /**< optional GPU::CC::<major.minor> or GPU::GFX::<target> */
+} pci_device_feature_t;
+
+/**
+ * @brief   Map a list of device-feature matches to a PCI vendor id
+ */
+typedef struct pci_vendor_devices {
+    uint32_t                vendor_id;          /**< 16-bit PCI vendor id */
+    pci_device_feature_t    device_features[];  /**< array of device-to-feature mappings */
+} pci_vendor_devices_t;
+
+/**
+ * @brief   Pointer to a vendor device list
+ */
+typedef pci_vendor_devices_t * pci_vendor_devices_ptr; 
+
+/**
+ * @brief   Summarize a vendor device list to stdout
+ * @details Writes a summary of the vendors and each device associated
+ *          with that vendor from the @a vendor_devices list
+ * @param   vendor_devices  NUL-terminated list of vendor device pointers
+ */
+static void
+pci_vendor_devices_summary(
+    pci_vendor_devices_ptr  *vendor_devices
+)
+{
+    while ( vendor_devices && *vendor_devices ) {
+        pci_vendor_devices_t    *dev = *vendor_devices;
+        pci_device_feature_t    *features = &dev->device_features[0];
+        
+        printf("0x%04X\n", dev->vendor_id);
+        while ( features->device_id ) {
+            printf("0x%04X 0x%04X %s\n", dev->vendor_id, features->device_id, features->feature_name);
+            features++;
+        }
+        
+        vendor_devices++;
+    }
+}
+
+/**
+ * @brief   Maximum number of GPUs or HCAs tracked by a PCI scan
+ */
+#define PCI_SCAN_MAX_DEVICES    64
+
+/**
+ * @brief   How close the HCAs are to the GPUs in the PCIe tree
+ * @details Ordered from farthest to closest.
+ */
+typedef enum {
+    pci_gpu_nic_remote      = 0,    /**< only across sockets (or unknown) */
+    pci_gpu_nic_socket      = 1,    /**< different root complexes of one NUMA node */
+    pci_gpu_nic_root        = 2,    /**< the same root complex */
+    pci_gpu_nic_switch      = 3     /**< below the same root port, i.e. a PCIe switch */
+} pci_gpu_nic_locality_t;
+
+/**
+ * @var     pci_gpu_nic_locality_strings
+ * @brief   Feature suffixes for the pci_gpu_nic_locality_t values
+ */
+static const char* pci_gpu_nic_locality_strings[] = {
+        NULL,
+        "SOCKET",
+        "ROOT",
+        "SWITCH"
+    };
+
+/**
+ * @brief   Results of a PCI scan
+ */
+typedef struct pci_scan_results {
+    char                    *features;                              /**< PCI::<SUBTYPE>::<MODEL> features */
+    unsigned int            n_gpus;                                 /**< number of matched GPUs */
+    unsigned int            n_hcas;                                 /**< number of matched HCAs */
+    bool                    is_gpu_hca_group_shared;                /**< a GPU and an HCA share an IOMMU group */
+    pci_gpu_nic_locality_t  gpu_nic_locality;                       /**< the HCA every GPU has at least this close */
+    char                    *gpu_cc_features;                       /**< GPU::CC::<major.minor> features */
+    char                    *gpu_gfx_features;                      /**< GPU::GFX::<target> features */
+} pci_scan_results_t;
+
+/**
+ * @brief   Longest sysfs device path kept for a matched GPU or HCA
+ */
+#define PCI_SCAN_PATH_MAX       256
+
+/**
+ * @brief   Where a matched GPU or HCA sits
+ */
+typedef struct pci_scan_device {
+    int                     iommu_group;                            /**< IOMMU group, -1 if none */
+    int                     numa_node;                              /**< NUMA node, -1 if unknown */
+    char                    path[PCI_SCAN_PATH_MAX];                /**< PCIe path from the root bus, e.g. "pci0000:3a/0000:3a:00.0/0000:3b:00.0" */
+} pci_scan_device_t;
+
+/**
+ * @brief   Dispose of the memory associated with a pci_scan_results_t and
+ *          reinitialize all fields
+ * @param   scan    pointer to the pci_scan_results_t
+ */
+static void
+pci_scan_results_reset(
+    pci_scan_results_t      *scan
+)
+{
+    xfree(scan->features);
+    xfree(scan->gpu_cc_features);
+    xfree(scan->gpu_gfx_features);
+    memset(scan, 0, sizeof(*scan));
+}
+
+/**
+ * @brief   Determine the IOMMU group of a PCI device
+ * @param   domain      the device's PCI domain
+ * @param   bus         the device's PCI bus
+ * @param   dev         the device's PCI device number
+ * @param   func        the device's PCI function
+ * @return  The group number or -1 if the device is not in a group
+ */
+static int
+pci_device_iommu_group(
+    unsigned int            domain,
+    unsigned int            bus,
+    unsigned int            dev,
+    unsigned int            func
+)
+{
+    char                    path[PATH_MAX], link[PATH_MAX], *base;
+    ssize_t                 link_len;
+    
+    if ( ! sysfs_path(path, sizeof(path), "/sys/bus/pci/devices/%04x:%02x:%02x.%x/iommu_group",
+                domain, bus, dev, func) ) return -1;
+    link_len = readlink(path, link, sizeof(link) - 1);
+    if ( link_len <= 0 ) return -1;
+    link[link_len] = '\0';
+    base = strrchr(link, '/');
+    return atoi(base ? base + 1 : link);
+}
+
+/**
+ * @brief   Determine where a matched GPU or HCA sits
+ * @details The device's /sys/bus/pci/devices link resolves to its place in
+ *          the PCIe tree, e.g. /sys/devices/pci0000:3a/0000:3a:00.0/0000:3b:00.0
+ *          for a device behind root port 3a:00.0 of root bus 0000:3a; the
+ *          part from the root bus on is kept.
+ * @param   domain      the device's PCI domain
+ * @param   bus         the device's PCI bus
+ * @param   dev         the device's PCI device number
+ * @param   func        the device's PCI function
+ * @param   device      the record to fill-in
+ */
+static void
+pci_scan_device_locate(
+    unsigned int            domain,
+    unsigned int            bus,
+    unsigned int            dev,
+    unsigned int            func,
+    pci_scan_device_t       *device
+)
+{
+    char                    path[PATH_MAX], resolved[PATH_MAX], text[32], *root;
+    
+    device->iommu_group = pci_device_iommu_group(domain, bus, dev, func);
+    device->numa_node = -1;
+    device->path[0] = '\0';
+    if ( ! sysfs_path(path, sizeof(path), "/sys/bus/pci/devices/%04x:%02x:%02x.%x", domain, bus, dev, func) ) return;
+    if ( realpath(path, resolved) && (root = strstr(resolved, "/devices/pci")) ) {
+        snprintf(device->path, sizeof(device->path), "%s", root + 9);
+    }
+    if ( sysfs_path(resolved, sizeof(resolved), "/sys/bus/pci/devices/%04x:%02x:%02x.%x/numa_node", domain, bus, dev, func) && sysfs_read_str(resolved, text, sizeof(text)) ) {
+        device->numa_node = atoi(text);
+    }
+}
+
+/**
+ * @brief   How close an HCA is to a GPU
+ * @details Their PCIe paths are compared component by component:  sharing
+ *          the root port (the second component) means both are behind the
+ *          switch attached to it, sharing only the root bus means the same
+ *          root complex.  Otherwise the NUMA nodes decide; a device with no
+ *          NUMA node is only on the same socket when the host has a single
+ *          NUMA node.
+ * @param   gpu             the GPU
+ * @param   hca             the HCA
+ * @param   n_numa_nodes    NUMA nodes on the host
+ * @return  The locality of the pair
+ */
+static pci_gpu_nic_locality_t
+pci_gpu_nic_locality(
+    const pci_scan_device_t *gpu,
+    const pci_scan_device_t *hca,
+    unsigned int            n_numa_nodes
+)
+{
+    const char              *g = gpu->path, *h = hca->path;
+    unsigned int            n_common = 0;
+    
+    if ( *g && *h ) {
+        while ( true ) {
+            size_t          g_len = strcspn(g, "/"), h_len = strcspn(h, "/");
+            
+            if ( (g_len != h_len) || strncmp(g, h, g_len) || ! g[g_len] || ! h[h_len] ) break;
+            n_common++;
+            g += g_len + 1, h += h_len + 1;
+        }
+    }
+    if ( n_common >= 2 ) return pci_gpu_nic_switch;
+    if ( n_common == 1 ) return pci_gpu_nic_root;
+    if ( n_numa_nodes <= 1 ) return pci_gpu_nic_socket;
+    return ( (gpu->numa_node >= 0) && (gpu->numa_node == hca->numa_node) ) ? pci_gpu_nic_socket : pci_gpu_nic_remote;
+}
+
+/**
+ * @brief   Count the host's NUMA nodes
+ * @return  The number of /sys/devices/system/node/node<n> directories
+ */
+static unsigned int
+pci_numa_node_count(void)
+{
+    char                    pattern[PATH_MAX];
+    glob_t                  files;
+    unsigned int            n_nodes = 0;
+    
+    if ( sysfs_path(pattern, sizeof(pattern), "/sys/devices/system/node/node[0-9]*") && (glob(pattern, GLOB_ONLYDIR, NULL, &files) == 0) ) {
+        n_nodes = files.gl_pathc;
+        globfree(&files);
+    }
+    return n_nodes;
+}
+
+/**
+ * @brief   Add a feature to a comma-separated list unless it is present
+ * @param   list        pointer to the list (may point to @a NULL)
+ * @param   feature     the feature to add
+ */
+static void
+pci_feature_list_add(
+    char                    **list,
+    const char              *feature
+)
+{
+    if ( ! *list ) *list = xstrdup(feature);
+    else if ( ! __contains_str(*list, feature, ",") ) xstrfmtcat(*list, ",%s", feature);
+}
+
+/**
+ * @brief   Collect the gfx targets of the node's AMD GPUs from the KFD
+ * @details Each GPU node under /sys/class/kfd/kfd/topology/nodes has a
+ *          gfx_target_version of major * 10000 + minor * 100 + stepping;
+ *          the target name spells minor and stepping as hex digits (e.g.
+ *          90010 is gfx90a).  CPU nodes report 0.
+ * @param   gfx_features    pointer to the GPU::GFX::<target> list to fill-in
+ * @return  The number of GPU nodes found
+ */
+static unsigned int
+pci_kfd_gfx_targets(
+    char                    **gfx_features
+)
+{
+    char                    path[PATH_MAX];
+    glob_t                  nodes;
+    unsigned int            n_gpus = 0;
+    size_t                  i;
+    
+    if ( ! sysfs_path(path, sizeof(path), "/sys/class/kfd/kfd/topology/nodes/*/properties") || (glob(path, 0, NULL, &nodes) != 0) ) return 0;
+    for ( i = 0; i < nodes.gl_pathc; i++ ) {
+        FILE                *fptr = fopen(nodes.gl_pathv[i], "r");
+        char                line[128];
+        unsigned int        version = 0;
+        
+        if ( ! fptr ) continue;
+        while ( fgets(line, sizeof(line), fptr) ) {
+            if ( sscanf(line, "gfx_target_version %u", &version) == 1 ) break;
+        }
+        fclose(fptr);
+        if ( version ) {
+            char            feature[64];
+            
+            snprintf(feature, sizeof(feature), "GPU::GFX::gfx%u%x%x", version / 10000, (version / 100) % 100, version % 100);
+            pci_feature_list_add(gfx_features, feature);
+            n_gpus++;
+        }
+    }
+    globfree(&nodes);
+    return n_gpus;
+}
+
+/**
+ * @brief   Match one PCI device against the vendor device lists
+ * @details A matched device's feature name is added to @a feature_list
+ *          (once), its architecture feature (if any) to the matching list
+ *          of @a scan, and where a matched GPU or HCA sits is noted in
+ *          @a gpus or @a hcas.
+ * @param   vendor_devices      NUL-terminated list of vendor device pointers
+ * @param   vendor_id           the device's PCI vendor id
+ * @param   device_id           the device's PCI device id
+ * @param   domain              the device's PCI domain
+ * @param   bus                 the device's PCI bus
+ * @param   dev                 the device's PCI device number
+ * @param   func                the device's PCI function
+ * @param   scan                the results being compiled
+ * @param   feature_list        pointer to the feature list being compiled
+ * @param   gpus                the matched GPUs
+ * @param   hcas                the matched HCAs
+ */
+static void
+pci_device_match(
+    pci_vendor_devices_ptr  *vendor_devices,
+    unsigned int            vendor_id,
+    unsigned int            device_id,
+    unsigned int            domain,
+    unsigned int            bus,
+    unsigned int            dev,
+    unsigned int            func,
+    pci_scan_results_t      *scan,
+    char                    **feature_list,
+    pci_scan_device_t       gpus[],
+    pci_scan_device_t       hcas[]
+)
+{
+    while ( *vendor_devices ) {
+        if ( (*vendor_devices)->vendor_id == vendor_id ) {
+            pci_device_feature_t    *features = &(*vendor_devices)->device_features[0];
+            
+            while ( features->device_id ) {
+                if ( features->device_id == device_id ) {
+                    pci_feature_list_add(feature_list, features->feature_name);
+                    if ( features->arch_feature ) {
+                        char    **arch_list = str_startswith(features->arch_feature, "GPU::GFX::", -1) ? &scan->gpu_gfx_features : &scan->gpu_cc_features;
+                        
+                        pci_feature_list_add(arch_list, features->arch_feature);
+                    }
+                    if ( (features->kind == pci_device_kind_gpu) && (scan->n_gpus < PCI_SCAN_MAX_DEVICES) ) {
+                        pci_scan_device_locate(domain, bus, dev, func, &gpus[scan->n_gpus++]);
+                    }
+                    else if ( (features->kind == pci_device_kind_hca) && (scan->n_hcas < PCI_SCAN_MAX_DEVICES) ) {
+                        pci_scan_device_locate(domain, bus, dev, func, &hcas[scan->n_hcas++]);
+                    }
+                    return;
+                }
+                features++;
+            }
+        }
+        vendor_devices++;
+    }
+}
+
+/**
+ * @brief   Iterate the PCI buses and compile features associated with
+ *          found devices
+ * @details Find all devices matching the PCI @a device_class (as masked by
+ *          @a device_class_mask) and if any appear in the @a vendor_devices
+ *          list add their feature names to the @a scan features.  In the
+ *          same pass the IOMMU group and PCIe path of every matched GPU and
+ *          HCA are noted so it can be determined whether any GPU-HCA pair
+ *          shares a group (and thus peer-to-peer DMA between them is not
+ *          redirected) and how close each GPU's nearest HCA is (GPUDirect
+ *          RDMA is only fast through a switch or root complex).  GPU
+ *          architecture features come from the device lists, except that
+ *          the gfx targets of AMD GPUs are read from the KFD topology when
+ *          it has any.
+ *          When @a hwloc holds a complete list of the node's PCI devices
+ *          that list is used and the buses are not scanned.
  * @param   vendor_devices      NUL-terminated list of vendor device pointers
  * @param   device_class        24-bit device class value
  * @param   device_class_mask   Mask indicating bits to compare in the
  *                              @a device_class
- * @param   out_features        Pointer to the C string pointer to contain
- *                              the features
+ * @param   hwloc               optional topology read from slurmd's cache
+ * @param   scan                Pointer to the results to fill-in; any
+ *                              previous results are discarded
  * @return  On any error, boolean false is returned.  Otherwise, boolean true
  *          is returned.
  */
 static bool
-pci_device_lookup(
-    pci_vendor_devices_ptr  *vendor_devices,
-    uint32_t                device_class,
-    uint32_t                device_class_mask,
-    char*                   *out_features
+pci_device_lookup(
+    pci_vendor_devices_ptr          *vendor_devices,
+    uint32_t                        device_class,
+    uint32_t                        device_class_mask,
+    const hwloc_topology_results_t  *hwloc,
+    pci_scan_results_t              *scan
+)
+{
+    struct pci_device_iterator  *iter;
+    struct pci_id_match         match;
+    struct pci_device           *device;
+    
+    char                        *feature_list = NULL;
+    pci_scan_device_t           *gpus, *hcas;
+    unsigned int                i, j, n_numa_nodes;
+    
+    if ( ! scan ) return false;
+    pci_scan_results_reset(scan);
+    if ( ! (gpus = (pci_scan_device_t*)calloc(2 * PCI_SCAN_MAX_DEVICES, sizeof(pci_scan_device_t))) ) return false;
+    hcas = gpus + PCI_SCAN_MAX_DEVICES;
+    
+    if ( hwloc && hwloc->is_loaded && hwloc->n_pci && (hwloc->n_pci == hwloc->n_pci_seen) ) {
+        for ( i = 0; i < hwloc->n_pci; i++ ) {
+            const hwloc_pci_device_t    *d = &hwloc->pci[i];
+            
+            if ( (((uint32_t)d->class_id << 8) & device_class_mask) != (device_class & device_class_mask) ) continue;
+            pci_device_match(vendor_devices, d->vendor_id, d->device_id, d->domain, d->bus, d->dev, d->func,
+                    scan, &feature_list, gpus, hcas);
+        }
+    } else if ( ! *sysfs_root ) {
+        //
+        // libpciaccess enumerates the buses once, in pci_system_init(), so
+        // it is initialized for every scan to see hotplugged devices.  It
+        // always reads the host's own buses, so a sample tree gets its PCI
+        // devices from its hwloc topology alone:
+        //
+        int                         rc = pci_system_init();
+        if ( rc != 0 ) {
+            // Handle error
+            fprintf(stderr, "ERROR: unable to init PCI access (%d)\n", rc);
+            free(gpus);
+            return false;
+        }
+        //
+        // Iterate over the devices of the requested class:
+        //
+        match.vendor_id = PCI_MATCH_ANY;
+        match.device_id = PCI_MATCH_ANY;
+        match.subvendor_id = PCI_MATCH_ANY;
+        match.subdevice_id = PCI_MATCH_ANY;
+        match.device_class = device_class;
+        match.device_class_mask = device_class_mask;
+        match.match_data = 0;
+        iter = pci_id_match_iterator_create(&match);
+        while ((device = pci_device_next(iter)) != NULL) {
+            pci_device_match(vendor_devices, device->vendor_id, device->device_id, device->domain, device->bus, device->dev, device->func,
+                    scan, &feature_list, gpus, hcas);
+        }
+        pci_iterator_destroy(iter);
+        pci_system_cleanup();
+    }
+    scan->features = feature_list;
+    {
+        /* The KFD knows every AMD GPU's target, listed or not: */
+        char                    *kfd_gfx_features = NULL;
+        
+        if ( pci_kfd_gfx_targets(&kfd_gfx_features) ) {
+            xfree(scan->gpu_gfx_features);
+            scan->gpu_gfx_features = kfd_gfx_features;
+        }
+    }
+    scan->gpu_nic_locality = ( scan->n_gpus && scan->n_hcas ) ? pci_gpu_nic_switch : pci_gpu_nic_remote;
+    n_numa_nodes = ( scan->n_gpus && scan->n_hcas ) ? pci_numa_node_count() : 0;
+    for ( i = 0; i < scan->n_gpus; i++ ) {
+        pci_gpu_nic_locality_t  nearest = pci_gpu_nic_remote;
+        
+        for ( j = 0; j < scan->n_hcas; j++ ) {
+            pci_gpu_nic_locality_t  locality = pci_gpu_nic_locality(&gpus[i], &hcas[j], n_numa_nodes);
+            
+            if ( (gpus[i].iommu_group >= 0) && (gpus[i].iommu_group == hcas[j].iommu_group) ) scan->is_gpu_hca_group_shared = true;
+            if ( locality > nearest ) nearest = locality;
+        }
+        if ( nearest < scan->gpu_nic_locality ) scan->gpu_nic_locality = nearest;
+    }
+    free(gpus);
+    return true;
+}
+
+/**
+ * @var     nvidia_gpu_devices
+ * @brief   The list of NVIDIA GPU devices that exist in this cluster
+ */
+static pci_vendor_devices_t     nvidia_gpu_devices = {
+            .vendor_id = 0x10de, .device_features = {
+            /* P100 PCI, 12GB  */ { .device_id = 0x15f7, .feature_name = "PCI::GPU::P100",  .kind = pci_device_kind_gpu, .arch_feature = "GPU::CC::6.0" },
+            /* V100 SXM2, 32GB */ { .device_id = 0x1db5, .feature_name = "PCI::GPU::V100",  .kind = pci_device_kind_gpu, .arch_feature = "GPU::CC::7.0" },
+            /* V100 PCI, 32GB  */ { .device_id = 0x1db6, .feature_name = "PCI::GPU::V100",  .kind = pci_device_kind_gpu, .arch_feature = "GPU::CC::7.0" },
+            /* T4              */ { .device_id = 0x1eb8, .feature_name = "PCI::GPU::T4",    .kind = pci_device_kind_gpu, .arch_feature = "GPU::CC::7.5" },
+            /* A100 PCI, 80GB  */ { .device_id = 0x20b5, .feature_name = "PCI::GPU::A100",  .kind = pci_device_kind_gpu, .arch_feature = "GPU::CC::8.0" },
+            /* A40             */ { .device_id = 0x2235, .feature_name = "PCI::GPU::A40",   .kind = pci_device_kind_gpu, .arch_feature = "GPU::CC::8.6" },
+                                  { .device_id = 0x0000, .feature_name = NULL             }
+    } };
+    
+/**
+ * @var     amd_gpu_devices
+ * @brief   The list of AMD GPU devices that exist in this cluster
+ */
+static pci_vendor_devices_t     amd_gpu_devices = {
+            .vendor_id = 0x1002, .device_features = {
+            /* Mi50     */ { .device_id = 0x66a1, .feature_name = "PCI::GPU::MI50",  .kind = pci_device_kind_gpu, .arch_feature = "GPU::GFX::gfx906" },
+            /* Mi100    */ { .device_id = 0x738c, .feature_name = "PCI::GPU::MI100", .kind = pci_device_kind_gpu, .arch_feature = "GPU::GFX::gfx908" },
+            /* Mi250X   */ { .device_id = 0x740c, .feature_name = "PCI::GPU::MI250X", .kind = pci_device_kind_gpu, .arch_feature = "GPU::GFX::gfx90a" },
+            /* Mi210    */ { .device_id = 0x740f, .feature_name = "PCI::GPU::MI210", .kind = pci_device_kind_gpu, .arch_feature = "GPU::GFX::gfx90a" },
+                           { .device_id = 0x0000, .feature_name = NULL              }
+    } };
+    
+/**
+ * @var     mellanox_hca_devices
+ * @brief   The list of NVIDIA/Mellanox HCA devices that exist in this cluster
+ */
+static pci_vendor_devices_t     mellanox_hca_devices = {
+            .vendor_id = 0x15b3, .device_features = {
+            /* ConnectX-5     */ { .device_id = 0x1017, .feature_name = "PCI::HCA::CX5",   .kind = pci_device_kind_hca },
+            /* ConnectX-5 Ex  */ { .device_id = 0x1019, .feature_name = "PCI::HCA::CX5",   .kind = pci_device_kind_hca },
+            /* ConnectX-6     */ { .device_id = 0x101b, .feature_name = "PCI::HCA::CX6",   .kind = pci_device_kind_hca },
+            /* ConnectX-6 Dx  */ { .device_id = 0x101d, .feature_name = "PCI::HCA::CX6DX", .kind = pci_device_kind_hca },
+            /* ConnectX-7     */ { .device_id = 0x1021, .feature_name = "PCI::HCA::CX7",   .kind = pci_device_kind_hca },
+                                 { .device_id = 0x0000, .feature_name = NULL                                            }
+    } };
+    
+/**
+ * @var     pci_known_devices
+ * @brief   The list of PCI vendors (and their devices) that exist in this cluster
+ */
+static pci_vendor_devices_ptr   pci_known_devices[] = {
+                                    &nvidia_gpu_devices,
+                                    &amd_gpu_devices,
+                                    &mellanox_hca_devices,
+                                    NULL
+                                };
+
+/**
+ * @var     pci_known_device_class
+ * @brief   The PCI device class we're interested in iterating
+ * @details GPUs (display and processing-accelerator classes) and HCAs
+ *          (network class) are all of interest, so every device is
+ *          iterated and the vendor lists select the ones that matter.
+ */
+static const uint32_t           pci_known_device_class = 0x000000;
+
+/**
+ * @var     pci_known_device_class_mask
+ * @brief   The bitmask for PCI device class components we're
+ *          interested in iterating
+ */
+static const uint32_t           pci_known_device_class_mask = 0x000000;
+
+
+#endif
+
+
+/**
+ * @var     cpuinfo_file
+ * @brief   Path of the cpuinfo file the cpuinfo probe reads
+ * @details If @a NULL, /proc/cpuinfo below the sysfs root is read.
+ */
+static const char *cpuinfo_file = NULL;
+
+/**
+ * @brief   Maximum number of registered node probes
+ * @details Bounded by the width of the node_snapshot_t bitmaps.
+ */
+#define NODE_PROBE_MAX          (sizeof(unsigned int) * 8)
+
+/**
+ * @brief   Everything the probes have learned about a node
+ * @details Each probe owns one field of the snapshot (located by the
+ *          @a arg_offset of its registration record).  A probe may read
+ *          the fields of probes registered ahead of it.
+ */
+typedef struct node_snapshot {
+    unsigned int            valid;      /**< bitmap of probes whose field is valid (w.r.t. node_probes indices) */
+    unsigned int            timed_out;  /**< bitmap of probes whose last run overran its deadline */
+    char                    *manifest;  /**< validated image manifest features standing in for the non-volatile probes */
+    time_t                  retry_after[NODE_PROBE_MAX];    /**< earliest retry of a timed-out probe */
+    hwloc_topology_results_t hwloc;     /**< slurmd's cached hwloc topology */
+#ifdef HAVE_PCI_DETECTION
+    pci_scan_results_t      pci;        /**< PCI scan results */
+#endif
+    cpuinfo_features_t      cpuinfo;    /**< cpuinfo features */
+    catalog_probe_results_t catalog;    /**< hardware catalog results */
+    perf_probe_results_t    perf;       /**< calibrated probe results */
+    edac_probe_results_t    edac;       /**< EDAC memory controller results */
+    dmi_memory_results_t    dmi_memory; /**< DMI memory device results */
+    iommu_probe_results_t   iommu;      /**< IOMMU mode results */
+    isolation_probe_results_t isolation; /**< CPU isolation results */
+    rapl_probe_results_t    rapl;       /**< RAPL power domain results */
+    fs_probe_results_t      fs;         /**< filesystem mount results */
+} node_snapshot_t;
+
+/**
+ * @brief   Opaque pointer to a node probe registration record
+ */
+typedef struct node_probe * node_probe_ref;
+
+/**
+ * @brief   Type of a callback function that runs a probe
+ * @details The probe's field of @a snapshot holds the results of its
+ *          previous run (or zeroes) on entry and must be replaced.
+ * @param   probe       the registration record for the probe
+ * @param   config      the plugin configuration
+ * @param   snapshot    the node snapshot
+ * @return  Boolean false if the probe failed and its field is not valid
+ */
+typedef bool (*node_probe_run_cb)(node_probe_ref probe, cpuinfo_config_t *config, node_snapshot_t *snapshot);
+
+/**
+ * @brief   Type of a callback function that appends a probe's features
+ * @param   probe       the registration record for the probe
+ * @param   config      the plugin configuration
+ * @param   snapshot    the node snapshot
+ * @param   features    pointer to the feature string to extend
+ * @param   delim       pointer to the current delimiter
+ */
+typedef void (*node_probe_fmtcat_cb)(node_probe_ref probe, cpuinfo_config_t *config, node_snapshot_t *snapshot, char **features, const char **delim);
+
+/**
+ * @brief   Type of a callback function that releases a probe's resources
+ * @param   probe       the registration record for the probe
+ * @param   snapshot    the node snapshot
+ */
+typedef void (*node_probe_reset_cb)(node_probe_ref probe, node_snapshot_t *snapshot);
+
+/**
+ * @brief   Type of a callback function that deep-copies a probe's field
+ * @details On entry the field of @a dst is a bitwise copy of @a src; any
+ *          memory it references must be replaced by copies.
+ * @param   probe       the registration record for the probe
+ * @param   dst         the snapshot being filled-in
+ * @param   src         the snapshot being copied
+ */
+typedef void (*node_probe_copy_cb)(node_probe_ref probe, node_snapshot_t *dst, const node_snapshot_t *src);
+
+/**
+ * @brief   Kernel subsystems whose hotplug events affect a probe
+ */
+typedef enum {
+    node_uevent_subsystem_cpu = 1 << 0,
+    node_uevent_subsystem_pci = 1 << 1
+} node_uevent_subsystem_t;
+
+/**
+ * @brief   Registration data structure for a node probe
+ */
+typedef struct node_probe {
+    const char              *name;          /**< Short name of the probe */
+    node_probe_run_cb       run_cb;         /**< Runs the probe */
+    node_probe_fmtcat_cb    fmtcat_cb;      /**< Optional, appends the probe's features */
+    node_probe_reset_cb     reset_cb;       /**< Optional, releases the probe's resources */
+    node_probe_copy_cb      copy_cb;        /**< Optional, deep-copies the probe's field */
+    size_t                  arg_offset;     /**< Offset of the probe's field in node_snapshot_t */
+    size_t                  arg_size;       /**< Size of the probe's field */
+    bool                    is_volatile;    /**< Run on every update rather than once */
+    bool                    is_costly;      /**< Skipped when the hardware catalog knows the node */
+    unsigned int            uevent_subsystems;  /**< Hotplug subsystems that invalidate the probe */
+    const char              *after;         /**< Optional, the probe whose results it reads */
+} node_probe_t;
+
+/**
+ * @brief   node_probe_run_cb for the hwloc topology probe
+ */
+static bool
+node_probe_hwloc_run(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot
+)
+{
+    return hwloc_probe_run(&snapshot->hwloc, config);
+}
+
+#ifdef HAVE_PCI_DETECTION
+
+/**
+ * @brief   node_probe_run_cb for the PCI device probe
+ */
+static bool
+node_probe_pci_run(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot
+)
+{
+    /* slurmd's topology predates any hotplugged device: */
+    return pci_device_lookup(pci_known_devices, pci_known_device_class, pci_known_device_class_mask,
+                config->hotplug_listener ? NULL : &snapshot->hwloc, &snapshot->pci);
+}
+
+/**
+ * @brief   node_probe_fmtcat_cb for the PCI device probe
+ */
+static void
+node_probe_pci_fmtcat(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot,
+    char                **features,
+    const char          **delim
+)
+{
+    if ( snapshot->pci.features && *snapshot->pci.features ) xstrfmtcat(*features, "%s%s", *delim, snapshot->pci.features), *delim = ",";
+    if ( snapshot->pci.gpu_cc_features ) xstrfmtcat(*features, "%s%s", *delim, snapshot->pci.gpu_cc_features), *delim = ",";
+    if ( snapshot->pci.gpu_gfx_features ) xstrfmtcat(*features, "%s%s", *delim, snapshot->pci.gpu_gfx_features), *delim = ",";
+    {
+        /* A closer tier implies the farther ones, so a job can ask for the least it needs: */
+        pci_gpu_nic_locality_t  locality = snapshot->pci.gpu_nic_locality;
+        
+        while ( locality != pci_gpu_nic_remote ) {
+            xstrfmtcat(*features, "%sPCI::GPU_NIC::%s", *delim, pci_gpu_nic_locality_strings[locality]), *delim = ",";
+            locality--;
+        }
+    }
+}
+
+/**
+ * @brief   node_probe_reset_cb for the PCI device probe
+ */
+static void
+node_probe_pci_reset(
+    node_probe_ref      probe,
+    node_snapshot_t     *snapshot
+)
+{
+    pci_scan_results_reset(&snapshot->pci);
+}
+
+/**
+ * @brief   node_probe_copy_cb for the PCI device probe
+ */
+static void
+node_probe_pci_copy(
+    node_probe_ref          probe,
+    node_snapshot_t         *dst,
+    const node_snapshot_t   *src
+)
+{
+    dst->pci.features = src->pci.features ? xstrdup(src->pci.features) : NULL;
+    dst->pci.gpu_cc_features = src->pci.gpu_cc_features ? xstrdup(src->pci.gpu_cc_features) : NULL;
+    dst->pci.gpu_gfx_features = src->pci.gpu_gfx_features ? xstrdup(src->pci.gpu_gfx_features) : NULL;
+}
+
+#endif
+
+/**
+ * @brief   Parse this node's cpuinfo
+ * @details Reads @a cpuinfo_file if set, otherwise /proc/cpuinfo below the
+ *          sysfs root.
+ * @param   cif     pointer to the (initialized) cpuinfo_features_t to fill-in
+ * @return  Boolean true if the file was parsed successfully
+ */
+static bool
+node_cpuinfo_parse(
+    cpuinfo_features_t  *cif
+)
+{
+    char                path[PATH_MAX];
+    
+    if ( cpuinfo_file ) return cpuinfo_parse_file(cif, cpuinfo_file);
+    return sysfs_path(path, sizeof(path), "/proc/cpuinfo") && cpuinfo_parse_file(cif, path);
+}
+
+/**
+ * @brief   node_probe_run_cb for the cpuinfo probe
+ */
+static bool
+node_probe_cpuinfo_run(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot
+)
+{
+    bool                is_okay;
+    
+    cpuinfo_features_reset(&snapshot->cpuinfo);
+    is_okay = node_cpuinfo_parse(&snapshot->cpuinfo);
+    if ( snapshot->hwloc.is_loaded ) {
+        hwloc_cpuinfo_overlay(&snapshot->cpuinfo, &snapshot->hwloc);
+        is_okay = true;
+    }
+    return is_okay;
+}
+
+/**
+ * @brief   node_probe_fmtcat_cb for the cpuinfo probe
+ */
+static void
+node_probe_cpuinfo_fmtcat(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot,
+    char                **features,
+    const char          **delim
+)
+{
+    cpuinfo_features_fmtcat(&snapshot->cpuinfo, features, delim);
+}
+
+/**
+ * @brief   node_probe_reset_cb for the cpuinfo probe
+ */
+static void
+node_probe_cpuinfo_reset(
+    node_probe_ref      probe,
+    node_snapshot_t     *snapshot
+)
+{
+    cpuinfo_features_reset(&snapshot->cpuinfo);
+}
+
+/**
+ * @brief   node_probe_copy_cb for the cpuinfo probe
+ */
+static void
+node_probe_cpuinfo_copy(
+    node_probe_ref          probe,
+    node_snapshot_t         *dst,
+    const node_snapshot_t   *src
+)
+{
+    dst->cpuinfo.vendor_id = src->cpuinfo.vendor_id ? strdup(src->cpuinfo.vendor_id) : NULL;
+    dst->cpuinfo.model_name = src->cpuinfo.model_name ? strdup(src->cpuinfo.model_name) : NULL;
+}
+
+/**
+ * @brief   node_probe_run_cb for the hardware catalog probe
+ */
+static bool
+node_probe_catalog_run(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot
+)
+{
+    return catalog_probe_run(&snapshot->catalog, config, &snapshot->cpuinfo);
+}
+
+/**
+ * @brief   node_probe_fmtcat_cb for the hardware catalog probe
+ */
+static void
+node_probe_catalog_fmtcat(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot,
+    char                **features,
+    const char          **delim
+)
+{
+    if ( snapshot->catalog.features && *snapshot->catalog.features ) xstrfmtcat(*features, "%s%s", *delim, snapshot->catalog.features), *delim = ",";
+}
+
+/**
+ * @brief   node_probe_reset_cb for the hardware catalog probe
+ */
+static void
+node_probe_catalog_reset(
+    node_probe_ref      probe,
+    node_snapshot_t     *snapshot
+)
+{
+    if ( snapshot->catalog.features ) free(snapshot->catalog.features);
+    memset(&snapshot->catalog, 0, sizeof(snapshot->catalog));
+}
+
+/**
+ * @brief   node_probe_copy_cb for the hardware catalog probe
+ */
+static void
+node_probe_catalog_copy(
+    node_probe_ref          probe,
+    node_snapshot_t         *dst,
+    const node_snapshot_t   *src
+)
+{
+    dst->catalog.features = src->catalog.features ? strdup(src->catalog.features) : NULL;
+}
+
+/**
+ * @brief   node_probe_run_cb for the calibrated performance probe
+ */
+static bool
+node_probe_perf_run(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot
+)
+{
+    if ( ! config->perf_index ) return false;
+    return perf_probe_run(&snapshot->perf, config, &snapshot->cpuinfo);
+}
+
+/**
+ * @brief   node_probe_fmtcat_cb for the calibrated performance probe
+ */
+static void
+node_probe_perf_fmtcat(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot,
+    char                **features,
+    const char          **delim
+)
+{
+    perf_probe_features(&snapshot->perf, config, features, delim);
+}
+
+/**
+ * @brief   node_probe_run_cb for the EDAC memory controller probe
+ */
+static bool
+node_probe_edac_run(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot
+)
+{
+    return edac_probe_run(&snapshot->edac, config->edac_ce_threshold);
+}
+
+/**
+ * @brief   node_probe_fmtcat_cb for the EDAC memory controller probe
+ */
+static void
+node_probe_edac_fmtcat(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot,
+    char                **features,
+    const char          **delim
+)
+{
+    edac_probe_features(&snapshot->edac, features, delim);
+}
+
+/**
+ * @brief   node_probe_run_cb for the DMI memory device probe
+ */
+static bool
+node_probe_dmi_memory_run(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot
+)
+{
+    return dmi_memory_probe_run(&snapshot->dmi_memory);
+}
+
+/**
+ * @brief   node_probe_fmtcat_cb for the DMI memory device probe
+ */
+static void
+node_probe_dmi_memory_fmtcat(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot,
+    char                **features,
+    const char          **delim
+)
+{
+    dmi_memory_probe_features(&snapshot->dmi_memory, config, features, delim);
+}
+
+/**
+ * @brief   node_probe_run_cb for the IOMMU probe
+ */
+static bool
+node_probe_iommu_run(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot
+)
+{
+    return iommu_probe_run(&snapshot->iommu);
+}
+
+/**
+ * @brief   node_probe_fmtcat_cb for the IOMMU probe
+ * @details In addition to the mode, nodes with both GPUs and HCAs note
+ *          whether any GPU-HCA pair shares an IOMMU group (from the PCI
+ *          probe, which is registered ahead of this one).
+ */
+static void
+node_probe_iommu_fmtcat(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot,
+    char                **features,
+    const char          **delim
+)
+{
+    xstrfmtcat(*features, "%sIOMMU::%s", *delim, iommu_mode_strings[snapshot->iommu.mode]), *delim = ",";
+#ifdef HAVE_PCI_DETECTION
+    if ( (snapshot->iommu.mode != iommu_mode_off) && snapshot->pci.n_gpus && snapshot->pci.n_hcas ) {
+        xstrfmtcat(*features, "%sIOMMU::GPU_HCA::%s", *delim, snapshot->pci.is_gpu_hca_group_shared ? "shared" : "split"), *delim = ",";
+    }
+#endif
+}
+
+/**
+ * @brief   node_probe_run_cb for the CPU isolation probe
+ */
+static bool
+node_probe_isolation_run(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot
+)
+{
+    return isolation_probe_run(&snapshot->isolation);
+}
+
+/**
+ * @brief   node_probe_fmtcat_cb for the CPU isolation probe
+ */
+static void
+node_probe_isolation_fmtcat(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot,
+    char                **features,
+    const char          **delim
+)
+{
+    isolation_probe_features(&snapshot->isolation, features, delim);
+}
+
+/**
+ * @brief   node_probe_run_cb for the RAPL probe
+ */
+static bool
+node_probe_rapl_run(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot
+)
+{
+    return rapl_probe_run(&snapshot->rapl);
+}
+
+/**
+ * @brief   node_probe_fmtcat_cb for the RAPL probe
+ */
+static void
+node_probe_rapl_fmtcat(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot,
+    char                **features,
+    const char          **delim
+)
+{
+    rapl_probe_features(&snapshot->rapl, config, features, delim);
+}
+
+/**
+ * @brief   node_probe_run_cb for the filesystem probe
+ */
+static bool
+node_probe_fs_run(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot
+)
+{
+    return fs_probe_run(&snapshot->fs, config->fs_paths);
+}
+
+/**
+ * @brief   node_probe_fmtcat_cb for the filesystem probe
+ */
+static void
+node_probe_fs_fmtcat(
+    node_probe_ref      probe,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot,
+    char                **features,
+    const char          **delim
+)
+{
+    fs_probe_features(&snapshot->fs, config, features, delim);
+}
+
+/**
+ * @var     node_probes
+ * @brief   The list of node probes
+ * @details Features are appended in this order.  A probe is started once
+ *          the probe it reads (@a after) has finished, every other probe at
+ *          once; a probe must follow the one it reads.  A struct with all
+ *          fields' being NULL/0 acts as the list terminator.
+ */
+static node_probe_t node_probes[] = {
+        { "hwloc", node_probe_hwloc_run, NULL, NULL, NULL,
+                offsetof(node_snapshot_t, hwloc), sizeof(hwloc_topology_results_t), false, false,
+                0, NULL },
+#ifdef HAVE_PCI_DETECTION
+        { "pci", node_probe_pci_run, node_probe_pci_fmtcat, node_probe_pci_reset, node_probe_pci_copy,
+                offsetof(node_snapshot_t, pci), sizeof(pci_scan_results_t), true, false,
+                node_uevent_subsystem_pci, "hwloc" },
+#endif
+        { "cpuinfo", node_probe_cpuinfo_run, node_probe_cpuinfo_fmtcat, node_probe_cpuinfo_reset, node_probe_cpuinfo_copy,
+                offsetof(node_snapshot_t, cpuinfo), sizeof(cpuinfo_features_t), false, false,
+                node_uevent_subsystem_cpu, "hwloc" },
+        { "catalog", node_probe_catalog_run, node_probe_catalog_fmtcat, node_probe_catalog_reset, node_probe_catalog_copy,
+                offsetof(node_snapshot_t, catalog), sizeof(catalog_probe_results_t), false, false,
+                node_uevent_subsystem_pci, "cpuinfo" },
+        { "perf", node_probe_perf_run, node_probe_perf_fmtcat, NULL, NULL,
+                offsetof(node_snapshot_t, perf), sizeof(perf_probe_results_t), false, true,
+                0, "catalog" },
+        { "edac", node_probe_edac_run, node_probe_edac_fmtcat, NULL, NULL,
+                offsetof(node_snapshot_t, edac), sizeof(edac_probe_results_t), true, false,
+                0, NULL },
+        { "dmi_memory", node_probe_dmi_memory_run, node_probe_dmi_memory_fmtcat, NULL, NULL,
+                offsetof(node_snapshot_t, dmi_memory), sizeof(dmi_memory_results_t), false, true,
+                0, "catalog" },
+        { "iommu", node_probe_iommu_run, node_probe_iommu_fmtcat, NULL, NULL,
+                offsetof(node_snapshot_t, iommu), sizeof(iommu_probe_results_t), false, false,
+                node_uevent_subsystem_pci, NULL },
+        { "isolation", node_probe_isolation_run, node_probe_isolation_fmtcat, NULL, NULL,
+                offsetof(node_snapshot_t, isolation), sizeof(isolation_probe_results_t), false, false,
+                node_uevent_subsystem_cpu, NULL },
+        { "rapl", node_probe_rapl_run, node_probe_rapl_fmtcat, NULL, NULL,
+                offsetof(node_snapshot_t, rapl), sizeof(rapl_probe_results_t), true, false,
+                0, NULL },
+        { "fs", node_probe_fs_run, node_probe_fs_fmtcat, NULL, NULL,
+                offsetof(node_snapshot_t, fs), sizeof(fs_probe_results_t), true, false,
+                0, NULL },
+        { NULL, NULL, NULL, NULL, NULL, 0, 0, false, false, 0, NULL }
+    };
+
+/**
+ * @brief   Initialize a node_snapshot_t data structure
+ * @param   snapshot    pointer to the node_snapshot_t
+ * @return  Returns @a snapshot (for chaining operations)
+ */
+static node_snapshot_t*
+node_snapshot_init(
+    node_snapshot_t     *snapshot
+)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    return snapshot;
+}
+
+/**
+ * @brief   Reset a node_snapshot_t data structure
+ * @details Every probe releases its resources, then all fields are
+ *          reinitialized
+ * @param   snapshot    pointer to the node_snapshot_t
+ * @return  Returns @a snapshot (for chaining operations)
+ */
+static node_snapshot_t*
+node_snapshot_reset(
+    node_snapshot_t     *snapshot
+)
+{
+    node_probe_t        *probe = node_probes;
+    
+    while ( probe->name ) {
+        if ( probe->reset_cb ) probe->reset_cb(probe, snapshot);
+        probe++;
+    }
+    if ( snapshot->manifest ) free(snapshot->manifest);
+    return node_snapshot_init(snapshot);
+}
+
+/**
+ * @brief   Copy a node_snapshot_t data structure
+ * @details Every probe with heap-allocated results deep-copies them so that
+ *          @a dst is independent of @a src
+ * @param   dst         pointer to the (uninitialized) node_snapshot_t
+ * @param   src         pointer to the node_snapshot_t to copy
+ * @return  Returns @a dst (for chaining operations)
+ */
+static node_snapshot_t*
+node_snapshot_copy(
+    node_snapshot_t         *dst,
+    const node_snapshot_t   *src
+)
+{
+    node_probe_t            *probe = node_probes;
+    
+    *dst = *src;
+    while ( probe->name ) {
+        if ( probe->copy_cb ) probe->copy_cb(probe, dst, src);
+        probe++;
+    }
+    dst->manifest = src->manifest ? strdup(src->manifest) : NULL;
+    return dst;
+}
+
+/**
+ * @brief   Mark every probe's results as needing to be refreshed
+ * @details The previous results are retained so probes can compare
+ *          against them or reuse expensive measurements.
+ * @param   snapshot    pointer to the node_snapshot_t
+ */
+static HARNESS_UNUSED void
+node_snapshot_invalidate(
+    node_snapshot_t     *snapshot
+)
+{
+    snapshot->valid = 0;
+}
+
+/**
+ * @var     node_probe_orphans
+ * @brief   Bitmap of probes (w.r.t. node_probes indices) whose abandoned
+ *          helper thread has not yet finished
+ * @details A probe is never started again while its previous helper is
+ *          still blocked.  Protected by node_probe_orphans_mutex.
+ */
+static unsigned int node_probe_orphans = 0;
+static pthread_mutex_t node_probe_orphans_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief   A probe run handed to a helper thread
+ * @details The helper works on private copies of the configuration and
+ *          snapshot so that an abandoned helper never touches memory the
+ *          caller may since have released.  Whichever of the caller and
+ *          the helper finishes with the job last disposes of it.
+ */
+typedef struct node_probe_job {
+    pthread_mutex_t     lock;           /**< protects is_done, is_abandoned and result */
+    pthread_cond_t      cond;           /**< signalled when the helper finishes */
+    bool                is_done;        /**< the probe has returned */
+    bool                is_abandoned;   /**< the caller gave up waiting */
+    bool                result;         /**< the probe's return value */
+    node_probe_ref      probe;          /**< the probe to run */
+    unsigned int        mask;           /**< the probe's bit in the snapshot bitmaps */
+    cpuinfo_config_t    config;         /**< private copy of the configuration */
+    node_snapshot_t     snapshot;       /**< private copy of the snapshot */
+} node_probe_job_t;
+
+/**
+ * @brief   Dispose of a node_probe_job_t
+ */
+static void
+node_probe_job_free(
+    node_probe_job_t    *job
+)
+{
+    node_snapshot_reset(&job->snapshot);
+    cpuinfo_config_reset(&job->config);
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->lock);
+    free(job);
+}
+
+/**
+ * @brief   Body of a probe helper thread
+ * @param   arg     the node_probe_job_t
+ * @return  Always @a NULL
+ */
+static void*
+node_probe_job_thread(
+    void                *arg
+)
+{
+    node_probe_job_t    *job = (node_probe_job_t*)arg;
+    bool                result = job->probe->run_cb(job->probe, &job->config, &job->snapshot);
+    bool                is_abandoned;
+    
+    pthread_mutex_lock(&job->lock);
+    job->result = result;
+    job->is_done = true;
+    is_abandoned = job->is_abandoned;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+    if ( is_abandoned ) {
+        info("node_probe_job_thread: %s probe finished after being abandoned", job->probe->name);
+        pthread_mutex_lock(&node_probe_orphans_mutex);
+        node_probe_orphans &= ~job->mask;
+        pthread_mutex_unlock(&node_probe_orphans_mutex);
+        node_probe_job_free(job);
+    }
+    return NULL;
+}
+
+/**
+ * @brief   Start a probe on a helper thread
+ * @details With a zero ProbeTimeoutMS, or if no thread can be started, the
+ *          probe runs on the calling thread instead.  A probe that timed
+ *          out is not tried again for ProbeBackoff seconds nor while its
+ *          abandoned helper is still running.
+ * @param   probe       the probe to run
+ * @param   mask        the probe's bit in the snapshot bitmaps
+ * @param   config      the plugin configuration
+ * @param   snapshot    the node snapshot
+ * @param   result      set to the probe's result when it did not start a
+ *                      helper
+ * @return  The helper's job, to be passed to node_probe_finish(), or
+ *          @a NULL if the probe has already finished (or was skipped)
+ */
+static node_probe_job_t*
+node_probe_start(
+    node_probe_t        *probe,
+    unsigned int        mask,
+    cpuinfo_config_t    *config,
+    node_snapshot_t     *snapshot,
+    bool                *result
+)
+{
+    node_probe_job_t    *job;
+    pthread_condattr_t  cond_attr;
+    pthread_attr_t      thread_attr;
+    pthread_t           thread;
+    time_t              now = time(NULL);
+    bool                is_orphaned;
+    
+    *result = false;
+    if ( ! config->probe_timeout_ms ) {
+        *result = probe->run_cb(probe, config, snapshot);
+        return NULL;
+    }
+    
+    pthread_mutex_lock(&node_probe_orphans_mutex);
+    is_orphaned = ( (node_probe_orphans & mask) != 0 );
+    pthread_mutex_unlock(&node_probe_orphans_mutex);
+    if ( is_orphaned || ((snapshot->timed_out & mask) && (now < snapshot->retry_after[probe - node_probes])) ) {
+        debug("node_probe_start: %s probe skipped after timeout", probe->name);
+        return NULL;
+    }
+    
+    job = (node_probe_job_t*)calloc(1, sizeof(*job));
+    if ( ! job ) return NULL;
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&job->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    job->probe = probe;
+    job->mask = mask;
+    cpuinfo_config_copy(&job->config, config);
+    node_snapshot_copy(&job->snapshot, snapshot);
+    
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    if ( pthread_create(&thread, &thread_attr, node_probe_job_thread, job) ) {
+        pthread_attr_destroy(&thread_attr);
+        node_probe_job_free(job);
+        error("node_probe_start: unable to start %s probe thread, running inline", probe->name);
+        *result = probe->run_cb(probe, config, snapshot);
+        return NULL;
+    }
+    pthread_attr_destroy(&thread_attr);
+    return job;
+}
+
+/**
+ * @brief   Wait for a probe's helper thread until a deadline
+ * @details On success the probe's field is moved into @a snapshot.  A
+ *          helper that overruns is abandoned (left to finish and clean up
+ *          on its own) and the probe is marked as timed out; its previous
+ *          results are left in place but are not valid.
+ * @param   job         the job node_probe_start() returned
+ * @param   config      the plugin configuration
+ * @param   snapshot    the node snapshot
+ * @param   deadline    CLOCK_MONOTONIC time at which to give up
+ * @return  Boolean true if the probe completed in time and produced results
+ */
+static bool
+node_probe_finish(
+    node_probe_job_t        *job,
+    cpuinfo_config_t        *config,
+    node_snapshot_t         *snapshot,
+    const struct timespec   *deadline
+)
+{
+    node_probe_t            *probe = (node_probe_t*)job->probe;
+    unsigned int            mask = job->mask;
+    bool                    result;
+    int                     rc = 0;
+    
+    pthread_mutex_lock(&job->lock);
+    while ( ! job->is_done && (rc != ETIMEDOUT) ) rc = pthread_cond_timedwait(&job->cond, &job->lock, deadline);
+    if ( ! job->is_done ) {
+        job->is_abandoned = true;
+        pthread_mutex_lock(&node_probe_orphans_mutex);
+        node_probe_orphans |= mask;
+        pthread_mutex_unlock(&node_probe_orphans_mutex);
+        pthread_mutex_unlock(&job->lock);
+        snapshot->timed_out |= mask;
+        snapshot->retry_after[probe - node_probes] = time(NULL) + config->probe_backoff;
+        error("node_probe_finish: %s probe still running at the %u ms deadline, retrying in %u s", probe->name, config->probe_timeout_ms, config->probe_backoff);
+        return false;
+    }
+    pthread_mutex_unlock(&job->lock);
+    
+    /* Move the probe's field into the caller's snapshot: */
+    if ( probe->reset_cb ) probe->reset_cb(probe, snapshot);
+    memcpy((void*)snapshot + probe->arg_offset, (void*)&job->snapshot + probe->arg_offset, probe->arg_size);
+    memset((void*)&job->snapshot + probe->arg_offset, 0, probe->arg_size);
+    snapshot->timed_out &= ~mask;
+    result = job->result;
+    node_probe_job_free(job);
+    return result;
+}
+
+/**
+ * @brief   Run a set of probes under one deadline
+ * @details Every probe is started on a helper thread as soon as the probe
+ *          it reads has finished, and all of them are waited for against a
+ *          single ProbeTimeoutMS deadline for the whole pass, so hung
+ *          probes delay the caller by ProbeTimeoutMS at most however many
+ *          there are.  A probe whose input was still running at the
+ *          deadline is left for the next pass.  Costly probes are skipped,
+ *          and their results invalidated, when the hardware catalog probe
+ *          found this node.
+ * @param   snapshot    pointer to the node_snapshot_t
+ * @param   config      the plugin configuration
+ * @param   due         bitmap of the probes to run
+ * @param   caller      name of the caller, for log messages
+ * @return  Bitmap of the probes that were run
+ */
+static unsigned int
+node_snapshot_run_probes(
+    node_snapshot_t     *snapshot,
+    cpuinfo_config_t    *config,
+    unsigned int        due,
+    const char          *caller
+)
+{
+    node_probe_job_t    *jobs[sizeof(node_probes) / sizeof(node_probes[0])] = { NULL };
+    node_probe_t        *probe, *input, *reader;
+    unsigned int        mask, input_mask, did_run = 0, pending = due, late = 0;
+    struct timespec     deadline;
+    
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += config->probe_timeout_ms / 1000;
+    deadline.tv_nsec += (long)(config->probe_timeout_ms % 1000) * 1000000;
+    if ( deadline.tv_nsec >= 1000000000 ) deadline.tv_sec++, deadline.tv_nsec -= 1000000000;
+    
+    while ( true ) {
+        /* Start every pending probe whose input is ready: */
+        for ( probe = node_probes, mask = 1; probe->name; probe++, mask <<= 1 ) {
+            bool        result;
+            
+            if ( ! (pending & mask) ) continue;
+            for ( input = node_probes, input_mask = 1; input->name && (! probe->after || strcmp(input->name, probe->after)); input++, input_mask <<= 1 );
+            if ( input->name && ((pending & input_mask) || jobs[input - node_probes]) ) continue;
+            pending &= ~mask;
+            if ( input->name && (late & input_mask) ) {
+                debug("%s: %s probe deferred, the %s probe missed the deadline", caller, probe->name, input->name);
+                late |= mask;
+                continue;
+            }
+            if ( probe->is_costly && input->name && (input->run_cb == node_probe_catalog_run) && (snapshot->valid & input_mask) && snapshot->catalog.is_hit ) {
+                snapshot->valid &= ~mask;
+                continue;
+            }
+            did_run |= mask;
+            if ( ! (jobs[probe - node_probes] = node_probe_start(probe, mask, config, snapshot, &result)) ) {
+                if ( result ) {
+                    snapshot->valid |= mask;
+                } else {
+                    snapshot->valid &= ~mask;
+                    debug("%s: %s probe produced no results", caller, probe->name);
+                }
+            }
+        }
+        
+        /* Wait for a running probe, first one that a pending probe reads: */
+        for ( input = NULL, probe = node_probes; probe->name; probe++ ) {
+            if ( ! jobs[probe - node_probes] ) continue;
+            if ( ! input ) input = probe;
+            for ( reader = node_probes, mask = 1; reader->name; reader++, mask <<= 1 ) {
+                if ( (pending & mask) && reader->after && ! strcmp(reader->after, probe->name) ) break;
+            }
+            if ( reader->name ) {
+                input = probe;
+                break;
+            }
+        }
+        if ( ! input ) break;
+        for ( probe = node_probes, mask = 1; probe != input; probe++, mask <<= 1 );
+        if ( node_probe_finish(jobs[probe - node_probes], config, snapshot, &deadline) ) {
+            snapshot->valid |= mask;
+        } else {
+            snapshot->valid &= ~mask;
+            if ( snapshot->timed_out & mask ) late |= mask;
+            debug("%s: %s probe produced no results", caller, probe->name);
+        }
+        jobs[probe - node_probes] = NULL;
+    }
+    return did_run;
+}
+
+/**
+ * @brief   Run the probes whose results are missing or volatile
+ * @details With a validated manifest only the volatile probes are run.
+ * @param   snapshot    pointer to the node_snapshot_t
+ * @param   config      the plugin configuration
+ * @return  Boolean true if any probe has valid results
+ */
+static HARNESS_UNUSED bool
+node_snapshot_update(
+    node_snapshot_t     *snapshot,
+    cpuinfo_config_t    *config
+)
+{
+    node_probe_t        *probe = node_probes;
+    unsigned int        mask = 1, due = 0;
+    
+    while ( probe->name ) {
+        if ( snapshot->manifest && ! probe->is_volatile ) {
+            snapshot->valid &= ~mask;
+        }
+        else if ( probe->is_volatile || ! (snapshot->valid & mask) ) {
+            due |= mask;
+        }
+        probe++, mask <<= 1;
+    }
+    node_snapshot_run_probes(snapshot, config, due, "node_snapshot_update");
+    return ( snapshot->valid != 0 );
+}
+
+#ifndef NODE_FEATURE_CPUINFO_TESTING
+
+/**
+ * @brief   Re-run only the probes affected by hotplug events
+ * @details Probes registered against any of the @a subsystems are run
+ *          whether or not their results are currently valid; every other
+ *          probe's results are left untouched.
+ * @param   snapshot    pointer to the node_snapshot_t
+ * @param   config      the plugin configuration
+ * @param   subsystems  mask of node_uevent_subsystem_t values
+ * @return  Boolean true if any probe was run
+ */
+static bool
+node_snapshot_refresh(
+    node_snapshot_t     *snapshot,
+    cpuinfo_config_t    *config,
+    unsigned int        subsystems
+)
+{
+    node_probe_t        *probe = node_probes;
+    unsigned int        mask = 1, due = 0;
+    
+    if ( snapshot->manifest ) {
+        /* The hardware no longer matches the image, stop trusting it: */
+        info("node_snapshot_refresh: hotplug event, discarding image manifest");
+        free(snapshot->manifest);
+        snapshot->manifest = NULL;
+        node_snapshot_invalidate(snapshot);
+        node_snapshot_update(snapshot, config);
+        return true;
+    }
+    while ( probe->name ) {
+        if ( probe->uevent_subsystems & subsystems ) due |= mask;
+        probe++, mask <<= 1;
+    }
+    return ( node_snapshot_run_probes(snapshot, config, due, "node_snapshot_refresh") != 0 );
+}
+
+#endif
+
+/**
+ * @brief   Append the features of every probe with valid results
+ * @param   snapshot    pointer to the node_snapshot_t
+ * @param   config      the plugin configuration
+ * @param   features    pointer to the feature string to extend
+ * @param   delim       pointer to the current delimiter
+ */
+static HARNESS_UNUSED void
+node_snapshot_fmtcat(
+    node_snapshot_t     *snapshot,
+    cpuinfo_config_t    *config,
+    char                **features,
+    const char          **delim
+)
+{
+    node_probe_t        *probe = node_probes;
+    unsigned int        mask = 1;
+    
+    if ( snapshot->manifest && *snapshot->manifest ) xstrfmtcat(*features, "%s%s", *delim, snapshot->manifest), *delim = ",";
+    while ( probe->name ) {
+        if ( (snapshot->valid & mask) && probe->fmtcat_cb ) probe->fmtcat_cb(probe, config, snapshot, features, delim);
+        probe++, mask <<= 1;
+    }
+    probe = node_probes, mask = 1;
+    while ( probe->name ) {
+        if ( snapshot->timed_out & mask ) xstrfmtcat(*features, "%sHEALTH::PROBE_TIMEOUT::%s", *delim, probe->name), *delim = ",";
+        probe++, mask <<= 1;
+    }
+}
+
+/**
+ * @brief   Validate and adopt an image-baked feature manifest
+ * @details The manifest named by @a config is a "Keyword=Value" file with
+ *          a Fingerprint (hexadecimal, see catalog_fingerprint()) and the
+ *          Features of the node's non-volatile probes.  It is adopted only
+ *          if its fingerprint matches the one computed from this node's
+ *          cpuinfo, DMI and PCI identity; otherwise the mismatch is logged
+ *          and the node is probed as usual.  Any previously adopted
+ *          manifest is discarded first.
+ * @param   snapshot    pointer to the node_snapshot_t
+ * @param   config      the plugin configuration
+ * @return  Boolean true if the manifest was adopted
+ */
+static HARNESS_UNUSED bool
+node_snapshot_load_manifest(
+    node_snapshot_t     *snapshot,
+    cpuinfo_config_t    *config
+)
+{
+    line_reader_t       *line_reader;
+    const char          *line;
+    char                *features = NULL;
+    unsigned long long  fingerprint = 0;
+    uint64_t            live_fingerprint;
+    cpuinfo_features_t  cif;
+    
+    if ( snapshot->manifest ) free(snapshot->manifest);
+    snapshot->manifest = NULL;
+    if ( ! config->manifest_file || ! *config->manifest_file ) return false;
+    
+    if ( ! (line_reader = line_reader_create(config->manifest_file, 0)) ) {
+        /* Not an error:  slurmctld shares cpuinfo.conf but not the image */
+        debug("node_snapshot_load_manifest: unable to read %s, probing", config->manifest_file);
+        return false;
+    }
+    while ( (line = line_reader_nextline(line_reader)) ) {
+        char            *comment = strchr(line, '#');
+        const char      *keyword, *value;
+        size_t          keyword_len;
+        
+        if ( comment ) *comment = '\0', line_reader->used = (comment - line) + 1;
+        line_reader_trim(line_reader);
+        if ( ! cpuinfo_split_keyword_value(line, &keyword, &keyword_len, &value) ) continue;
+        if ( (keyword_len == 11) && ! strncasecmp(keyword, "Fingerprint", 11) ) {
+            fingerprint = strtoull(value, NULL, 16);
+        }
+        else if ( (keyword_len == 8) && ! strncasecmp(keyword, "Features", 8) ) {
+            if ( features ) free(features);
+            features = strdup(value);
+        }
+    }
+    line_reader_free(&line_reader);
+    if ( ! fingerprint || ! features ) {
+        error("node_snapshot_load_manifest: %s lacks a Fingerprint or Features, probing", config->manifest_file);
+        if ( features ) free(features);
+        return false;
+    }
+    
+    cpuinfo_features_init(&cif);
+    node_cpuinfo_parse(&cif);
+    live_fingerprint = catalog_fingerprint(&cif);
+    cpuinfo_features_reset(&cif);
+    if ( live_fingerprint != fingerprint ) {
+        error("node_snapshot_load_manifest: %s was built for %016llx but this node is %016llx, probing",
+                config->manifest_file, fingerprint, (unsigned long long)live_fingerprint);
+        free(features);
+        return false;
+    }
+    info("node_snapshot_load_manifest: using %s", config->manifest_file);
+    snapshot->manifest = features;
+    return true;
+}
+
+/**
+ * @brief   Does a feature match an entry of a FeatureAllow/FeatureDeny list?
+ * @details An entry without "::" names a whole namespace (matched without
+ *          regard to case); any other entry is a shell wildcard pattern
+ *          matched against the complete feature, e.g. "ISA::avx512*".
+ * @param   list        comma-separated list of entries
+ * @param   feature     the feature
+ * @param   feature_len number of characters in @a feature
+ * @return  Boolean true if some entry matches
+ */
+static bool
+feature_policy_list_matches(
+    const char  *list,
+    const char  *feature,
+    size_t      feature_len
+)
+{
+    char        entry[256], whole[256];
+    
+    if ( feature_len >= sizeof(whole) ) return false;
+    memcpy(whole, feature, feature_len);
+    whole[feature_len] = '\0';
+    while ( *list ) {
+        const char  *e;
+        size_t      entry_len;
+        
+        while ( isspace(*list) || (*list == ',') ) list++;
+        e = list;
+        while ( *e && (*e != ',') ) e++;
+        entry_len = e - list;
+        while ( entry_len && isspace(list[entry_len - 1]) ) entry_len--;
+        if ( entry_len && (entry_len < sizeof(entry)) ) {
+            memcpy(entry, list, entry_len);
+            entry[entry_len] = '\0';
+            if ( strstr(entry, "::") ) {
+                if ( fnmatch(entry, whole, 0) == 0 ) return true;
+            }
+            else if ( (feature_len > entry_len + 2) && ! strncasecmp(whole, entry, entry_len) && ! strncmp(whole + entry_len, "::", 2) ) {
+                return true;
+            }
+        }
+        list = e;
+    }
+    return false;
+}
+
+/**
+ * @brief   Index of an ISA:: feature in cpuinfo_flags_strings
+ * @return  The cpuinfo_flags_t index or -1 if @a feature is not a known
+ *          ISA feature
+ */
+static int
+feature_policy_isa_index(
+    const char  *feature,
+    size_t      feature_len
+)
+{
+    int         i;
+    
+    if ( (feature_len <= 5) || strncmp(feature, "ISA::", 5) ) return -1;
+    for ( i = cpuinfo_flags_START; i < cpuinfo_flags_MAX; i++ ) {
+        if ( (strlen(cpuinfo_flags_strings[i]) == feature_len - 5) && ! strncmp(cpuinfo_flags_strings[i], feature + 5, feature_len - 5) ) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief   Apply the feature-suppression policy to a feature list
+ * @details Features are kept in order if they match FeatureAllow (when
+ *          set) and do not match FeatureDeny.  With IsaHighestOnly, of the
+ *          known ISA features only the highest (latest in
+ *          cpuinfo_flags_t order) is kept.  At most FeatureMax features
+ *          (when non-zero) survive.  HEALTH features are always kept and
+ *          do not count against FeatureMax:  a site must not be able to
+ *          trim away the signal that a node is failing.
+ * @param   config      the plugin configuration
+ * @param   features    comma-separated list of features
+ * @param   n_dropped   set to the number of features suppressed
+ * @return  The filtered list (allocated with a Slurm xmalloc etc.) or
+ *          @a NULL if nothing survives
+ */
+static HARNESS_UNUSED char*
+feature_policy_apply(
+    cpuinfo_config_t    *config,
+    const char          *features,
+    unsigned int        *n_dropped
+)
+{
+    char                *out = NULL;
+    const char          *p, *delim = "";
+    unsigned int        n_kept = 0;
+    int                 isa_highest = -1;
+    
+    *n_dropped = 0;
+    if ( ! features ) return NULL;
+    if ( config->isa_highest_only ) {
+        for ( p = features; *p; ) {
+            const char  *e = p;
+            int         isa_index;
+            
+            while ( *e && (*e != ',') ) e++;
+            if ( (isa_index = feature_policy_isa_index(p, e - p)) > isa_highest ) isa_highest = isa_index;
+            p = *e ? e + 1 : e;
+        }
+    }
+    for ( p = features; *p; ) {
+        const char      *e = p;
+        bool            is_kept = true;
+        int             isa_index;
+        
+        while ( *e && (*e != ',') ) e++;
+        if ( e == p ) {
+            p = *e ? e + 1 : e;
+            continue;
+        }
+        if ( ((e - p) > 8) && ! strncmp(p, "HEALTH::", 8) ) {
+            xstrfmtcat(out, "%s%.*s", delim, (int)(e - p), p), delim = ",";
+            p = *e ? e + 1 : e;
+            continue;
+        }
+        if ( config->feature_allow && *config->feature_allow && ! feature_policy_list_matches(config->feature_allow, p, e - p) ) is_kept = false;
+        else if ( config->feature_deny && *config->feature_deny && feature_policy_list_matches(config->feature_deny, p, e - p) ) is_kept = false;
+        else if ( config->isa_highest_only && ((isa_index = feature_policy_isa_index(p, e - p)) >= 0) && (isa_index != isa_highest) ) is_kept = false;
+        else if ( config->feature_max && (n_kept >= config->feature_max) ) is_kept = false;
+        if ( is_kept ) {
+            xstrfmtcat(out, "%s%.*s", delim, (int)(e - p), p), delim = ",";
+            n_kept++;
+        } else {
+            (*n_dropped)++;
+        }
+        p = *e ? e + 1 : e;
+    }
+    return out;
+}
+
+#if ! defined(NODE_FEATURE_CPUINFO_TESTING) || defined(NODE_FEATURE_CPUINFO_NO_MAIN)
+
+/**
+ * @brief   A set of feature-name slices used to de-duplicate feature lists
+ * @details Open addressing with linear probing over a table sized for the
+ *          number of features expected, so lookups stay constant-time and
+ *          list translation stays linear however long the lists grow.
+ */
+typedef struct feature_set {
+    size_t              n_slots;        /**< table size, a power of two */
+    struct {
+        const char      *name;          /**< start of the feature name */
+        size_t          name_len;       /**< characters in the name */
+    }                   *slots;         /**< the table; @a NULL name marks an empty slot */
+} feature_set_t;
+
+/**
+ * @brief   Initialize a feature_set_t able to hold @a capacity features
+ * @details The table comes from xmalloc(), which does not return on
+ *          failure, so translation never has to give up half-way.
+ */
+static void
+feature_set_init(
+    feature_set_t       *set,
+    size_t              capacity
+)
+{
+    set->n_slots = 16;
+    while ( set->n_slots < 2 * capacity ) set->n_slots *= 2;
+    set->slots = xmalloc(set->n_slots * sizeof(*set->slots));
+}
+
+/**
+ * @brief   Dispose of a feature_set_t (the names are not owned by it)
+ */
+static void
+feature_set_reset(
+    feature_set_t       *set
+)
+{
+    xfree(set->slots);
+    set->n_slots = 0;
+}
+
+/**
+ * @brief   Add a feature name to a set
+ * @param   set         the set
+ * @param   name        the feature name (need not be NUL-terminated); must
+ *                      outlive the set
+ * @param   name_len    characters in @a name
+ * @return  Boolean true if the name was added, false if already present
+ */
+static bool
+feature_set_add(
+    feature_set_t       *set,
+    const char          *name,
+    size_t              name_len
+)
+{
+    size_t              slot = catalog_fnv1a(0xcbf29ce484222325ULL, name, name_len) & (set->n_slots - 1);
+    
+    while ( set->slots[slot].name ) {
+        if ( (set->slots[slot].name_len == name_len) && ! memcmp(set->slots[slot].name, name, name_len) ) return false;
+        slot = (slot + 1) & (set->n_slots - 1);
+    }
+    set->slots[slot].name = name;
+    set->slots[slot].name_len = name_len;
+    return true;
+}
+
+/**
+ * @brief   Is a feature name present in a set?
+ * @param   set         the set
+ * @param   name        the feature name (need not be NUL-terminated)
+ * @param   name_len    characters in @a name
+ * @return  Boolean true if the name is present
+ */
+static bool
+feature_set_contains(
+    const feature_set_t *set,
+    const char          *name,
+    size_t              name_len
+)
+{
+    size_t              slot = catalog_fnv1a(0xcbf29ce484222325ULL, name, name_len) & (set->n_slots - 1);
+    
+    while ( set->slots[slot].name ) {
+        if ( (set->slots[slot].name_len == name_len) && ! memcmp(set->slots[slot].name, name, name_len) ) return true;
+        slot = (slot + 1) & (set->n_slots - 1);
+    }
+    return false;
+}
+
+/**
+ * @brief   Count the items in a delimited list (an upper bound on tokens)
+ */
+static size_t
+feature_list_count(
+    const char          *list,
+    char                delim
+)
+{
+    size_t              count = 1;
+    
+    if ( list ) while ( *list ) if ( *list++ == delim ) count++;
+    return count;
+}
+
+/**
+ * @brief   Select our features from a job's feature request
+ * @details Translates an ampersand-separated job feature request into the
+ *          comma-separated list of the features this plugin owns; if none
+ *          are ours, a copy of the request is returned.  The output is
+ *          assembled in a buffer sized up front so the work is linear in
+ *          the length of the request.
+ * @param   job_features    ampersand-separated list of features
+ * @return  @a NULL if @a job_features is empty, otherwise a new string
+ *          (allocated with a Slurm xmalloc etc.)
+ */
+static HARNESS_UNUSED char*
+cpuinfo_job_features_xlate(
+    const char  *job_features
+)
+{
+    char        *out_features = NULL;
+    
+	if ( job_features && *job_features ) {
+        char    *copy = xstrdup(job_features),
+                *tokarg1 = copy, *tokptr, *save_ptr = NULL;
+        size_t  out_len = 0;
+        
+        out_features = xmalloc(strlen(job_features) + 1);
+        while ( (tokptr = strtok_r(tokarg1, "&", &save_ptr)) ) {
+            /* Reset tokarg1 to continue in the current string on subsequent iterations: */
+            tokarg1 = NULL;
+            
+            if ( cpuinfo_features_is_str_ours(tokptr, -1) ) {
+                size_t  tok_len = strlen(tokptr);
+                
+                if ( out_len ) out_features[out_len++] = ',';
+                memcpy(out_features + out_len, tokptr, tok_len);
+                out_len += tok_len;
+            }
+        }
+        if ( ! out_len ) {
+            xfree(out_features);
+            out_features = copy;
+        } else {
+            out_features[out_len] = '\0';
+            xfree(copy);
+        }
+    }
+	return out_features;
+}
+
+/**
+ * @brief   Replace our old features in a node's feature list with new ones
+ * @details Produces new_features U (orig_features - our_features), keeping
+ *          the first occurrence of each of the original features.  A
+ *          feature_set_t replaces a rescan of the output for every
+ *          feature, so the work is linear in the lengths of the lists.
+ *
+ *          Slurm passes @a avail_features when it translates a node's
+ *          active features.  A changeable (MODE::) feature is only active
+ *          if the node offers it, so new MODE:: features absent from
+ *          @a avail_features are dropped (e.g. a hugepage count left
+ *          behind by something other than a job is not advertised as an
+ *          active mode).
+ * @param   new_features    comma-separated list of new feature strings
+ * @param   orig_features   comma-separated list of existing feature strings
+ * @param   avail_features  comma-separated list of available feature
+ *                          strings, @a NULL when translating those
+ * @return  A new string (allocated with a Slurm xmalloc etc.)
+ */
+static HARNESS_UNUSED char*
+cpuinfo_node_features_xlate(
+    const char  *new_features,
+    const char  *orig_features,
+    const char  *avail_features
+)
+{
+    char        *out_features = NULL;
+    bool        is_active = ( avail_features != NULL );
+    
+    /* Short-circuit, no union necessary: */
+    if ( ! new_features || ! *new_features ) {
+        out_features = xstrdup(orig_features);
+    }
+    else if ( ! is_active && (! orig_features || ! *orig_features) ) {
+        out_features = xstrdup(new_features);
+    }
+    else {
+        char            *tokptr, *saveptr = NULL;
+        char            *new_copy, *orig_copy = NULL, *avail_copy = NULL, *tokarg1;
+        size_t          out_len = 0;
+        feature_set_t   present, offered;
+        
+        feature_set_init(&present, feature_list_count(new_features, ',') + feature_list_count(orig_features, ','));
+        if ( is_active ) feature_set_init(&offered, feature_list_count(avail_features, ','));
+        
+        /* Produce    new_features U (orig_features - our_features): */
+        out_features = xmalloc(strlen(new_features) + (orig_features ? strlen(orig_features) : 0) + 2);
+        
+        if ( is_active ) {
+            avail_copy = xstrdup(avail_features);
+            tokarg1 = avail_copy;
+            while ( (tokptr = strtok_r(tokarg1, ",", &saveptr)) ) {
+                tokarg1 = NULL;
+                feature_set_add(&offered, tokptr, strlen(tokptr));
+            }
+            saveptr = NULL;
+        }
+        
+        new_copy = xstrdup(new_features);
+        tokarg1 = new_copy;
+        while ( (tokptr = strtok_r(tokarg1, ",", &saveptr)) ) {
+            size_t      tok_len = strlen(tokptr);
+            
+            tokarg1 = NULL;
+            /* An active mode must be one the node offers: */
+            if ( is_active && str_startswith(tokptr, "MODE::", tok_len) && ! feature_set_contains(&offered, tokptr, tok_len) ) continue;
+            feature_set_add(&present, tokptr, tok_len);
+            if ( out_len ) out_features[out_len++] = ',';
+            memcpy(out_features + out_len, tokptr, tok_len);
+            out_len += tok_len;
+        }
+        
+        if ( orig_features ) {
+            orig_copy = xstrdup(orig_features);
+            tokarg1 = orig_copy;
+            saveptr = NULL;
+            while ( (tokptr = strtok_r(tokarg1, ",", &saveptr)) ) {
+                size_t      tok_len = strlen(tokptr);
+                
+                /* Reset tokarg1 to continue in the current string on subsequent iterations: */
+                tokarg1 = NULL;
+                
+                /* Only add those which don't belong to us and aren't already in the list: */
+                if ( ! cpuinfo_features_is_str_ours(tokptr, tok_len) && feature_set_add(&present, tokptr, tok_len) ) {
+                    if ( out_len ) out_features[out_len++] = ',';
+                    memcpy(out_features + out_len, tokptr, tok_len);
+                    out_len += tok_len;
+                }
+            }
+        }
+        out_features[out_len] = '\0';
+        feature_set_reset(&present);
+        if ( is_active ) feature_set_reset(&offered);
+        xfree(new_copy);
+        xfree(orig_copy);
+        xfree(avail_copy);
+    }
+    return out_features;
+}
+
+#endif
+
+#ifndef NODE_FEATURE_CPUINFO_TESTING
+
+/**
+ * @brief   Determine which subsystems a kernel uevent message concerns
+ * @details A kernel uevent is a header of the form "action@devpath"
+ *          followed by NUL-terminated KEY=VALUE pairs.  Only add, remove,
+ *          online and offline events for the cpu and pci subsystems are
+ *          of interest; messages re-broadcast by udev (which start with
+ *          "libudev") are ignored.
+ * @param   msg     the message
+ * @param   len     number of bytes in @a msg
+ * @return  A mask of node_uevent_subsystem_t values, zero if the message
+ *          is of no interest
+ */
+static unsigned int
+uevent_message_subsystems(
+    const char          *msg,
+    size_t              len
+)
+{
+    const char          *end = msg + len, *action = NULL, *subsystem = NULL;
+    
+    if ( ! len || ! memchr(msg, '@', strnlen(msg, len)) ) return 0;
+    while ( msg < end ) {
+        size_t          item_len = strnlen(msg, end - msg);
+        
+        if ( item_len == (size_t)(end - msg) ) break;   /* unterminated */
+        if ( str_startswith(msg, "ACTION=", item_len) ) action = msg + 7;
+        else if ( str_startswith(msg, "SUBSYSTEM=", item_len) ) subsystem = msg + 10;
+        msg += item_len + 1;
+    }
+    if ( ! action || ! subsystem ) return 0;
+    if ( strcmp(action, "add") && strcmp(action, "remove") && strcmp(action, "online") && strcmp(action, "offline") ) return 0;
+    if ( ! strcmp(subsystem, "cpu") ) return node_uevent_subsystem_cpu;
+    if ( ! strcmp(subsystem, "pci") ) return node_uevent_subsystem_pci;
+    return 0;
+}
+
+#endif
+
+
+/**
+ * @brief   Find the next feature name in a feature list or constraint
+ * @details Names are separated by the characters Slurm's constraint syntax
+ *          uses (&|,[]() and whitespace); a "*<count>" suffix is not part
+ *          of the name.
+ * @param   list        pointer to the current position in the list; updated
+ *                      to follow the name on return
+ * @param   name_len    pointer to the length of the name on return
+ * @return  @a NULL if no names remain, otherwise a pointer to the name
+ */
+static const char*
+feature_list_next(
+    const char  **list,
+    size_t      *name_len
+)
+{
+    const char  *p = *list, *name, *e;
+    
+    while ( *p && strchr("&|,[]() \t", *p) ) p++;
+    if ( ! *p ) {
+        *list = p;
+        return NULL;
+    }
+    name = p;
+    while ( *p && ! strchr("&|,[]() \t", *p) ) p++;
+    *list = p;
+    e = memchr(name, '*', p - name);
+    *name_len = ( e ? e : p ) - name;
+    return name;
+}
+
+/**
+ * @brief   Maximum length of a mode value
+ */
+#define NODE_MODE_VALUE_MAX     64
+
+/**
+ * @brief   Maximum number of registered modes
+ */
+#define NODE_MODE_MAX           16
+
+/**
+ * @brief   Opaque pointer to a node mode registration record
+ */
+typedef struct node_mode * node_mode_ref;
+
+/**
+ * @brief   Type of a callback function that lists a mode's available values
+ * @param   mode        the registration record for the mode
+ * @param   config      the plugin configuration
+ * @param   values      buffer to fill with space-separated values
+ * @param   values_len  capacity of @a values
+ * @return  Boolean false if the mode cannot be changed on this node
+ */
+typedef bool (*node_mode_values_cb)(node_mode_ref mode, cpuinfo_config_t *config, char *values, size_t values_len);
+
+/**
+ * @brief   Type of a callback function that reads a mode's current value
+ * @param   mode        the registration record for the mode
+ * @param   config      the plugin configuration
+ * @param   value       buffer to fill with the value
+ * @param   value_len   capacity of @a value
+ * @return  Boolean false if the value could not be read
+ */
+typedef bool (*node_mode_get_cb)(node_mode_ref mode, cpuinfo_config_t *config, char *value, size_t value_len);
+
+/**
+ * @brief   Type of a callback function that applies a mode value
+ * @param   mode        the registration record for the mode
+ * @param   config      the plugin configuration
+ * @param   value       the value to apply
+ * @return  Boolean false if the value could not be applied
+ */
+typedef bool (*node_mode_set_cb)(node_mode_ref mode, cpuinfo_config_t *config, const char *value);
+
+/**
+ * @brief   Registration data structure for a job-selectable node mode
+ * @details A mode is published as MODE::<name>::<value>; the node's
+ *          available values go to the available features and its current
+ *          value to the active features.
+ */
+typedef struct node_mode {
+    const char              *name;          /**< the <name> in MODE::<name>::<value> */
+    const char              *static_values; /**< space-separated values valid on any node, @a NULL if node-specific */
+    node_mode_values_cb     values_cb;      /**< lists the values available on this node */
+    node_mode_get_cb        get_cb;         /**< reads the current value */
+    node_mode_set_cb        set_cb;         /**< applies a value */
+    unsigned int            estimate_ms;    /**< expected transition time before one is measured */
+    unsigned int            uevent_subsystems;  /**< probes to refresh after a transition (node_uevent_subsystem_t mask) */
+    bool                    is_reboot;      /**< set_cb stages the value for the next boot */
+    bool                    is_withholding; /**< a value holds CPUs, memory or cache back from later jobs */
+} node_mode_t;
+
+/**
+ * @brief   Per-mode state kept between node_set calls
+ */
+typedef struct node_mode_state {
+    bool                is_modified;                    /**< a job's value is applied */
+    char                baseline[NODE_MODE_VALUE_MAX];  /**< the node's own value, restored afterwards */
+    unsigned int        transition_ms;                  /**< duration of the last transition (0 = none measured) */
+} node_mode_state_t;
+
+/**
+ * @brief   State of all modes on a node
+ */
+typedef struct node_modes {
+    node_mode_state_t   state[NODE_MODE_MAX];   /**< indexed like node_modes_registry */
+} node_modes_t;
+
+/**
+ * @var     sysfs_write_fixture
+ * @brief   Replacement for sysfs_write_str() installed by a test harness
+ * @details A file in a plain directory tree holds whatever was last written
+ *          to it; a fixture can make it read back the way the kernel's
+ *          would.  @a NULL (the default) writes the file as-is.
+ */
+static bool (*sysfs_write_fixture)(const char *path, const char *value) = NULL;
+
+/**
+ * @brief   Write a value to a (sysfs) file
+ * @param   path        the file to write
+ * @param   value       the value to write
+ * @return  Boolean true if the value was written
+ */
+static bool
+sysfs_write_str(
+    const char  *path,
+    const char  *value
+)
+{
+    int         fd;
+    size_t      value_len = strlen(value);
+    bool        is_okay;
+    
+    if ( sysfs_write_fixture ) return sysfs_write_fixture(path, value);
+    if ( (fd = open(path, O_WRONLY | O_TRUNC | O_CLOEXEC)) < 0 ) return false;
+    is_okay = ( write(fd, value, value_len) == (ssize_t)value_len );
+    if ( close(fd) != 0 ) is_okay = false;
+    return is_okay;
+}
+
+/**
+ * @brief   Is a word present in a space-separated list?
+ */
+static bool
+node_mode_value_is_listed(
+    const char  *values,
+    const char  *value,
+    size_t      value_len
+)
+{
+    while ( *values ) {
+        const char  *e;
+        
+        while ( *values == ' ' ) values++;
+        e = values;
+        while ( *e && (*e != ' ') ) e++;
+        if ( ((e - values) == value_len) && ! strncmp(values, value, value_len) ) return true;
+        values = e;
+    }
+    return false;
+}
+
+/**
+ * @brief   Locate the turbo control file
+ * @details intel_pstate exposes no_turbo (1 disables turbo); other cpufreq
+ *          drivers expose a global boost file (1 enables it).
+ * @param   path        buffer to fill with the path
+ * @param   path_len    capacity of @a path
+ * @param   is_inverted set to true if writing 1 disables turbo
+ * @return  Boolean false if the node has no turbo control
+ */
+static bool
+node_mode_turbo_path(
+    char        *path,
+    size_t      path_len,
+    bool        *is_inverted
+)
+{
+    if ( sysfs_path(path, path_len, "/sys/devices/system/cpu/intel_pstate/no_turbo") && (access(path, F_OK) == 0) ) {
+        *is_inverted = true;
+        return true;
+    }
+    if ( sysfs_path(path, path_len, "/sys/devices/system/cpu/cpufreq/boost") && (access(path, F_OK) == 0) ) {
+        *is_inverted = false;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief   node_mode_values_cb for the turbo mode
+ */
+static bool
+node_mode_turbo_values(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *values,
+    size_t              values_len
+)
+{
+    char            path[PATH_MAX];
+    bool            is_inverted;
+    
+    if ( ! node_mode_turbo_path(path, sizeof(path), &is_inverted) ) return false;
+    snprintf(values, values_len, "%s", mode->static_values);
+    return true;
+}
+
+/**
+ * @brief   node_mode_get_cb for the turbo mode
+ */
+static bool
+node_mode_turbo_get(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *value,
+    size_t              value_len
+)
+{
+    char                path[PATH_MAX];
+    bool                is_inverted;
+    unsigned long long  setting;
+    
+    if ( ! node_mode_turbo_path(path, sizeof(path), &is_inverted) || ! sysfs_read_u64(path, &setting) ) return false;
+    snprintf(value, value_len, "%s", ((setting != 0) != is_inverted) ? "on" : "off");
+    return true;
+}
+
+/**
+ * @brief   node_mode_set_cb for the turbo mode
+ */
+static bool
+node_mode_turbo_set(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    const char          *value
+)
+{
+    char            path[PATH_MAX];
+    bool            is_inverted, is_on = ( strcmp(value, "on") == 0 );
+    
+    if ( ! node_mode_turbo_path(path, sizeof(path), &is_inverted) ) return false;
+    return sysfs_write_str(path, (is_on != is_inverted) ? "1" : "0");
+}
+
+/**
+ * @brief   Find the per-policy (or, lacking those, per-CPU) governor files
+ * @param   files   the glob to fill-in; the caller must globfree() it when
+ *                  true is returned
+ * @return  Boolean false if no governor files exist
+ */
+static bool
+node_mode_gov_files(
+    glob_t      *files
+)
+{
+    char        pattern[PATH_MAX];
+    
+    if ( sysfs_path(pattern, sizeof(pattern), "/sys/devices/system/cpu/cpufreq/policy*/scaling_governor") && (glob(pattern, 0, NULL, files) == 0) ) return true;
+    if ( sysfs_path(pattern, sizeof(pattern), "/sys/devices/system/cpu/cpu[0-9]*/cpufreq/scaling_governor") && (glob(pattern, 0, NULL, files) == 0) ) return true;
+    return false;
+}
+
+/**
+ * @brief   node_mode_values_cb for the cpufreq governor mode
+ */
+static bool
+node_mode_gov_values(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *values,
+    size_t              values_len
+)
+{
+    glob_t          files;
+    char            path[PATH_MAX], *slash;
+    bool            is_okay = false;
+    
+    if ( ! node_mode_gov_files(&files) ) return false;
+    if ( snprintf(path, sizeof(path), "%s", files.gl_pathv[0]) < sizeof(path) && (slash = strrchr(path, '/')) ) {
+        *slash = '\0';
+        if ( strlen(path) + sizeof("/scaling_available_governors") <= sizeof(path) ) {
+            strcat(path, "/scaling_available_governors");
+            is_okay = sysfs_read_str(path, values, values_len);
+        }
+    }
+    globfree(&files);
+    return is_okay;
+}
+
+/**
+ * @brief   node_mode_get_cb for the cpufreq governor mode
+ */
+static bool
+node_mode_gov_get(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *value,
+    size_t              value_len
+)
+{
+    glob_t          files;
+    bool            is_okay;
+    
+    if ( ! node_mode_gov_files(&files) ) return false;
+    is_okay = sysfs_read_str(files.gl_pathv[0], value, value_len);
+    globfree(&files);
+    return is_okay;
+}
+
+/**
+ * @brief   node_mode_set_cb for the cpufreq governor mode
+ * @details The governor is written to every cpufreq policy.
+ */
+static bool
+node_mode_gov_set(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    const char          *value
+)
+{
+    glob_t          files;
+    size_t          i;
+    bool            is_okay = true;
+    
+    if ( ! node_mode_gov_files(&files) ) return false;
+    for ( i = 0; i < files.gl_pathc; i++ ) {
+        if ( ! sysfs_write_str(files.gl_pathv[i], value) ) is_okay = false;
+    }
+    globfree(&files);
+    return is_okay;
+}
+
+/**
+ * @brief   node_mode_values_cb for the SMT mode
+ * @details SMT can only be toggled when the control reads on or off (not
+ *          forceoff, notsupported or notimplemented).
+ */
+static bool
+node_mode_smt_values(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *values,
+    size_t              values_len
+)
+{
+    char            path[PATH_MAX], control[32];
+    
+    if ( ! sysfs_path(path, sizeof(path), "/sys/devices/system/cpu/smt/control") || ! sysfs_read_str(path, control, sizeof(control)) ) return false;
+    if ( strcmp(control, "on") && strcmp(control, "off") ) return false;
+    snprintf(values, values_len, "%s", mode->static_values);
+    return true;
+}
+
+/**
+ * @brief   node_mode_get_cb for the SMT mode
+ */
+static bool
+node_mode_smt_get(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *value,
+    size_t              value_len
+)
+{
+    char            path[PATH_MAX];
+    
+    return sysfs_path(path, sizeof(path), "/sys/devices/system/cpu/smt/control") && sysfs_read_str(path, value, value_len);
+}
+
+/**
+ * @brief   node_mode_set_cb for the SMT mode
+ * @details The kernel offlines or onlines every sibling thread before the
+ *          write returns.
+ */
+static bool
+node_mode_smt_set(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    const char          *value
+)
+{
+    char            path[PATH_MAX];
+    
+    return sysfs_path(path, sizeof(path), "/sys/devices/system/cpu/smt/control") && sysfs_write_str(path, value);
+}
+
+/**
+ * @brief   node_mode_values_cb for the transparent hugepage mode
+ * @details The kernel lists the choices with the current one bracketed,
+ *          e.g. "always [madvise] never".
+ */
+static bool
+node_mode_thp_values(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *values,
+    size_t              values_len
+)
+{
+    char            path[PATH_MAX], line[128], *s = line;
+    size_t          n = 0;
+    
+    if ( ! sysfs_path(path, sizeof(path), "/sys/kernel/mm/transparent_hugepage/enabled") || ! sysfs_read_str(path, line, sizeof(line)) ) return false;
+    while ( *s && (n + 1 < values_len) ) {
+        if ( (*s != '[') && (*s != ']') ) values[n++] = *s;
+        s++;
+    }
+    values[n] = '\0';
+    return ( n > 0 );
+}
+
+/**
+ * @brief   node_mode_get_cb for the transparent hugepage mode
+ * @details The current value is the bracketed one.
+ */
+static bool
+node_mode_thp_get(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *value,
+    size_t              value_len
+)
+{
+    char            path[PATH_MAX], line[128], *s, *e;
+    
+    if ( ! sysfs_path(path, sizeof(path), "/sys/kernel/mm/transparent_hugepage/enabled") || ! sysfs_read_str(path, line, sizeof(line)) ) return false;
+    if ( ! (s = strchr(line, '[')) || ! (e = strchr(++s, ']')) ) return false;
+    if ( (e - s) >= value_len ) return false;
+    memcpy(value, s, e - s);
+    value[e - s] = '\0';
+    return true;
+}
+
+/**
+ * @brief   node_mode_set_cb for the transparent hugepage mode
+ */
+static bool
+node_mode_thp_set(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    const char          *value
+)
+{
+    char            path[PATH_MAX];
+    
+    return sysfs_path(path, sizeof(path), "/sys/kernel/mm/transparent_hugepage/enabled") && sysfs_write_str(path, value);
+}
+
+/**
+ * @brief   Locate the per-NUMA-node 1 GiB hugepage counters
+ * @param   files   the glob to fill-in; the caller must globfree() it when
+ *                  true is returned
+ * @return  Boolean false if the node has no NUMA node directories
+ */
+static bool
+node_mode_huge1g_files(
+    glob_t      *files
+)
+{
+    char        pattern[PATH_MAX];
+    
+    return sysfs_path(pattern, sizeof(pattern), "/sys/devices/system/node/node[0-9]*/hugepages/hugepages-1048576kB/nr_hugepages") && (glob(pattern, 0, NULL, files) == 0);
+}
+
+/**
+ * @brief   node_mode_values_cb for the 1 GiB hugepage reservation mode
+ * @details The fixed reservation sizes are offered up to half of the
+ *          node's memory (summed over its NUMA nodes).
+ */
+static bool
+node_mode_huge1g_values(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *values,
+    size_t              values_len
+)
+{
+    char                path[PATH_MAX];
+    glob_t              files;
+    unsigned long long  mem_kb = 0;
+    const char          *v = mode->static_values;
+    size_t              n = 0;
+    
+    if ( ! sysfs_path(path, sizeof(path), "/sys/kernel/mm/hugepages/hugepages-1048576kB") || (access(path, F_OK) != 0) ) return false;
+    if ( sysfs_path(path, sizeof(path), "/sys/devices/system/node/node[0-9]*/meminfo") && (glob(path, 0, NULL, &files) == 0) ) {
+        size_t          i;
+        
+        for ( i = 0; i < files.gl_pathc; i++ ) {
+            char        line[256];
+            FILE        *fptr = fopen(files.gl_pathv[i], "r");
+            
+            if ( ! fptr ) continue;
+            while ( fgets(line, sizeof(line), fptr) ) {
+                const char  *p = strstr(line, "MemTotal:");
+                
+                if ( p ) {
+                    mem_kb += strtoull(p + 9, NULL, 10);
+                    break;
+                }
+            }
+            fclose(fptr);
+        }
+        globfree(&files);
+    }
+    if ( ! mem_kb ) mem_kb = (unsigned long long)sysconf(_SC_PHYS_PAGES) * (sysconf(_SC_PAGESIZE) / 1024);
+    while ( *v ) {
+        char                *e;
+        unsigned long long  pages = strtoull(v, &e, 10);
+        
+        if ( e == v ) break;
+        if ( pages * 1048576ULL <= mem_kb / 2 ) {
+            int             l = snprintf(values + n, values_len - n, "%s%llu", n ? " " : "", pages);
+            
+            if ( (l < 0) || (l >= values_len - n) ) break;
+            n += l;
+        }
+        v = e;
+        while ( *v == ' ' ) v++;
+    }
+    return ( n > 0 );
+}
+
+/**
+ * @brief   node_mode_get_cb for the 1 GiB hugepage reservation mode
+ * @details The value is the number of pages reserved across all NUMA nodes.
+ */
+static bool
+node_mode_huge1g_get(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *value,
+    size_t              value_len
+)
+{
+    char                path[PATH_MAX];
+    glob_t              files;
+    unsigned long long  pages = 0, count;
+    
+    if ( node_mode_huge1g_files(&files) ) {
+        size_t          i;
+        
+        for ( i = 0; i < files.gl_pathc; i++ ) if ( sysfs_read_u64(files.gl_pathv[i], &count) ) pages += count;
+        globfree(&files);
+    }
+    else if ( ! sysfs_path(path, sizeof(path), "/sys/kernel/mm/hugepages/hugepages-1048576kB/nr_hugepages") || ! sysfs_read_u64(path, &pages) ) {
+        return false;
+    }
+    return ( snprintf(value, value_len, "%llu", pages) < value_len );
+}
+
+/**
+ * @brief   Maximum number of NUMA nodes whose 1 GiB hugepage counts are
+ *          saved
+ */
+#define HUGE1G_MAX_NODES            64
+
+/**
+ * @brief   The node's own per-NUMA-node 1 GiB hugepage counts
+ * @details Saved when a job first changes the reservation, so the node's
+ *          layout (not just its total) is restored afterwards.  Indexed
+ *          like node_mode_huge1g_files().
+ */
+static struct {
+    bool                is_saved;                   /**< the counts are held */
+    size_t              n_nodes;                    /**< NUMA nodes counted */
+    unsigned long long  total;                      /**< sum of @a count */
+    unsigned long long  count[HUGE1G_MAX_NODES];    /**< pages per NUMA node */
+} node_mode_huge1g_saved;
+
+/**
+ * @brief   node_mode_set_cb for the 1 GiB hugepage reservation mode
+ * @details Memory is compacted first.  The per-NUMA-node counts are saved
+ *          the first time, and a total equal to the saved one gets them
+ *          back; any other total is spread evenly over the NUMA nodes.
+ *          The kernel reserves what it can, so the counts are read back
+ *          and a shortfall is reported as a failure (the partial
+ *          reservation stays until the baseline is restored).
+ */
+static bool
+node_mode_huge1g_set(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    const char          *value
+)
+{
+    char                path[PATH_MAX], *e, reserved[NODE_MODE_VALUE_MAX];
+    unsigned long long  pages = strtoull(value, &e, 10), got;
+    glob_t              files;
+    bool                is_okay = true;
+    
+    if ( (e == value) || *e ) return false;
+    if ( pages && sysfs_path(path, sizeof(path), "/proc/sys/vm/compact_memory") ) sysfs_write_str(path, "1");
+    if ( node_mode_huge1g_files(&files) ) {
+        bool            is_restore;
+        size_t          i;
+        
+        if ( ! node_mode_huge1g_saved.is_saved && (files.gl_pathc <= HUGE1G_MAX_NODES) ) {
+            node_mode_huge1g_saved.is_saved = true;
+            node_mode_huge1g_saved.n_nodes = files.gl_pathc;
+            node_mode_huge1g_saved.total = 0;
+            for ( i = 0; i < files.gl_pathc; i++ ) {
+                if ( ! sysfs_read_u64(files.gl_pathv[i], &node_mode_huge1g_saved.count[i]) ) node_mode_huge1g_saved.count[i] = 0;
+                node_mode_huge1g_saved.total += node_mode_huge1g_saved.count[i];
+            }
+        }
+        is_restore = node_mode_huge1g_saved.is_saved && (node_mode_huge1g_saved.n_nodes == files.gl_pathc) && (node_mode_huge1g_saved.total == pages);
+        for ( i = 0; i < files.gl_pathc; i++ ) {
+            char        count[32];
+            
+            snprintf(count, sizeof(count), "%llu", is_restore ? node_mode_huge1g_saved.count[i] : pages / files.gl_pathc + (i < pages % files.gl_pathc));
+            if ( ! sysfs_write_str(files.gl_pathv[i], count) ) is_okay = false;
+        }
+        if ( is_restore && is_okay ) node_mode_huge1g_saved.is_saved = false;
+        globfree(&files);
+    }
+    else if ( ! sysfs_path(path, sizeof(path), "/sys/kernel/mm/hugepages/hugepages-1048576kB/nr_hugepages") || ! sysfs_write_str(path, value) ) {
+        is_okay = false;
+    }
+    if ( is_okay && node_mode_huge1g_get(mode, config, reserved, sizeof(reserved)) && ((got = strtoull(reserved, NULL, 10)) < pages) ) {
+        error("reserved %llu of %llu 1 GiB hugepages", got, pages);
+        is_okay = false;
+    }
+    return is_okay;
+}
+
+/**
+ * @brief   Access to the processors' model-specific registers
+ * @details The prefetch mode goes through msr_backend, which a test
+ *          harness may point at its own implementation so the mode can be
+ *          exercised without root or real MSRs.
+ */
+typedef struct msr_backend {
+    bool    (*cpus)(cpu_mask_t *cpus);                              /**< the CPUs whose MSRs are accessible */
+    bool    (*read)(unsigned int cpu, uint32_t reg, uint64_t *value);   /**< read one MSR */
+    bool    (*write)(unsigned int cpu, uint32_t reg, uint64_t value);   /**< write one MSR */
+} msr_backend_t;
+
+/**
+ * @brief   msr_backend_t cpus callback for the msr driver
+ * @details Every CPU with a /dev/cpu/<n>/msr device (below the sysfs root).
+ */
+static bool
+msr_dev_cpus(
+    cpu_mask_t      *cpus
+)
+{
+    char            pattern[PATH_MAX];
+    glob_t          files;
+    size_t          i;
+    bool            is_okay = false;
+    
+    memset(cpus, 0, sizeof(*cpus));
+    if ( ! sysfs_path(pattern, sizeof(pattern), "/dev/cpu/[0-9]*/msr") || (glob(pattern, 0, NULL, &files) != 0) ) return false;
+    for ( i = 0; i < files.gl_pathc; i++ ) {
+        const char  *p = files.gl_pathv[i] + strlen(files.gl_pathv[i]) - 4;
+        
+        /* Back up from "/msr" to the CPU number: */
+        while ( (p > files.gl_pathv[i]) && isdigit((unsigned char)p[-1]) ) p--;
+        if ( isdigit((unsigned char)*p) ) {
+            unsigned long   cpu = strtoul(p, NULL, 10);
+            
+            if ( cpu < CPU_MASK_MAX_CPUS ) {
+                cpus->bits[cpu / 64] |= 1ULL << (cpu % 64);
+                is_okay = true;
+            }
+        }
+    }
+    globfree(&files);
+    return is_okay;
+}
+
+/**
+ * @brief   msr_backend_t read callback for the msr driver
+ */
+static bool
+msr_dev_read(
+    unsigned int    cpu,
+    uint32_t        reg,
+    uint64_t        *value
+)
+{
+    char            path[PATH_MAX];
+    int             fd;
+    bool            is_okay;
+    
+    if ( ! sysfs_path(path, sizeof(path), "/dev/cpu/%u/msr", cpu) || ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) ) return false;
+    is_okay = ( pread(fd, value, sizeof(*value), reg) == sizeof(*value) );
+    close(fd);
+    return is_okay;
+}
+
+/**
+ * @brief   msr_backend_t write callback for the msr driver
+ */
+static bool
+msr_dev_write(
+    unsigned int    cpu,
+    uint32_t        reg,
+    uint64_t        value
+)
+{
+    char            path[PATH_MAX];
+    int             fd;
+    bool            is_okay;
+    
+    if ( ! sysfs_path(path, sizeof(path), "/dev/cpu/%u/msr", cpu) || ((fd = open(path, O_WRONLY | O_CLOEXEC)) < 0) ) return false;
+    is_okay = ( pwrite(fd, &value, sizeof(value), reg) == sizeof(value) );
+    if ( close(fd) != 0 ) is_okay = false;
+    return is_okay;
+}
+
+/**
+ * @var     msr_backend
+ * @brief   The MSR implementation in use (the msr driver by default)
+ */
+static const msr_backend_t msr_backend_dev = { msr_dev_cpus, msr_dev_read, msr_dev_write };
+static const msr_backend_t *msr_backend = &msr_backend_dev;
+
+/**
+ * @brief   Where a microarchitecture keeps its prefetcher controls
+ * @details On all of these a set bit disables a prefetcher.
+ */
+typedef struct prefetch_layout {
+    const char      *vendor_id;     /**< cpuinfo vendor_id */
+    unsigned int    cpu_family;     /**< CPUID family */
+    unsigned int    model_lo;       /**< first CPUID model covered */
+    unsigned int    model_hi;       /**< last CPUID model covered */
+    uint32_t        msr;            /**< the prefetch control MSR */
+    uint64_t        mask;           /**< its prefetcher-disable bits */
+} prefetch_layout_t;
+
+/**
+ * @var     prefetch_layouts
+ * @brief   Prefetch control MSRs by microarchitecture
+ * @details Intel big cores use MSR_MISC_FEATURE_CONTROL (0x1a4):  L2
+ *          stream, L2 adjacent-line, L1 DCU and L1 DCU-IP prefetchers.
+ *          Xeon Phi has only the two L2 bits.  Hybrid parts are absent
+ *          (their E-cores lay the register out differently).  AMD Zen 4
+ *          and Zen 5 use PrefetchControl (0xc0000108):  L1 stream, L1
+ *          stride, L1 region, L2 stream and L2 up/down.
+ */
+static const prefetch_layout_t prefetch_layouts[] = {
+        { "GenuineIntel", 6, 0x1a, 0x1a, 0x1a4, 0xf },     /* Nehalem-EP */
+        { "GenuineIntel", 6, 0x1e, 0x1f, 0x1a4, 0xf },     /* Nehalem */
+        { "GenuineIntel", 6, 0x25, 0x25, 0x1a4, 0xf },     /* Westmere */
+        { "GenuineIntel", 6, 0x2a, 0x2a, 0x1a4, 0xf },     /* Sandy Bridge */
+        { "GenuineIntel", 6, 0x2c, 0x2f, 0x1a4, 0xf },     /* Westmere-EP, Sandy Bridge-EP, Nehalem/Westmere-EX */
+        { "GenuineIntel", 6, 0x3a, 0x3a, 0x1a4, 0xf },     /* Ivy Bridge */
+        { "GenuineIntel", 6, 0x3c, 0x3f, 0x1a4, 0xf },     /* Haswell, Broadwell, Ivy Bridge-EP, Haswell-EP */
+        { "GenuineIntel", 6, 0x45, 0x47, 0x1a4, 0xf },     /* Haswell, Broadwell */
+        { "GenuineIntel", 6, 0x4e, 0x4f, 0x1a4, 0xf },     /* Skylake, Broadwell-EP */
+        { "GenuineIntel", 6, 0x55, 0x56, 0x1a4, 0xf },     /* Skylake/Cascade Lake/Cooper Lake-SP, Broadwell-DE */
+        { "GenuineIntel", 6, 0x5e, 0x5e, 0x1a4, 0xf },     /* Skylake */
+        { "GenuineIntel", 6, 0x6a, 0x6a, 0x1a4, 0xf },     /* Ice Lake-SP */
+        { "GenuineIntel", 6, 0x6c, 0x6c, 0x1a4, 0xf },     /* Ice Lake-D */
+        { "GenuineIntel", 6, 0x7d, 0x7e, 0x1a4, 0xf },     /* Ice Lake */
+        { "GenuineIntel", 6, 0x8c, 0x8f, 0x1a4, 0xf },     /* Tiger Lake, Kaby/Coffee Lake, Sapphire Rapids */
+        { "GenuineIntel", 6, 0x9e, 0x9e, 0x1a4, 0xf },     /* Kaby/Coffee Lake */
+        { "GenuineIntel", 6, 0xa5, 0xa6, 0x1a4, 0xf },     /* Comet Lake */
+        { "GenuineIntel", 6, 0xad, 0xae, 0x1a4, 0xf },     /* Granite Rapids */
+        { "GenuineIntel", 6, 0xcf, 0xcf, 0x1a4, 0xf },     /* Emerald Rapids */
+        { "GenuineIntel", 6, 0x57, 0x57, 0x1a4, 0x3 },     /* Knights Landing */
+        { "GenuineIntel", 6, 0x85, 0x85, 0x1a4, 0x3 },     /* Knights Mill */
+        { "AuthenticAMD", 0x19, 0x10, 0x1f, 0xc0000108, 0x2f },    /* Zen 4 (Genoa) */
+        { "AuthenticAMD", 0x19, 0x60, 0x7f, 0xc0000108, 0x2f },    /* Zen 4 (Raphael, Phoenix) */
+        { "AuthenticAMD", 0x19, 0xa0, 0xaf, 0xc0000108, 0x2f },    /* Zen 4 (Bergamo, Siena) */
+        { "AuthenticAMD", 0x1a, 0x00, 0xff, 0xc0000108, 0x2f },    /* Zen 5 */
+        { NULL, 0, 0, 0, 0, 0 }
+    };
+
+/**
+ * @brief   Find the prefetch control layout for this node's processors
+ * @return  @a NULL if the microarchitecture is not in prefetch_layouts
+ */
+static const prefetch_layout_t*
+prefetch_layout_lookup(void)
+{
+    cpuinfo_features_t          cif;
+    const prefetch_layout_t     *layout = NULL;
+    
+    cpuinfo_features_init(&cif);
+    if ( node_cpuinfo_parse(&cif) && cif.vendor_id ) {
+        for ( layout = prefetch_layouts; layout->vendor_id; layout++ ) {
+            if ( ! strcmp(layout->vendor_id, cif.vendor_id) && (layout->cpu_family == cif.cpu_family)
+                        && (cif.cpu_model >= layout->model_lo) && (cif.cpu_model <= layout->model_hi) ) break;
+        }
+        if ( ! layout->vendor_id ) layout = NULL;
+    }
+    cpuinfo_features_reset(&cif);
+    return layout;
+}
+
+/**
+ * @brief   Maximum number of threads writing prefetch MSRs at once
+ */
+#define PREFETCH_MSR_MAX_THREADS    16
+
+/**
+ * @brief   One thread's share of a prefetch MSR update
+ */
+typedef struct prefetch_msr_job {
+    pthread_t                   thread;     /**< the thread */
+    const prefetch_layout_t     *layout;    /**< the register layout */
+    const unsigned int          *cpus;      /**< all CPUs to update */
+    size_t                      n_cpus;     /**< number of CPUs */
+    size_t                      first;      /**< index of this thread's first CPU */
+    size_t                      step;       /**< stride between this thread's CPUs */
+    uint64_t                    bits;       /**< disable bits to leave set (within layout->mask) */
+    unsigned int                n_failed;   /**< CPUs that could not be updated */
+} prefetch_msr_job_t;
+
+/**
+ * @brief   Thread body:  read-modify-write the prefetch MSR on a share of CPUs
+ */
+static void*
+prefetch_msr_thread(
+    void                    *arg
+)
+{
+    prefetch_msr_job_t      *job = (prefetch_msr_job_t*)arg;
+    size_t                  i;
+    
+    for ( i = job->first; i < job->n_cpus; i += job->step ) {
+        uint64_t            value, new_value;
+        
+        if ( ! msr_backend->read(job->cpus[i], job->layout->msr, &value) ) {
+            job->n_failed++;
+            continue;
+        }
+        new_value = (value & ~job->layout->mask) | job->bits;
+        if ( (new_value != value) && ! msr_backend->write(job->cpus[i], job->layout->msr, new_value) ) job->n_failed++;
+    }
+    return NULL;
+}
+
+/**
+ * @brief   Collect the CPUs whose MSRs the backend can reach
+ * @param   cpus        array of CPU_MASK_MAX_CPUS to fill-in
+ * @return  The number of CPUs
+ */
+static size_t
+prefetch_msr_cpus(
+    unsigned int    *cpus
+)
+{
+    cpu_mask_t      mask;
+    size_t          n = 0;
+    unsigned int    cpu;
+    
+    if ( ! msr_backend->cpus(&mask) ) return 0;
+    for ( cpu = 0; cpu < CPU_MASK_MAX_CPUS; cpu++ ) if ( mask.bits[cpu / 64] & (1ULL << (cpu % 64)) ) cpus[n++] = cpu;
+    return n;
+}
+
+/**
+ * @brief   node_mode_values_cb for the prefetch mode
+ * @details Offered when the microarchitecture is known and the first CPU's
+ *          prefetch MSR can be read.
+ */
+static bool
+node_mode_prefetch_values(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *values,
+    size_t              values_len
+)
+{
+    char            value[NODE_MODE_VALUE_MAX];
+    
+    if ( ! mode->get_cb(mode, config, value, sizeof(value)) ) return false;
+    snprintf(values, values_len, "%s", mode->static_values);
+    return true;
+}
+
+/**
+ * @brief   node_mode_get_cb for the prefetch mode
+ * @details The first CPU's register stands for the node:  "on" when no
+ *          prefetcher is disabled, "off" when all are, otherwise the
+ *          disable bits in hex (so a site's own setting is restored
+ *          exactly).
+ */
+static bool
+node_mode_prefetch_get(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *value,
+    size_t              value_len
+)
+{
+    const prefetch_layout_t *layout = prefetch_layout_lookup();
+    cpu_mask_t              mask;
+    unsigned int            cpu;
+    uint64_t                msr;
+    
+    if ( ! layout || ! msr_backend->cpus(&mask) ) return false;
+    for ( cpu = 0; cpu < CPU_MASK_MAX_CPUS; cpu++ ) if ( mask.bits[cpu / 64] & (1ULL << (cpu % 64)) ) break;
+    if ( (cpu == CPU_MASK_MAX_CPUS) || ! msr_backend->read(cpu, layout->msr, &msr) ) return false;
+    msr &= layout->mask;
+    if ( msr == 0 ) snprintf(value, value_len, "on");
+    else if ( msr == layout->mask ) snprintf(value, value_len, "off");
+    else snprintf(value, value_len, "0x%llx", (unsigned long long)msr);
+    return true;
+}
+
+/**
+ * @brief   node_mode_set_cb for the prefetch mode
+ * @details The MSR is rewritten on every CPU, the CPUs being shared out
+ *          among up to PREFETCH_MSR_MAX_THREADS threads.  Besides "on" and
+ *          "off" a hex value from node_mode_prefetch_get() is accepted.
+ */
+static bool
+node_mode_prefetch_set(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    const char          *value
+)
+{
+    const prefetch_layout_t *layout = prefetch_layout_lookup();
+    prefetch_msr_job_t      jobs[PREFETCH_MSR_MAX_THREADS];
+    unsigned int            *cpus;
+    size_t                  n_cpus, n_threads, started = 0, i;
+    uint64_t                bits;
+    unsigned int            n_failed = 0;
+    
+    if ( ! layout ) return false;
+    if ( ! strcmp(value, "on") ) bits = 0;
+    else if ( ! strcmp(value, "off") ) bits = layout->mask;
+    else {
+        char                *e;
+        
+        bits = strtoull(value, &e, 16);
+        if ( (e == value) || *e || (bits & ~layout->mask) ) return false;
+    }
+    if ( ! (cpus = (unsigned int*)malloc(CPU_MASK_MAX_CPUS * sizeof(unsigned int))) ) return false;
+    if ( (n_cpus = prefetch_msr_cpus(cpus)) == 0 ) {
+        free((void*)cpus);
+        return false;
+    }
+    n_threads = (n_cpus < PREFETCH_MSR_MAX_THREADS) ? n_cpus : PREFETCH_MSR_MAX_THREADS;
+    for ( i = 0; i < n_threads; i++ ) {
+        jobs[i] = (prefetch_msr_job_t){ .layout = layout, .cpus = cpus, .n_cpus = n_cpus, .first = i, .step = n_threads, .bits = bits };
+    }
+    for ( i = 0; i < n_threads; i++ ) {
+        if ( pthread_create(&jobs[i].thread, NULL, prefetch_msr_thread, &jobs[i]) != 0 ) break;
+        started++;
+    }
+    /* Any share that could not get a thread is done here: */
+    for ( i = started; i < n_threads; i++ ) prefetch_msr_thread(&jobs[i]);
+    for ( i = 0; i < n_threads; i++ ) {
+        if ( i < started ) pthread_join(jobs[i].thread, NULL);
+        n_failed += jobs[i].n_failed;
+    }
+    free((void*)cpus);
+    if ( n_failed ) error("unable to update the prefetch MSR on %u of %zu CPUs", n_failed, n_cpus);
+    return ( n_failed == 0 );
+}
+
+/**
+ * @brief   Name of the resctrl group MODE::LLC::exclusive creates
+ */
+#define LLC_RESCTRL_GROUP           "slurm_llc"
+
+/**
+ * @brief   Maximum number of L3 cache domains handled
+ */
+#define LLC_RESCTRL_MAX_DOMAINS     64
+
+/**
+ * @brief   What resctrl's info/ directory and schemata say about the L3
+ */
+typedef struct llc_resctrl_info {
+    unsigned long long  cbm_mask;                           /**< every way the cache has */
+    unsigned int        n_ways;                             /**< bits set in @a cbm_mask */
+    unsigned int        min_cbm_bits;                       /**< smallest allocation allowed */
+    unsigned int        n_domains;                          /**< number of L3 domains */
+    unsigned int        domain[LLC_RESCTRL_MAX_DOMAINS];    /**< their ids */
+    bool                has_mba;                            /**< memory bandwidth allocation is available */
+    unsigned int        mba_min;                            /**< smallest MBA percentage */
+    unsigned int        mba_gran;                           /**< MBA percentage granularity */
+} llc_resctrl_info_t;
+
+/**
+ * @brief   Read the L3 (and MBA) capabilities of a mounted resctrl
+ * @details The way mask and minimum come from info/L3; the domain ids from
+ *          the L3 line of the default group's schemata.
+ * @param   info        the structure to fill-in
+ * @return  Boolean false if resctrl is not mounted or has no L3 allocation
+ */
+static bool
+llc_resctrl_info_read(
+    llc_resctrl_info_t  *info
+)
+{
+    char                path[PATH_MAX], mask[32], *schemata, *p;
+    unsigned long long  value;
+    size_t              length;
+    
+    memset(info, 0, sizeof(*info));
+    if ( ! sysfs_path(path, sizeof(path), "/sys/fs/resctrl/info/L3/cbm_mask") || ! sysfs_read_str(path, mask, sizeof(mask)) ) return false;
+    if ( ! (info->cbm_mask = strtoull(mask, NULL, 16)) ) return false;
+    info->n_ways = __builtin_popcountll(info->cbm_mask);
+    info->min_cbm_bits = 1;
+    if ( sysfs_path(path, sizeof(path), "/sys/fs/resctrl/info/L3/min_cbm_bits") && sysfs_read_u64(path, &value) ) info->min_cbm_bits = value;
+    if ( sysfs_path(path, sizeof(path), "/sys/fs/resctrl/info/MB/min_bandwidth") && sysfs_read_u64(path, &value) ) {
+        info->has_mba = true;
+        info->mba_min = value;
+        info->mba_gran = 10;
+        if ( sysfs_path(path, sizeof(path), "/sys/fs/resctrl/info/MB/bandwidth_gran") && sysfs_read_u64(path, &value) && value ) info->mba_gran = value;
+    }
+    if ( ! sysfs_path(path, sizeof(path), "/sys/fs/resctrl/schemata") || ! (schemata = proc_read_file(path, &length)) ) return false;
+    if ( (p = strstr(schemata, "L3:")) ) {
+        p += 3;
+        while ( (info->n_domains < LLC_RESCTRL_MAX_DOMAINS) && isdigit((unsigned char)*p) ) {
+            info->domain[info->n_domains++] = strtoul(p, &p, 10);
+            /* Skip "=<mask>" to the next domain on the same line: */
+            p += strcspn(p, ";\n");
+            if ( *p++ != ';' ) break;
+        }
+    }
+    free((void*)schemata);
+    return ( info->n_domains > 0 );
+}
+
+/**
+ * @brief   Write a schemata to a resctrl group
+ * @details Each domain gets the same L3 mask and, when MBA is available,
+ *          the same bandwidth percentage.
+ * @param   info        the resctrl capabilities
+ * @param   group       the group's directory below /sys/fs/resctrl ("" for
+ *                      the default group)
+ * @param   l3_mask     the L3 way mask
+ * @param   mba_percent the bandwidth percentage
+ * @return  Boolean false if the schemata could not be written
+ */
+static bool
+llc_resctrl_schemata_write(
+    const llc_resctrl_info_t    *info,
+    const char                  *group,
+    unsigned long long          l3_mask,
+    unsigned int                mba_percent
+)
+{
+    char                        path[PATH_MAX], schemata[4096];
+    size_t                      n = 0, i;
+    
+    n += snprintf(schemata + n, sizeof(schemata) - n, "L3:");
+    for ( i = 0; i < info->n_domains; i++ ) n += snprintf(schemata + n, sizeof(schemata) - n, "%s%u=%llx", i ? ";" : "", info->domain[i], l3_mask);
+    if ( info->has_mba ) {
+        n += snprintf(schemata + n, sizeof(schemata) - n, "\nMB:");
+        for ( i = 0; i < info->n_domains; i++ ) n += snprintf(schemata + n, sizeof(schemata) - n, "%s%u=%u", i ? ";" : "", info->domain[i], mba_percent);
+    }
+    snprintf(schemata + n, sizeof(schemata) - n, "\n");
+    return sysfs_path(path, sizeof(path), "/sys/fs/resctrl/%s%sschemata", group, *group ? "/" : "") && sysfs_write_str(path, schemata);
+}
+
+/**
+ * @brief   Creation and removal of a resctrl group directory
+ * @details The kernel populates a group's files on mkdir() and discards
+ *          them on rmdir().  The LLC mode goes through llc_resctrl_backend,
+ *          which a test harness may point at an implementation that does
+ *          the same in a plain directory tree.
+ */
+typedef struct llc_resctrl_backend {
+    bool    (*group_create)(const char *path);  /**< create the group (success if it exists) */
+    bool    (*group_remove)(const char *path);  /**< remove the group (success if it is absent) */
+} llc_resctrl_backend_t;
+
+/**
+ * @brief   llc_resctrl_backend_t group_create callback for resctrl
+ */
+static bool
+llc_resctrl_dev_group_create(
+    const char      *path
+)
+{
+    return ( (mkdir(path, 0755) == 0) || (errno == EEXIST) );
+}
+
+/**
+ * @brief   llc_resctrl_backend_t group_remove callback for resctrl
+ * @details The kernel returns a removed group's tasks to the default group.
+ */
+static bool
+llc_resctrl_dev_group_remove(
+    const char      *path
+)
+{
+    return ( (rmdir(path) == 0) || (errno == ENOENT) );
+}
+
+/**
+ * @var     llc_resctrl_backend
+ * @brief   The resctrl group implementation in use (the kernel's by default)
+ */
+static const llc_resctrl_backend_t llc_resctrl_backend_dev = { llc_resctrl_dev_group_create, llc_resctrl_dev_group_remove };
+static const llc_resctrl_backend_t *llc_resctrl_backend = &llc_resctrl_backend_dev;
+
+/**
+ * @brief   The default group's schemata from before MODE::LLC::exclusive
+ * @details Empty when the mode has not been applied (or slurmd restarted
+ *          since), in which case "shared" gives back the whole cache and
+ *          bandwidth.
+ */
+static char llc_resctrl_default_schemata[4096];
+
+/**
+ * @brief   Remove the job's resctrl group
+ */
+static bool
+llc_resctrl_group_remove(void)
+{
+    char                path[PATH_MAX];
+    
+    return sysfs_path(path, sizeof(path), "/sys/fs/resctrl/" LLC_RESCTRL_GROUP) && llc_resctrl_backend->group_remove(path);
+}
+
+/**
+ * @brief   Give the default group back its schemata from before
+ *          MODE::LLC::exclusive
+ */
+static bool
+llc_resctrl_default_restore(
+    const llc_resctrl_info_t    *info
+)
+{
+    char                        path[PATH_MAX];
+    
+    if ( ! *llc_resctrl_default_schemata ) return llc_resctrl_schemata_write(info, "", info->cbm_mask, 100);
+    if ( ! sysfs_path(path, sizeof(path), "/sys/fs/resctrl/schemata") || ! sysfs_write_str(path, llc_resctrl_default_schemata) ) return false;
+    *llc_resctrl_default_schemata = '\0';
+    return true;
+}
+
+/**
+ * @brief   node_mode_values_cb for the LLC mode
+ * @details Offered when resctrl is mounted with L3 allocation and the
+ *          cache has enough ways to split in two.
+ */
+static bool
+node_mode_llc_values(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *values,
+    size_t              values_len
+)
+{
+    llc_resctrl_info_t  info;
+    
+    if ( ! llc_resctrl_info_read(&info) || (info.n_ways < 2 * info.min_cbm_bits) ) return false;
+    snprintf(values, values_len, "%s", mode->static_values);
+    return true;
+}
+
+/**
+ * @brief   node_mode_get_cb for the LLC mode
+ */
+static bool
+node_mode_llc_get(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *value,
+    size_t              value_len
+)
+{
+    char                path[PATH_MAX];
+    struct stat         finfo;
+    
+    if ( ! sysfs_path(path, sizeof(path), "/sys/fs/resctrl/" LLC_RESCTRL_GROUP) ) return false;
+    snprintf(value, value_len, "%s", ((stat(path, &finfo) == 0) && S_ISDIR(finfo.st_mode)) ? "exclusive" : "shared");
+    return true;
+}
+
+/**
+ * @brief   node_mode_set_cb for the LLC mode
+ * @details "exclusive" creates the LLC_RESCTRL_GROUP group holding the
+ *          top LlcWays ways of every L3 (half when unset) at full memory
+ *          bandwidth, and confines the default group -- everyone else --
+ *          to the remaining ways throttled to LlcMbaPercent.  The job's
+ *          tasks join the group in node_features_p_step_config().
+ *          The default group's schemata is saved first, and "shared"
+ *          writes it back and removes the group.
+ */
+static bool
+node_mode_llc_set(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    const char          *value
+)
+{
+    llc_resctrl_info_t  info;
+    char                path[PATH_MAX], current[NODE_MODE_VALUE_MAX];
+    unsigned int        ways, mba, shift;
+    unsigned long long  job_mask;
+    
+    if ( ! llc_resctrl_info_read(&info) ) return false;
+    if ( ! strcmp(value, "shared") ) return llc_resctrl_default_restore(&info) && llc_resctrl_group_remove();
+    if ( strcmp(value, "exclusive") ) return false;
+    
+    ways = config->llc_ways ? config->llc_ways : info.n_ways / 2;
+    if ( ways < info.min_cbm_bits ) ways = info.min_cbm_bits;
+    if ( ways > info.n_ways - info.min_cbm_bits ) ways = info.n_ways - info.min_cbm_bits;
+    shift = __builtin_ctzll(info.cbm_mask);
+    job_mask = ((1ULL << ways) - 1) << (shift + info.n_ways - ways);
+    
+    mba = config->llc_mba_percent;
+    if ( mba > 100 ) mba = 100;
+    if ( mba < info.mba_min ) mba = info.mba_min;
+    if ( info.mba_gran ) mba = (mba + info.mba_gran - 1) / info.mba_gran * info.mba_gran;
+    
+    /* Only the first of successive exclusive jobs sees the site's schemata: */
+    if ( ! sysfs_path(path, sizeof(path), "/sys/fs/resctrl/" LLC_RESCTRL_GROUP) || ! node_mode_llc_get(mode, config, current, sizeof(current)) ) return false;
+    if ( ! strcmp(current, "shared") ) {
+        char            schemata_path[PATH_MAX], *schemata;
+        size_t          length;
+        
+        if ( ! sysfs_path(schemata_path, sizeof(schemata_path), "/sys/fs/resctrl/schemata") || ! (schemata = proc_read_file(schemata_path, &length)) ) return false;
+        snprintf(llc_resctrl_default_schemata, sizeof(llc_resctrl_default_schemata), "%s", schemata);
+        free((void*)schemata);
+    }
+    if ( ! llc_resctrl_backend->group_create(path) ) return false;
+    if ( ! llc_resctrl_schemata_write(&info, LLC_RESCTRL_GROUP, job_mask, 100) || ! llc_resctrl_schemata_write(&info, "", info.cbm_mask & ~job_mask, mba) ) {
+        llc_resctrl_default_restore(&info);
+        llc_resctrl_group_remove();
+        return false;
+    }
+    debug("MODE::LLC::exclusive: %u of %u ways (0x%llx), others at %u%% bandwidth", ways, info.n_ways, job_mask, mba);
+    return true;
+}
+
+/**
+ * @brief   Maximum number of NUMA nodes MODE::MEMCLEAN handles
+ */
+#define MEMCLEAN_MAX_NODES          64
+
+/**
+ * @brief   Count the free 2 MiB blocks on each NUMA node
+ * @details /proc/buddyinfo lists, per node and zone, the free blocks of
+ *          each order; blocks of order 9 and up (4 KiB pages) each hold
+ *          2^(order - 9) free 2 MiB pages.
+ * @param   free_2m     per-node counts to fill-in (indexed by node id)
+ * @return  One more than the highest node id seen (0 on error)
+ */
+static unsigned int
+memclean_buddyinfo_read(
+    unsigned long long  free_2m[MEMCLEAN_MAX_NODES]
+)
+{
+    char                path[PATH_MAX], *buddyinfo, *line;
+    size_t              length;
+    unsigned int        n_nodes = 0;
+    
+    memset(free_2m, 0, MEMCLEAN_MAX_NODES * sizeof(*free_2m));
+    if ( ! sysfs_path(path, sizeof(path), "/proc/buddyinfo") || ! (buddyinfo = proc_read_file(path, &length)) ) return 0;
+    for ( line = buddyinfo; line && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL ) {
+        unsigned int    node, order = 0;
+        char            *p;
+        
+        if ( (sscanf(line, "Node %u,", &node) != 1) || (node >= MEMCLEAN_MAX_NODES) || ! (p = strstr(line, "zone")) ) continue;
+        /* Skip "zone" and the zone name: */
+        p += 4;
+        while ( *p == ' ' ) p++;
+        while ( *p && ! isspace((unsigned char)*p) ) p++;
+        while ( *p && (*p != '\n') ) {
+            char                *e;
+            unsigned long long  count = strtoull(p, &e, 10);
+            
+            if ( e == p ) break;
+            if ( order >= 9 ) free_2m[node] += count << (order - 9);
+            order++;
+            p = e;
+        }
+        if ( node + 1 > n_nodes ) n_nodes = node + 1;
+    }
+    free((void*)buddyinfo);
+    return n_nodes;
+}
+
+/**
+ * @brief   State shared by MODE::MEMCLEAN and its helper thread
+ * @details The caller stops waiting when the budget runs out; the helper
+ *          then finishes on its own and disposes of the structure.
+ */
+typedef struct memclean_job {
+    pthread_mutex_t     lock;           /**< protects is_done and is_abandoned */
+    pthread_cond_t      cond;           /**< signalled when the helper finishes */
+    bool                is_done;        /**< the helper has finished */
+    bool                is_abandoned;   /**< the caller gave up waiting */
+    unsigned int        n_failed;       /**< writes that failed */
+} memclean_job_t;
+
+/**
+ * @var     memclean_is_running
+ * @brief   A (possibly abandoned) memclean helper is still running
+ */
+static bool memclean_is_running = false;
+static pthread_mutex_t memclean_running_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief   Compact one NUMA node (thread body; the argument is the path)
+ * @return  @a NULL on success, non-NULL if the write failed
+ */
+static void*
+memclean_compact_thread(
+    void        *arg
+)
+{
+    return sysfs_write_str((const char*)arg, "1") ? NULL : arg;
+}
+
+/**
+ * @brief   Helper thread:  drop the page cache, then compact every NUMA
+ *          node in parallel
+ */
+static void*
+memclean_job_thread(
+    void                *arg
+)
+{
+    memclean_job_t      *job = (memclean_job_t*)arg;
+    char                path[PATH_MAX];
+    glob_t              files;
+    bool                is_abandoned;
+    
+    if ( ! sysfs_path(path, sizeof(path), "/proc/sys/vm/drop_caches") || ! sysfs_write_str(path, "1") ) job->n_failed++;
+    if ( sysfs_path(path, sizeof(path), "/sys/devices/system/node/node[0-9]*/compact") && (glob(path, 0, NULL, &files) == 0) ) {
+        pthread_t       threads[MEMCLEAN_MAX_NODES];
+        bool            is_started[MEMCLEAN_MAX_NODES] = { false };
+        size_t          i;
+        
+        for ( i = 0; (i < files.gl_pathc) && (i < MEMCLEAN_MAX_NODES); i++ ) {
+            is_started[i] = ( pthread_create(&threads[i], NULL, memclean_compact_thread, files.gl_pathv[i]) == 0 );
+            if ( ! is_started[i] && memclean_compact_thread(files.gl_pathv[i]) ) job->n_failed++;
+        }
+        for ( i = 0; (i < files.gl_pathc) && (i < MEMCLEAN_MAX_NODES); i++ ) {
+            void        *result = NULL;
+            
+            if ( is_started[i] && (pthread_join(threads[i], &result) == 0) && result ) job->n_failed++;
+        }
+        globfree(&files);
+    }
+    else if ( ! sysfs_path(path, sizeof(path), "/proc/sys/vm/compact_memory") || ! sysfs_write_str(path, "1") ) {
+        job->n_failed++;
+    }
+    
+    pthread_mutex_lock(&job->lock);
+    job->is_done = true;
+    is_abandoned = job->is_abandoned;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+    if ( is_abandoned ) {
+        info("MODE::MEMCLEAN: finished after the budget ran out");
+        pthread_cond_destroy(&job->cond);
+        pthread_mutex_destroy(&job->lock);
+        free((void*)job);
+    }
+    
+    /* Last, so fini() knows the helper is done with the plugin: */
+    pthread_mutex_lock(&memclean_running_mutex);
+    memclean_is_running = false;
+    pthread_mutex_unlock(&memclean_running_mutex);
+    return NULL;
+}
+
+/**
+ * @brief   node_mode_values_cb for the memory cleaning mode
+ * @details Offered where the page cache can be dropped.
+ */
+static bool
+node_mode_memclean_values(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *values,
+    size_t              values_len
+)
+{
+    char                path[PATH_MAX];
+    
+    if ( ! sysfs_path(path, sizeof(path), "/proc/sys/vm/drop_caches") || (access(path, F_OK) != 0) ) return false;
+    snprintf(values, values_len, "%s", mode->static_values);
+    return true;
+}
+
+/**
+ * @brief   node_mode_get_cb for the memory cleaning mode
+ * @details Cleaning is an action, not a state:  the node always reads
+ *          "off", so every job that asks for "on" gets a clean node.
+ */
+static bool
+node_mode_memclean_get(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *value,
+    size_t              value_len
+)
+{
+    snprintf(value, value_len, "off");
+    return true;
+}
+
+/**
+ * @brief   node_mode_set_cb for the memory cleaning mode
+ * @details "on" drops the page cache and compacts every NUMA node in
+ *          parallel on a helper thread, waiting at most MemCleanBudgetMS
+ *          for it; past the budget the helper is left to finish on its
+ *          own.  The free 2 MiB blocks per node (from /proc/buddyinfo)
+ *          before and after are logged.  Nothing is started while an
+ *          earlier helper is still running.  "off" does nothing.
+ */
+static bool
+node_mode_memclean_set(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    const char          *value
+)
+{
+    unsigned long long  before[MEMCLEAN_MAX_NODES], after[MEMCLEAN_MAX_NODES];
+    unsigned int        n_nodes, node;
+    memclean_job_t      *job;
+    pthread_condattr_t  cond_attr;
+    pthread_attr_t      thread_attr;
+    pthread_t           thread;
+    struct timespec     deadline;
+    bool                is_busy, is_done;
+    int                 rc = 0;
+    
+    if ( ! strcmp(value, "off") ) return true;
+    if ( strcmp(value, "on") ) return false;
+    
+    pthread_mutex_lock(&memclean_running_mutex);
+    is_busy = memclean_is_running;
+    memclean_is_running = true;
+    pthread_mutex_unlock(&memclean_running_mutex);
+    if ( is_busy ) {
+        info("MODE::MEMCLEAN: an earlier clean is still running");
+        return true;
+    }
+    
+    n_nodes = memclean_buddyinfo_read(before);
+    if ( ! (job = (memclean_job_t*)calloc(1, sizeof(*job))) ) {
+        pthread_mutex_lock(&memclean_running_mutex);
+        memclean_is_running = false;
+        pthread_mutex_unlock(&memclean_running_mutex);
+        return false;
+    }
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&job->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    
+    pthread_attr_init(&thread_attr);
+    pthread_attr_setdetachstate(&thread_attr, PTHREAD_CREATE_DETACHED);
+    if ( pthread_create(&thread, &thread_attr, memclean_job_thread, job) ) {
+        /* Run inline; the helper marks itself done: */
+        memclean_job_thread(job);
+    }
+    pthread_attr_destroy(&thread_attr);
+    
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += config->memclean_budget_ms / 1000;
+    deadline.tv_nsec += (long)(config->memclean_budget_ms % 1000) * 1000000;
+    if ( deadline.tv_nsec >= 1000000000 ) deadline.tv_sec++, deadline.tv_nsec -= 1000000000;
+    
+    pthread_mutex_lock(&job->lock);
+    while ( ! job->is_done && (rc != ETIMEDOUT) ) rc = pthread_cond_timedwait(&job->cond, &job->lock, &deadline);
+    if ( ! (is_done = job->is_done) ) job->is_abandoned = true;
+    pthread_mutex_unlock(&job->lock);
+    
+    if ( (node = memclean_buddyinfo_read(after)) > n_nodes ) n_nodes = node;
+    for ( node = 0; node < n_nodes; node++ ) {
+        info("MODE::MEMCLEAN: node %u free 2 MiB blocks %llu -> %llu", node, before[node], after[node]);
+    }
+    if ( ! is_done ) {
+        info("MODE::MEMCLEAN: budget of %u ms exhausted, compaction continues in the background", config->memclean_budget_ms);
+        return true;
+    }
+    if ( job->n_failed ) error("MODE::MEMCLEAN: %u of the cache drop and compaction writes failed", job->n_failed);
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->lock);
+    rc = job->n_failed;
+    free((void*)job);
+    return ( rc == 0 );
+}
+
+/**
+ * @brief   Longest a site command may run, milliseconds
+ */
+#define SITE_COMMAND_TIMEOUT_MS     30000
+
+/**
+ * @brief   Run a site-provided command and capture its output
+ * @details The command is executed directly (no shell) with stdin from
+ *          /dev/null.  One that overruns SITE_COMMAND_TIMEOUT_MS is killed.
+ * @param   argv        the command (argv[0] is its path) and arguments,
+ *                      @a NULL-terminated
+ * @param   out         buffer to receive standard output (may be @a NULL)
+ * @param   out_len     capacity of @a out
+ * @return  The command's exit status, -1 if it could not be run or did not
+ *          exit normally
+ */
+static int
+site_command_run(
+    const char *const   argv[],
+    char                *out,
+    size_t              out_len
+)
+{
+    int                 fds[2], status = 0;
+    pid_t               pid;
+    size_t              used = 0;
+    struct timespec     t0, t1;
+    
+    if ( pipe(fds) != 0 ) return -1;
+    fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+    fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+    if ( (pid = fork()) < 0 ) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if ( pid == 0 ) {
+        int             null_fd = open("/dev/null", O_RDONLY);
+        
+        if ( null_fd >= 0 ) dup2(null_fd, STDIN_FILENO);
+        dup2(fds[1], STDOUT_FILENO);
+        execv(argv[0], (char* const*)argv);
+        _exit(127);
+    }
+    close(fds[1]);
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while ( true ) {
+        struct pollfd   pfd = { .fd = fds[0], .events = POLLIN };
+        char            discard[256];
+        long            elapsed_ms;
+        ssize_t         n;
+        int             rc;
+        
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        elapsed_ms = (t1.tv_sec - t0.tv_sec) * 1000 + (t1.tv_nsec - t0.tv_nsec) / 1000000;
+        if ( elapsed_ms >= SITE_COMMAND_TIMEOUT_MS ) {
+            error("%s: killed after %d ms", argv[0], SITE_COMMAND_TIMEOUT_MS);
+            kill(pid, SIGKILL);
+            break;
+        }
+        if ( (rc = poll(&pfd, 1, SITE_COMMAND_TIMEOUT_MS - elapsed_ms)) < 0 ) {
+            if ( errno == EINTR ) continue;
+            break;
+        }
+        if ( rc == 0 ) continue;
+        if ( out && (used + 1 < out_len) ) n = read(fds[0], out + used, out_len - used - 1);
+        else n = read(fds[0], discard, sizeof(discard));
+        if ( n < 0 ) {
+            if ( errno == EINTR ) continue;
+            break;
+        }
+        if ( n == 0 ) break;
+        if ( out && (used + 1 < out_len) ) used += n;
+    }
+    close(fds[0]);
+    if ( out && out_len ) out[used] = '\0';
+    while ( waitpid(pid, &status, 0) < 0 ) if ( errno != EINTR ) return -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/**
+ * @brief   Most recent measurements averaged per reboot mode value
+ */
+#define REBOOT_HISTORY_SAMPLES      8
+
+/**
+ * @brief   Longest plausible reboot, seconds; longer gaps are outages
+ */
+#define REBOOT_HISTORY_MAX_SECONDS  86400
+
+/**
+ * @brief   Append a record to the reboot history file
+ * @details Records are "<epoch> <host> <feature> <what>" lines, where
+ *          @a what is "staged" or the measured seconds.  Each is a single
+ *          O_APPEND write so nodes sharing the file do not interleave.
+ */
+static bool
+reboot_history_append(
+    cpuinfo_config_t    *config,
+    const char          *feature,
+    const char          *what
+)
+{
+    char                host[256], line[512];
+    int                 fd, line_len;
+    bool                is_okay;
+    
+    if ( ! config->reboot_history_file ) return true;
+    if ( gethostname(host, sizeof(host)) != 0 ) return false;
+    host[sizeof(host) - 1] = '\0';
+    line_len = snprintf(line, sizeof(line), "%ld %s %s %s\n", (long)time(NULL), host, feature, what);
+    if ( (line_len < 0) || (line_len >= sizeof(line)) ) return false;
+    if ( (fd = open(config->reboot_history_file, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644)) < 0 ) return false;
+    is_okay = ( write(fd, line, line_len) == line_len );
+    if ( close(fd) != 0 ) is_okay = false;
+    return is_okay;
+}
+
+/**
+ * @brief   Typical reboot time into any value of a mode
+ * @details The last REBOOT_HISTORY_SAMPLES measurements of each
+ *          MODE::<name>::<value> (from every node) are averaged; the
+ *          slowest value's average is the answer.
+ * @param   config      the plugin configuration
+ * @param   name        the mode name
+ * @return  Seconds, 0 if nothing has been measured
+ */
+static unsigned int
+reboot_history_seconds(
+    cpuinfo_config_t    *config,
+    const char          *name
+)
+{
+    struct {
+        char            value[NODE_MODE_VALUE_MAX];
+        unsigned int    n, sample[REBOOT_HISTORY_SAMPLES];
+    }                   values[8];
+    unsigned int        n_values = 0, i, worst = 0;
+    char                prefix[64], *history, *line;
+    size_t              length, prefix_len;
+    
+    if ( ! config->reboot_history_file ) return 0;
+    prefix_len = snprintf(prefix, sizeof(prefix), "MODE::%s::", name);
+    if ( (prefix_len >= sizeof(prefix)) || ! (history = proc_read_file(config->reboot_history_file, &length)) ) return 0;
+    for ( line = history; line && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL ) {
+        char            feature[128];
+        unsigned int    seconds;
+        
+        if ( (sscanf(line, "%*s %*s %127s %u", feature, &seconds) != 2) || strncmp(feature, prefix, prefix_len) ) continue;
+        for ( i = 0; (i < n_values) && strcmp(values[i].value, feature + prefix_len); i++ );
+        if ( i == n_values ) {
+            if ( (n_values == sizeof(values) / sizeof(values[0])) || (strlen(feature + prefix_len) >= NODE_MODE_VALUE_MAX) ) continue;
+            strcpy(values[i].value, feature + prefix_len);
+            values[i].n = 0;
+            n_values++;
+        }
+        values[i].sample[values[i].n++ % REBOOT_HISTORY_SAMPLES] = seconds;
+    }
+    free((void*)history);
+    for ( i = 0; i < n_values; i++ ) {
+        unsigned int    n = (values[i].n < REBOOT_HISTORY_SAMPLES) ? values[i].n : REBOOT_HISTORY_SAMPLES, j;
+        unsigned long   sum = 0;
+        
+        for ( j = 0; j < n; j++ ) sum += values[i].sample[j];
+        if ( (sum + n - 1) / n > worst ) worst = (sum + n - 1) / n;
+    }
+    return worst;
+}
+
+/**
+ * @brief   Record how long this node's last mode reboot took
+ * @details Called once in slurmd after it starts.  Modes staged by this
+ *          host since its last measurement are taken as complete if the
+ *          system booted after they were staged; the time from staging to
+ *          now is recorded for each.
+ * @param   config      the plugin configuration
+ */
+static HARNESS_UNUSED void
+reboot_history_complete(
+    cpuinfo_config_t    *config
+)
+{
+    struct {
+        long            epoch;
+        char            feature[128];
+    }                   staged[NODE_MODE_MAX];
+    unsigned int        n_staged = 0, i;
+    char                host[256], *history, *line, path[PATH_MAX], uptime[64];
+    size_t              length;
+    long                now = (long)time(NULL), boot_epoch = now;
+    
+    if ( ! config->reboot_history_file || (gethostname(host, sizeof(host)) != 0) ) return;
+    host[sizeof(host) - 1] = '\0';
+    if ( ! (history = proc_read_file(config->reboot_history_file, &length)) ) return;
+    for ( line = history; line && *line; line = strchr(line, '\n') ? strchr(line, '\n') + 1 : NULL ) {
+        char            line_host[256], feature[128], what[32];
+        long            epoch;
+        
+        if ( (sscanf(line, "%ld %255s %127s %31s", &epoch, line_host, feature, what) != 4) || strcmp(line_host, host) ) continue;
+        if ( strcmp(what, "staged") ) {
+            n_staged = 0;
+            continue;
+        }
+        for ( i = 0; (i < n_staged) && strcmp(staged[i].feature, feature); i++ );
+        if ( i == NODE_MODE_MAX ) continue;
+        if ( i == n_staged ) n_staged++;
+        staged[i].epoch = epoch;
+        strcpy(staged[i].feature, feature);
+    }
+    free((void*)history);
+    if ( ! n_staged ) return;
+    if ( sysfs_path(path, sizeof(path), "/proc/uptime") && sysfs_read_str(path, uptime, sizeof(uptime)) ) boot_epoch = now - (long)strtod(uptime, NULL);
+    for ( i = 0; i < n_staged; i++ ) {
+        char            seconds[32];
+        
+        if ( boot_epoch < staged[i].epoch ) return;     /* not rebooted yet */
+        if ( now - staged[i].epoch > REBOOT_HISTORY_MAX_SECONDS ) continue;
+        snprintf(seconds, sizeof(seconds), "%ld", now - staged[i].epoch);
+        if ( reboot_history_append(config, staged[i].feature, seconds) ) info("%s rebooted in %s s", staged[i].feature, seconds);
+    }
+}
+
+static node_mode_t node_modes_registry[NODE_MODE_MAX + 1];
+
+/**
+ * @brief   Cached answers from the site command, per reboot mode
+ * @details A BIOS mode only changes across a reboot (which restarts the
+ *          daemon), so each mode is queried once per process.
+ */
+static struct {
+    bool            is_cached;                  /**< @a is_supported and @a line are valid */
+    bool            is_supported;               /**< the site command reported the mode */
+    char            line[256];                  /**< its answer */
+} node_mode_reboot_cache[NODE_MODE_MAX];
+
+/**
+ * @brief   Forget the cached site command answers
+ */
+static HARNESS_UNUSED void
+node_mode_reboot_cache_clear(void)
+{
+    memset(node_mode_reboot_cache, 0, sizeof(node_mode_reboot_cache));
+}
+
+/**
+ * @brief   Ask the site command about a reboot mode
+ * @details "<RebootCommand> query <MODE>" prints the values the node can
+ *          boot into with the current one bracketed (e.g. "1 [2] 4") and
+ *          exits 0, or exits non-zero if the node lacks the mode.
+ * @return  @a NULL if the mode is not available, otherwise the answer
+ */
+static const char*
+node_mode_reboot_query(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config
+)
+{
+    unsigned int        m = mode - node_modes_registry;
+    
+    if ( ! config->reboot_command ) return NULL;
+    if ( ! node_mode_reboot_cache[m].is_cached ) {
+        const char      *argv[] = { config->reboot_command, "query", mode->name, NULL };
+        char            *line = node_mode_reboot_cache[m].line;
+        
+        node_mode_reboot_cache[m].is_supported = ( site_command_run(argv, line, sizeof(node_mode_reboot_cache[m].line)) == 0 );
+        line[strcspn(line, "\n")] = '\0';
+        if ( ! *line ) node_mode_reboot_cache[m].is_supported = false;
+        node_mode_reboot_cache[m].is_cached = true;
+    }
+    return node_mode_reboot_cache[m].is_supported ? node_mode_reboot_cache[m].line : NULL;
+}
+
+/**
+ * @brief   node_mode_values_cb for the reboot modes
+ */
+static bool
+node_mode_reboot_values(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *values,
+    size_t              values_len
+)
+{
+    const char          *line = node_mode_reboot_query(mode, config);
+    size_t              n = 0;
+    
+    if ( ! line ) return false;
+    while ( *line && (n + 1 < values_len) ) {
+        if ( (*line != '[') && (*line != ']') ) values[n++] = *line;
+        line++;
+    }
+    values[n] = '\0';
+    return ( n > 0 );
+}
+
+/**
+ * @brief   node_mode_get_cb for the reboot modes
+ */
+static bool
+node_mode_reboot_get(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    char                *value,
+    size_t              value_len
+)
+{
+    const char          *line = node_mode_reboot_query(mode, config), *s, *e;
+    
+    if ( ! line || ! (s = strchr(line, '[')) || ! (e = strchr(++s, ']')) || ((e - s) >= value_len) ) return false;
+    memcpy(value, s, e - s);
+    value[e - s] = '\0';
+    return true;
+}
+
+/**
+ * @brief   node_mode_set_cb for the reboot modes
+ * @details "<RebootCommand> set <MODE> <value>" stages the value for the
+ *          next boot; Slurm reboots the node afterwards.  The staging is
+ *          recorded in the reboot history so the reboot can be timed.
+ */
+static bool
+node_mode_reboot_set(
+    node_mode_ref       mode,
+    cpuinfo_config_t    *config,
+    const char          *value
+)
+{
+    const char          *argv[] = { config->reboot_command, "set", mode->name, value, NULL };
+    char                feature[128];
+    
+    if ( ! config->reboot_command || (site_command_run(argv, NULL, 0) != 0) ) return false;
+    snprintf(feature, sizeof(feature), "MODE::%s::%s", mode->name, value);
+    if ( ! reboot_history_append(config, feature, "staged") ) error("unable to record %s in %s", feature, config->reboot_history_file);
+    return true;
+}
+
+/**
+ * @var     node_modes_registry
+ * @brief   The list of job-selectable node modes
+ * @details A struct with all fields' being NULL acts as the list
+ *          terminator.
+ */
+static node_mode_t node_modes_registry[NODE_MODE_MAX + 1] = {
+        { "TURBO", "on off", node_mode_turbo_values, node_mode_turbo_get, node_mode_turbo_set, 10, 0, false, false },
+        { "GOV", NULL, node_mode_gov_values, node_mode_gov_get, node_mode_gov_set, 10, 0, false, false },
+        { "SMT", "on off", node_mode_smt_values, node_mode_smt_get, node_mode_smt_set, 5000, node_uevent_subsystem_cpu, false, true },
+        { "THP", NULL, node_mode_thp_values, node_mode_thp_get, node_mode_thp_set, 10, 0, false, false },
+        { "HUGE1G", "0 1 2 4 8 16 32 64 128 256 512 1024", node_mode_huge1g_values, node_mode_huge1g_get, node_mode_huge1g_set, 30000, 0, false, true },
+        { "PREFETCH", "on off", node_mode_prefetch_values, node_mode_prefetch_get, node_mode_prefetch_set, 100, 0, false, false },
+        { "LLC", "shared exclusive", node_mode_llc_values, node_mode_llc_get, node_mode_llc_set, 100, 0, false, true },
+        { "MEMCLEAN", "off on", node_mode_memclean_values, node_mode_memclean_get, node_mode_memclean_set, 10000, 0, false, false },
+        { "SNC", "1 2 3 4", node_mode_reboot_values, node_mode_reboot_get, node_mode_reboot_set, 0, 0, true, false },
+        { "NPS", "0 1 2 4", node_mode_reboot_values, node_mode_reboot_get, node_mode_reboot_set, 0, 0, true, false },
+        { "HBM", "flat cache hbm", node_mode_reboot_values, node_mode_reboot_get, node_mode_reboot_set, 0, 0, true, false },
+        { NULL, NULL, NULL, NULL, NULL, 0, 0, false, false }
+    };
+
+/**
+ * @brief   Split a MODE::<name>::<value> feature into its mode and value
+ * @param   feature         the feature name
+ * @param   feature_len     characters in @a feature
+ * @param   value           pointer to the start of the value on return
+ * @param   value_len       pointer to the length of the value on return
+ * @return  The index of the mode in node_modes_registry, or -1 if
+ *          @a feature does not name a registered mode
+ */
+static int
+node_mode_feature_parse(
+    const char      *feature,
+    size_t          feature_len,
+    const char      **value,
+    size_t          *value_len
+)
+{
+    const node_mode_t   *mode = node_modes_registry;
+    
+    if ( (feature_len < 6) || strncmp(feature, "MODE::", 6) ) return -1;
+    while ( mode->name ) {
+        size_t          name_len = strlen(mode->name);
+        
+        if ( (feature_len > 8 + name_len) && ! strncmp(feature + 6, mode->name, name_len) && ! strncmp(feature + 6 + name_len, "::", 2) ) {
+            *value = feature + 8 + name_len;
+            *value_len = feature_len - 8 - name_len;
+            return mode - node_modes_registry;
+        }
+        mode++;
+    }
+    return -1;
+}
+
+/**
+ * @brief   Does the configuration allow a MODE:: feature?
+ * @details AllowedModes entries are the MODE namespace, a mode (e.g.
+ *          MODE::TURBO, allowing all of its values) or patterns (e.g.
+ *          MODE::GOV::perf*); with no AllowedModes no mode is allowed.
+ *          Modes that withhold resources from later jobs are only allowed
+ *          with a ModeStateFile, through which the Epilog restores them.
+ */
+static bool
+node_mode_is_allowed(
+    cpuinfo_config_t    *config,
+    const char          *feature,
+    size_t              feature_len
+)
+{
+    const char          *value_sep;
+    const node_mode_t   *mode = node_modes_registry;
+    
+    if ( ! config->mode_allow ) return false;
+    if ( ! config->mode_state_file ) {
+        while ( mode->name ) {
+            size_t      name_len = strlen(mode->name);
+            
+            if ( mode->is_withholding && (feature_len >= 6 + name_len) && ! strncmp(feature, "MODE::", 6) && ! strncmp(feature + 6, mode->name, name_len)
+                        && ((feature_len == 6 + name_len) || ! strncmp(feature + 6 + name_len, "::", 2)) ) return false;
+            mode++;
+        }
+    }
+    if ( feature_policy_list_matches(config->mode_allow, feature, feature_len) ) return true;
+    /* Try again with the value removed: */
+    for ( value_sep = feature + feature_len - 2; value_sep > feature + 6; value_sep-- ) {
+        if ( ! strncmp(value_sep, "::", 2) ) return feature_policy_list_matches(config->mode_allow, feature, value_sep - feature);
+    }
+    return false;
+}
+
+/**
+ * @brief   Append the available and current MODE:: features
+ * @details Every allowed value the node offers is available; the current
+ *          value of each mode with at least one allowed value is active.
+ * @param   config          the plugin configuration
+ * @param   avail           pointer to the available feature string to extend
+ * @param   avail_delim     pointer to its current delimiter
+ * @param   current         pointer to the active feature string to extend
+ * @param   current_delim   pointer to its current delimiter
+ */
+static HARNESS_UNUSED void
+node_modes_fmtcat(
+    cpuinfo_config_t    *config,
+    char                **avail,
+    const char          **avail_delim,
+    char                **current,
+    const char          **current_delim
+)
+{
+    node_mode_t         *mode = node_modes_registry;
+    
+    if ( ! config->mode_allow ) return;
+    while ( mode->name ) {
+        char            values[1024], value[NODE_MODE_VALUE_MAX], feature[128];
+        const char      *v = values;
+        bool            has_allowed = false;
+        
+        if ( mode->values_cb(mode, config, values, sizeof(values)) ) {
+            while ( *v ) {
+                const char  *e;
+                int         feature_len;
+                
+                while ( *v == ' ' ) v++;
+                e = v;
+                while ( *e && (*e != ' ') ) e++;
+                if ( e > v ) {
+                    feature_len = snprintf(feature, sizeof(feature), "MODE::%s::%.*s", mode->name, (int)(e - v), v);
+                    if ( (feature_len < sizeof(feature)) && node_mode_is_allowed(config, feature, feature_len) ) {
+                        xstrfmtcat(*avail, "%s%s", *avail_delim, feature), *avail_delim = ",";
+                        has_allowed = true;
+                    }
+                }
+                v = e;
+            }
+            if ( has_allowed && mode->get_cb(mode, config, value, sizeof(value)) ) {
+                xstrfmtcat(*current, "%sMODE::%s::%s", *current_delim, mode->name, value), *current_delim = ",";
+            }
+        }
+        mode++;
+    }
+}
+
+/**
+ * @brief   Check the MODE:: features in a feature list or constraint
+ * @details Each must name a registered mode, be allowed by AllowedModes,
+ *          carry a value the mode accepts on any node (when the mode has a
+ *          fixed set) and not conflict with another value for the same
+ *          mode.  Other features are ignored.
+ * @param   config      the plugin configuration
+ * @param   features    the feature list or job constraint
+ * @return  Boolean false if any MODE:: feature is unacceptable
+ */
+static HARNESS_UNUSED bool
+node_modes_validate(
+    cpuinfo_config_t    *config,
+    const char          *features
+)
+{
+    const char          *seen[NODE_MODE_MAX] = { NULL };
+    size_t              seen_len[NODE_MODE_MAX] = { 0 };
+    const char          *name, *value;
+    size_t              name_len, value_len;
+    
+    if ( ! features ) return true;
+    while ( (name = feature_list_next(&features, &name_len)) ) {
+        int             m;
+        
+        if ( (name_len < 6) || strncmp(name, "MODE::", 6) ) continue;
+        if ( (m = node_mode_feature_parse(name, name_len, &value, &value_len)) < 0 ) {
+            error("unknown mode %.*s", (int)name_len, name);
+            return false;
+        }
+        if ( ! node_mode_is_allowed(config, name, name_len) ) {
+            error("mode %.*s is not allowed", (int)name_len, name);
+            return false;
+        }
+        if ( node_modes_registry[m].static_values && ! node_mode_value_is_listed(node_modes_registry[m].static_values, value, value_len) ) {
+            error("invalid value for mode %.*s", (int)name_len, name);
+            return false;
+        }
+        if ( seen[m] && ((seen_len[m] != value_len) || strncmp(seen[m], value, value_len)) ) {
+            error("conflicting values for mode MODE::%s", node_modes_registry[m].name);
+            return false;
+        }
+        seen[m] = value, seen_len[m] = value_len;
+    }
+    return true;
+}
+
+/*
+ * ModeStateFile records what node_modes_apply() would need to restore the
+ * node, one item per line:
+ *
+ *     MODE::<mode>::<value>        a mode a job changed, with the node's own value
+ *     HUGE1G::NODE::<count>        the node's own 1 GiB hugepages per NUMA node, in order
+ *     LLC::SCHEMATA::<line>        the default resctrl group's own schemata
+ */
+
+/**
+ * @brief   Replace the mode state with the contents of ModeStateFile
+ * @details Another process (the Epilog's restore pass) may have restored
+ *          the node since the last call, so the file rather than memory
+ *          is authoritative.  A missing file means no mode is changed.
+ * @param   modes       the node's mode state
+ * @param   config      the plugin configuration
+ */
+static void
+node_modes_state_load(
+    node_modes_t        *modes,
+    cpuinfo_config_t    *config
+)
+{
+    char                *text, *line, *eol;
+    size_t              text_len = 0, schemata_len = 0;
+    unsigned int        m;
+    
+    if ( ! config->mode_state_file ) return;
+    for ( m = 0; m < NODE_MODE_MAX; m++ ) modes->state[m].is_modified = false;
+    memset(&node_mode_huge1g_saved, 0, sizeof(node_mode_huge1g_saved));
+    *llc_resctrl_default_schemata = '\0';
+    if ( ! (text = proc_read_file(config->mode_state_file, &text_len)) ) {
+        if ( errno != ENOENT ) error("node_modes_state_load: unable to read %s (errno = %d)", config->mode_state_file, errno);
+        return;
+    }
+    for ( line = text; *line; line = *eol ? eol + 1 : eol ) {
+        const char      *value;
+        size_t          line_len, value_len;
+        int             mi;
+        
+        if ( ! (eol = strchr(line, '\n')) ) eol = line + strlen(line);
+        line_len = eol - line;
+        if ( (mi = node_mode_feature_parse(line, line_len, &value, &value_len)) >= 0 ) {
+            if ( ! node_modes_registry[mi].is_reboot && (value_len < sizeof(modes->state[mi].baseline)) ) {
+                modes->state[mi].is_modified = true;
+                memcpy(modes->state[mi].baseline, value, value_len);
+                modes->state[mi].baseline[value_len] = '\0';
+            }
+        }
+        else if ( str_startswith(line, "HUGE1G::NODE::", line_len) && (node_mode_huge1g_saved.n_nodes < HUGE1G_MAX_NODES) ) {
+            node_mode_huge1g_saved.is_saved = true;
+            node_mode_huge1g_saved.count[node_mode_huge1g_saved.n_nodes] = strtoull(line + 14, NULL, 10);
+            node_mode_huge1g_saved.total += node_mode_huge1g_saved.count[node_mode_huge1g_saved.n_nodes++];
+        }
+        else if ( str_startswith(line, "LLC::SCHEMATA::", line_len) && (schemata_len + line_len - 15 + 2 <= sizeof(llc_resctrl_default_schemata)) ) {
+            schemata_len += snprintf(llc_resctrl_default_schemata + schemata_len, sizeof(llc_resctrl_default_schemata) - schemata_len, "%.*s\n", (int)(line_len - 15), line + 15);
+        }
+    }
+    free(text);
+}
+
+/**
+ * @brief   Write the mode state to ModeStateFile
+ * @details The file is replaced atomically, and removed once the node has
+ *          nothing left to restore.
+ * @param   modes       the node's mode state
+ * @param   config      the plugin configuration
+ * @return  Boolean false if the file could not be written
+ */
+static bool
+node_modes_state_save(
+    node_modes_t        *modes,
+    cpuinfo_config_t    *config
 )
 {
-    static bool                 is_pci_inited = false;
+    char                *text = NULL, path[PATH_MAX];
+    const char          *line, *eol;
+    FILE                *fptr;
+    unsigned int        m;
+    size_t              i;
+    bool                is_okay;
     
-    struct pci_device_iterator  *iter;
-    struct pci_id_match         match;
-    struct pci_device           *device;
+    if ( ! config->mode_state_file ) return true;
+    for ( m = 0; node_modes_registry[m].name; m++ ) {
+        if ( modes->state[m].is_modified ) xstrfmtcat(text, "MODE::%s::%s\n", node_modes_registry[m].name, modes->state[m].baseline);
+    }
+    if ( node_mode_huge1g_saved.is_saved ) {
+        for ( i = 0; i < node_mode_huge1g_saved.n_nodes; i++ ) xstrfmtcat(text, "HUGE1G::NODE::%llu\n", node_mode_huge1g_saved.count[i]);
+    }
+    for ( line = llc_resctrl_default_schemata; *line; line = *eol ? eol + 1 : eol ) {
+        if ( ! (eol = strchr(line, '\n')) ) eol = line + strlen(line);
+        if ( eol > line ) xstrfmtcat(text, "LLC::SCHEMATA::%.*s\n", (int)(eol - line), line);
+    }
+    if ( ! text ) {
+        if ( (unlink(config->mode_state_file) == 0) || (errno == ENOENT) ) return true;
+        error("node_modes_state_save: unable to remove %s (errno = %d)", config->mode_state_file, errno);
+        return false;
+    }
+    is_okay = ( snprintf(path, sizeof(path), "%s.new", config->mode_state_file) < sizeof(path) ) && (fptr = fopen(path, "w"));
+    if ( is_okay ) {
+        is_okay = ( fputs(text, fptr) >= 0 );
+        if ( fclose(fptr) != 0 ) is_okay = false;
+        if ( is_okay ) is_okay = ( rename(path, config->mode_state_file) == 0 );
+    }
+    if ( ! is_okay ) error("node_modes_state_save: unable to write %s (errno = %d)", config->mode_state_file, errno);
+    xfree(text);
+    return is_okay;
+}
+
+/**
+ * @brief   Apply the modes a job requested and restore the rest
+ * @details For each mode named in @a features the node's own value is
+ *          remembered (the first time) and the requested value applied.
+ *          Modes not named that a previous job changed are restored to
+ *          the remembered value.  Disallowed modes are ignored.
+ *          Each transition is timed for node_modes_boot_time().  With a
+ *          ModeStateFile the remembered values are read from it first and
+ *          written back afterwards.
+ * @param   modes       the node's mode state
+ * @param   config      the plugin configuration
+ * @param   features    the job's active features
+ * @param   subsystems  if not @a NULL, set to the node_uevent_subsystem_t
+ *                      mask of probes invalidated by the transitions
+ * @return  Boolean false if any mode could not be applied or restored
+ */
+static HARNESS_UNUSED bool
+node_modes_apply(
+    node_modes_t        *modes,
+    cpuinfo_config_t    *config,
+    const char          *features,
+    unsigned int        *subsystems
+)
+{
+    node_mode_t         *mode = node_modes_registry;
+    bool                is_okay = true;
+    struct timespec     t0, t1;
     
-    char                        *feature_list = NULL;
-    const char                  *delim = (out_features && *out_features) ? "," : "";
+    if ( subsystems ) *subsystems = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    node_modes_state_load(modes, config);
+    while ( mode->name ) {
+        node_mode_state_t   *state = &modes->state[mode - node_modes_registry];
+        struct timespec     m0, m1;
+        bool                did_change = false;
+        const char          *list = features ? features : "", *name, *value;
+        size_t              name_len, value_len;
+        char                requested[NODE_MODE_VALUE_MAX] = "";
+        
+        while ( (name = feature_list_next(&list, &name_len)) ) {
+            if ( (node_mode_feature_parse(name, name_len, &value, &value_len) == (mode - node_modes_registry))
+                        && (value_len < sizeof(requested)) && node_mode_is_allowed(config, name, name_len) ) {
+                memcpy(requested, value, value_len);
+                requested[value_len] = '\0';
+                break;
+            }
+        }
+        if ( mode->is_reboot ) {
+            /* Staged for the next boot; the node never reverts on its own: */
+            char            current[NODE_MODE_VALUE_MAX];
+            
+            if ( *requested && mode->get_cb(mode, config, current, sizeof(current)) && strcmp(current, requested) ) {
+                if ( mode->set_cb(mode, config, requested) ) {
+                    info("staged MODE::%s::%s for the next boot", mode->name, requested);
+                } else {
+                    error("unable to stage MODE::%s::%s", mode->name, requested);
+                    is_okay = false;
+                }
+            }
+        }
+        else if ( *requested ) {
+            if ( ! state->is_modified && ! mode->get_cb(mode, config, state->baseline, sizeof(state->baseline)) ) {
+                error("unable to read the current value of MODE::%s", mode->name);
+                is_okay = false;
+            }
+            else {
+                clock_gettime(CLOCK_MONOTONIC, &m0);
+                if ( ! mode->set_cb(mode, config, requested) ) {
+                    /* A partial change is restored with the rest: */
+                    error("unable to apply MODE::%s::%s", mode->name, requested);
+                    state->is_modified = true;
+                    is_okay = false;
+                } else {
+                    state->is_modified = true;
+                    did_change = true;
+                    info("applied MODE::%s::%s", mode->name, requested);
+                }
+            }
+        }
+        else if ( state->is_modified ) {
+            clock_gettime(CLOCK_MONOTONIC, &m0);
+            if ( mode->set_cb(mode, config, state->baseline) ) {
+                state->is_modified = false;
+                did_change = true;
+                info("restored MODE::%s::%s", mode->name, state->baseline);
+            } else {
+                error("unable to restore MODE::%s::%s", mode->name, state->baseline);
+                is_okay = false;
+            }
+        }
+        if ( did_change ) {
+            clock_gettime(CLOCK_MONOTONIC, &m1);
+            state->transition_ms = 1 + (m1.tv_sec - m0.tv_sec) * 1000 + (m1.tv_nsec - m0.tv_nsec) / 1000000;
+            if ( subsystems ) *subsystems |= mode->uevent_subsystems;
+        }
+        mode++;
+    }
+    if ( ! node_modes_state_save(modes, config) ) is_okay = false;
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    debug("node_modes_apply: %.3f ms", 1e3 * (t1.tv_sec - t0.tv_sec) + 1e-6 * (t1.tv_nsec - t0.tv_nsec));
+    return is_okay;
+}
+
+/**
+ * @brief   Expected time for the node to change modes, in seconds
+ * @details The slowest allowed mode determines the answer; a mode's last
+ *          measured transition is used once there is one, its registered
+ *          estimate until then.  Reboot modes use the average of the
+ *          reboots recorded in RebootHistoryFile, RebootTime until there
+ *          are some.
+ * @param   modes       the node's mode state
+ * @param   config      the plugin configuration
+ * @return  Seconds (rounded up), 0 if no mode is allowed
+ */
+static HARNESS_UNUSED uint32_t
+node_modes_boot_time(
+    node_modes_t        *modes,
+    cpuinfo_config_t    *config
+)
+{
+    node_mode_t         *mode = node_modes_registry;
+    unsigned int        max_ms = 0;
+    
+    while ( mode->name ) {
+        char            prefix[64];
+        int             prefix_len = snprintf(prefix, sizeof(prefix), "MODE::%s", mode->name);
+        
+        if ( (prefix_len < sizeof(prefix)) && node_mode_is_allowed(config, prefix, prefix_len) ) {
+            unsigned int    ms = modes->state[mode - node_modes_registry].transition_ms;
+            
+            if ( mode->is_reboot ) {
+                unsigned int    seconds;
+                
+                if ( ! config->reboot_command ) {
+                    mode++;
+                    continue;
+                }
+                seconds = reboot_history_seconds(config, mode->name);
+                
+                ms = 1000 * (seconds ? seconds : config->reboot_time);
+            }
+            else if ( ! ms ) ms = mode->estimate_ms;
+            if ( ms > max_ms ) max_ms = ms;
+        }
+        mode++;
+    }
+    return (max_ms + 999) / 1000;
+}
+
+#ifdef NODE_FEATURE_CPUINFO_TESTING
+#ifndef NODE_FEATURE_CPUINFO_NO_MAIN
+
+/**
+ * @brief   Build a hardware catalog file from text records
+ * @details Each record is a line of the form "<fingerprint> <features>" as
+ *          printed by the -p option of this program; blank lines and text
+ *          following a '#' are ignored.  A later record for the same
+ *          fingerprint replaces an earlier one.
+ * @param   catalog_file    the catalog file to write
+ * @param   n_files         number of record files
+ * @param   files           the record files
+ * @return  Boolean true if the catalog was written
+ */
+static bool
+catalog_build(
+    const char              *catalog_file,
+    int                     n_files,
+    char* const             files[]
+)
+{
+    catalog_header_t        header;
+    catalog_slot_t          *slots = NULL, *entries = NULL;
+    char                    *blob = NULL;
+    size_t                  n_entries = 0, blob_len = 0, i;
+    bool                    is_okay = true;
+    FILE                    *fptr;
+    int                     fi;
     
-    if ( ! out_features ) return false;
+    for ( fi = 0; fi < n_files; fi++ ) {
+        line_reader_t       *line_reader = line_reader_create(files[fi], 0);
+        const char          *line;
+        
+        if ( ! line_reader ) {
+            error("catalog_build: unable to read %s", files[fi]);
+            is_okay = false;
+            break;
+        }
+        while ( (line = line_reader_nextline(line_reader)) ) {
+            char                *comment = strchr(line, '#'), *endp = NULL;
+            unsigned long long  fingerprint;
+            size_t              features_len;
+            
+            if ( comment ) *comment = '\0', line_reader->used = (comment - line) + 1;
+            line_reader_trim(line_reader);
+            while ( isspace(*line) ) line++;
+            if ( ! *line ) continue;
+            fingerprint = strtoull(line, &endp, 16);
+            if ( (endp == line) || ! fingerprint || ! isspace(*endp) ) {
+                error("catalog_build: %s: invalid record: %s", files[fi], line);
+                is_okay = false;
+                continue;
+            }
+            while ( isspace(*endp) ) endp++;
+            features_len = strlen(endp);
+            for ( i = 0; i < n_entries; i++ ) if ( entries[i].fingerprint == fingerprint ) break;
+            if ( i == n_entries ) entries = (catalog_slot_t*)realloc(entries, ++n_entries * sizeof(catalog_slot_t));
+            blob = (char*)realloc(blob, blob_len + features_len);
+            if ( ! entries || ! blob ) {
+                perror("Memory allocation failure in catalog_build");
+                exit(errno);
+            }
+            memcpy(blob + blob_len, endp, features_len);
+            entries[i].fingerprint = fingerprint;
+            entries[i].features_offset = blob_len;
+            entries[i].features_len = features_len;
+            blob_len += features_len;
+        }
+        line_reader_free(&line_reader);
+    }
+    if ( ! is_okay ) goto done;
     
-    if ( ! is_pci_inited ) {
-        int                     rc = pci_system_init();
-        if ( rc != 0 ) {
-            // Handle error
-            fprintf(stderr, "ERROR: unable to init PCI access (%d)\n", rc);
-            return false;
+    /* Keep the table at most half full: */
+    memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+    header.n_slots = 2 * n_entries + 1;
+    header.blob_len = blob_len;
+    slots = (catalog_slot_t*)calloc(header.n_slots, sizeof(catalog_slot_t));
+    if ( ! slots ) {
+        perror("Memory allocation failure in catalog_build");
+        exit(errno);
+    }
+    for ( i = 0; i < n_entries; i++ ) {
+        uint32_t            slot = entries[i].fingerprint % header.n_slots;
+        
+        while ( slots[slot].fingerprint ) slot = (slot + 1) % header.n_slots;
+        slots[slot] = entries[i];
+    }
+    if ( ! (fptr = fopen(catalog_file, "wb")) ) {
+        error("catalog_build: unable to create %s (errno = %d)", catalog_file, errno);
+        is_okay = false;
+        goto done;
+    }
+    if ( (fwrite(&header, sizeof(header), 1, fptr) != 1) || (fwrite(slots, sizeof(catalog_slot_t), header.n_slots, fptr) != header.n_slots)
+            || (blob_len && (fwrite(blob, blob_len, 1, fptr) != 1)) ) {
+        error("catalog_build: unable to write %s", catalog_file);
+        is_okay = false;
+    }
+    if ( fclose(fptr) ) is_okay = false;
+    if ( is_okay ) info("catalog_build: %zu entries written to %s", n_entries, catalog_file);
+
+done:
+    free(slots);
+    free(entries);
+    free(blob);
+    return is_okay;
+}
+
+/**
+ * @brief   Append the features of a subset of the probes with valid results
+ * @details The costly probes' features are what a catalog entry stands in
+ *          for; the non-volatile probes' features are what an image
+ *          manifest stands in for.
+ * @param   snapshot        pointer to the node_snapshot_t
+ * @param   config          the plugin configuration
+ * @param   is_costly_only  boolean true for the costly probes, false for
+ *                          the non-volatile probes
+ * @param   features        pointer to the feature string to extend
+ * @param   delim           pointer to the current delimiter
+ */
+static void
+node_snapshot_fmtcat_subset(
+    node_snapshot_t     *snapshot,
+    cpuinfo_config_t    *config,
+    bool                is_costly_only,
+    char                **features,
+    const char          **delim
+)
+{
+    node_probe_t        *probe = node_probes;
+    unsigned int        mask = 1;
+    
+    while ( probe->name ) {
+        if ( (is_costly_only ? probe->is_costly : ! probe->is_volatile) && (snapshot->valid & mask) && probe->fmtcat_cb ) {
+            probe->fmtcat_cb(probe, config, snapshot, features, delim);
+        }
+        probe++, mask <<= 1;
+    }
+}
+
+/**
+ * @brief   Write an image manifest for the node described by a snapshot
+ * @param   snapshot        pointer to the node_snapshot_t
+ * @param   config          the plugin configuration
+ * @param   manifest_file   the file to write
+ * @return  Boolean true if the manifest was written
+ */
+static bool
+node_snapshot_write_manifest(
+    node_snapshot_t     *snapshot,
+    cpuinfo_config_t    *config,
+    const char          *manifest_file
+)
+{
+    char                *features = NULL;
+    const char          *delim = "";
+    FILE                *fptr = fopen(manifest_file, "w");
+    bool                is_okay;
+    
+    if ( ! fptr ) {
+        error("node_snapshot_write_manifest: unable to create %s (errno = %d)", manifest_file, errno);
+        return false;
+    }
+    node_snapshot_fmtcat_subset(snapshot, config, false, &features, &delim);
+    fprintf(fptr, "# node_features/cpuinfo image manifest\nFingerprint=%016llx\nFeatures=%s\n",
+            (unsigned long long)snapshot->catalog.fingerprint, features ? features : "");
+    xfree(features);
+    is_okay = ( fclose(fptr) == 0 );
+    if ( is_okay ) info("node_snapshot_write_manifest: wrote %s", manifest_file);
+    return is_okay;
+}
+
+/**
+ * @brief   sysfs_write_fixture for a plain directory tree
+ * @details A file listing choices with the current one bracketed (e.g. the
+ *          transparent hugepage "always [madvise] never") gets the bracket
+ *          moved to the value written, as the kernel would show it; any
+ *          other file is written as-is.
+ */
+static bool
+sysfs_write_tree(
+    const char      *path,
+    const char      *value
+)
+{
+    char            line[256], out[256], *word, *saveptr = NULL;
+    size_t          value_len = strlen(value), n = 0;
+    bool            is_listed = false, is_okay;
+    FILE            *fptr;
+    
+    /* Like sysfs, never create a file: */
+    if ( access(path, W_OK) != 0 ) return false;
+    if ( strchr(value, ' ') || ! sysfs_read_str(path, line, sizeof(line)) || ! strchr(line, '[') ) line[0] = '\0';
+    for ( word = strtok_r(line, " ", &saveptr); word && (n < sizeof(out)); word = strtok_r(NULL, " ", &saveptr) ) {
+        size_t      word_len = strlen(word);
+        
+        if ( *word == '[' ) word++, word_len--;
+        if ( word_len && (word[word_len - 1] == ']') ) word_len--;
+        if ( (word_len == value_len) && ! strncmp(word, value, value_len) ) {
+            n += snprintf(out + n, sizeof(out) - n, "%s[%s]", n ? " " : "", value);
+            is_listed = true;
+        } else {
+            n += snprintf(out + n, sizeof(out) - n, "%s%.*s", n ? " " : "", (int)word_len, word);
         }
-        is_pci_inited = true;
-    }
-    //
-    // Iterate over display devices (class id 0x03):
-    //
-    match.vendor_id = PCI_MATCH_ANY;
-    match.device_id = PCI_MATCH_ANY;
-    match.subvendor_id = PCI_MATCH_ANY;
-    match.subdevice_id = PCI_MATCH_ANY;
-    match.device_class = device_class;
-    match.device_class_mask = device_class_mask;
-    match.match_data = 0;
-    iter = pci_id_match_iterator_create(&match);
-    while ((device = pci_device_next(iter)) != NULL) {
-        pci_vendor_devices_ptr  *by_vendor = vendor_devices;
-        bool                    is_found = false;
-        
-        while ( ! is_found && *by_vendor ) {
-            if ( (*by_vendor)->vendor_id == device->vendor_id ) {
-                pci_device_feature_t    *features = &(*by_vendor)->device_features[0];
+    }
+    if ( ! (fptr = fopen(path, "w")) ) return false;
+    is_okay = ( fprintf(fptr, "%s\n", is_listed ? out : value) > 0 );
+    if ( fclose(fptr) != 0 ) is_okay = false;
+    return is_okay;
+}
+
+/**
+ * @brief   llc_resctrl_backend_t group_create callback for a plain tree
+ * @details Creates the files resctrl would, so the sample tree (-r) can
+ *          stand in for /sys/fs/resctrl.
+ */
+static bool
+llc_resctrl_tree_group_create(
+    const char      *path
+)
+{
+    const char      *files[] = { "schemata", "tasks", NULL }, **f;
+    
+    if ( ! llc_resctrl_dev_group_create(path) ) return false;
+    for ( f = files; *f; f++ ) {
+        char        file[PATH_MAX];
+        int         fd;
+        
+        if ( (snprintf(file, sizeof(file), "%s/%s", path, *f) < sizeof(file)) && ((fd = open(file, O_WRONLY | O_CREAT | O_CLOEXEC, 0644)) >= 0) ) close(fd);
+    }
+    return true;
+}
+
+/**
+ * @brief   llc_resctrl_backend_t group_remove callback for a plain tree
+ * @details Removes the files resctrl would have discarded first.
+ */
+static bool
+llc_resctrl_tree_group_remove(
+    const char      *path
+)
+{
+    const char      *files[] = { "schemata", "tasks", NULL }, **f;
+    
+    for ( f = files; *f; f++ ) {
+        char        file[PATH_MAX];
+        
+        if ( snprintf(file, sizeof(file), "%s/%s", path, *f) < sizeof(file) ) unlink(file);
+    }
+    return llc_resctrl_dev_group_remove(path);
+}
+
+static const llc_resctrl_backend_t llc_resctrl_backend_tree = { llc_resctrl_tree_group_create, llc_resctrl_tree_group_remove };
+
+/*
+ * Main program for testing the cpuinfo-scanning code
+ */
+int
+main(
+    int                     argc,
+    char* const             argv[]
+)
+{
+    node_snapshot_t         snapshot;
+    cpuinfo_config_t        config;
+    node_modes_t            modes;
+    const char              *catalog_out = NULL, *manifest_out = NULL;
+    bool                    is_catalog_record = false, is_epilog = false;
+    int                     argi, opt;
+
+    cpuinfo_config_init(&config);
+    node_snapshot_init(&snapshot);
+    memset(&modes, 0, sizeof(modes));
+    while ( (opt = getopt(argc, argv, "b:c:em:pr:s:t:v")) != -1 ) {
+        switch ( opt ) {
+            case 'b':
+                catalog_out = optarg;
+                break;
+            case 'e':
+                is_epilog = true;
+                break;
+            case 'c':
+                if ( ! cpuinfo_config_parse_file(&config, optarg) ) return EINVAL;
+                break;
+            case 'm':
+                manifest_out = optarg;
+                break;
+            case 'p':
+                is_catalog_record = true;
+                break;
+            case 'r':
+                sysfs_root = optarg;
+                llc_resctrl_backend = &llc_resctrl_backend_tree;
+                sysfs_write_fixture = sysfs_write_tree;
+                break;
+            case 's': {
+                char        *avail = NULL, *current = NULL;
+                const char  *avail_delim = "", *current_delim = "";
                 
-                while ( features->device_id ) {
-                    if ( features->device_id == device->device_id ) {
-                        if ( ! feature_list || (strstr(feature_list, features->feature_name) == NULL) ) {
-                            xstrfmtcat(feature_list, "%s%s", delim, features->feature_name);
-                            delim = ",";
-                            is_found = true;
-                            break;
-                        }
-                    }
-                    features++;
+                /* Apply modes as node_set would, then show the result: */
+                if ( ! node_modes_validate(&config, optarg) || ! node_modes_apply(&modes, &config, optarg, NULL) ) return EINVAL;
+                node_modes_fmtcat(&config, &avail, &avail_delim, &current, &current_delim);
+                printf("modes:    available=%s active=%s\n", avail ? avail : "", current ? current : "");
+                xfree(avail);
+                xfree(current);
+                break;
+            }
+            case 't':
+                /* Record completed reboots as slurmd would at startup, then report the boot time: */
+                if ( config.reboot_history_file ) free((void*)config.reboot_history_file);
+                config.reboot_history_file = strdup(optarg);
+                node_mode_reboot_cache_clear();
+                reboot_history_complete(&config);
+                printf("boot time: %u s\n", node_modes_boot_time(&modes, &config));
+                break;
+            case 'v':
+                cpuinfo_log_debug = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s {-v} {-c <cpuinfo.conf>} {-r <sysfs-root>} {-s <active-features> ..} {-t <reboot-history-file>} {-p | -m <manifest-file>} <cpuinfo-file> {<cpuinfo-file> ..}\n"
+                                "       %s {-v} {-c <cpuinfo.conf>} {-r <sysfs-root>} -e {<cpuinfo-file>}\n"
+                                "       %s {-v} -b <catalog-file> <record-file> {<record-file> ..}\n", argv[0], argv[0], argv[0]);
+                return EINVAL;
+        }
+    }
+    if ( catalog_out ) {
+        bool                is_okay = catalog_build(catalog_out, argc - optind, argv + optind);
+        
+        cpuinfo_config_reset(&config);
+        return is_okay ? 0 : EINVAL;
+    }
+    if ( is_epilog ) {
+        char                *features = NULL, *published, *mode_avail = NULL;
+        const char          *delim = "", *avail_delim = "";
+        unsigned int        n_dropped;
+        bool                is_okay;
+        
+        /* Restore the node's own modes, as the Epilog does, then print its
+           active features as node_state would report them: */
+        is_okay = node_modes_apply(&modes, &config, "", NULL);
+        cpuinfo_file = ( optind < argc ) ? argv[optind] : NULL;
+        node_snapshot_load_manifest(&snapshot, &config);
+        node_snapshot_update(&snapshot, &config);
+        node_snapshot_fmtcat(&snapshot, &config, &features, &delim);
+        published = feature_policy_apply(&config, features, &n_dropped);
+        xfree(features);
+        delim = ( published && *published ) ? "," : "";
+        node_modes_fmtcat(&config, &mode_avail, &avail_delim, &published, &delim);
+        printf("%s\n", published ? published : "");
+        xfree(published);
+        xfree(mode_avail);
+        node_snapshot_reset(&snapshot);
+        cpuinfo_config_reset(&config);
+        return is_okay ? 0 : EINVAL;
+    }
+    if ( is_catalog_record && config.catalog_file ) {
+        /* Records must come from the costly probes themselves: */
+        free((void*)config.catalog_file);
+        config.catalog_file = NULL;
+    }
+    if ( (is_catalog_record || manifest_out) && config.manifest_file ) {
+        free((void*)config.manifest_file);
+        config.manifest_file = NULL;
+    }
+
+    for ( argi = optind; argi < argc; argi++ ) {
+        char                *features = NULL;
+        const char          *delim = "";
+        
+        cpuinfo_file = argv[argi];
+        node_snapshot_invalidate(&snapshot);
+        node_snapshot_load_manifest(&snapshot, &config);
+        node_snapshot_update(&snapshot, &config);
+        node_snapshot_fmtcat(&snapshot, &config, &features, &delim);
+        if ( config.perf_index && snapshot.perf.is_valid ) {
+            perf_component_t    c;
+            
+            for ( c = perf_component_START; c < perf_component_MAX; c++ ) {
+                info("%s: %s = %.6g (score %.3f)", argv[argi], perf_component_strings[c], snapshot.perf.value[c], snapshot.perf.score[c]);
+            }
+            info("%s: performance index %.3f", argv[argi], snapshot.perf.index);
+        }
+        if ( manifest_out ) {
+            bool            is_okay = node_snapshot_write_manifest(&snapshot, &config, manifest_out);
+            
+            xfree(features);
+            node_snapshot_reset(&snapshot);
+            cpuinfo_config_reset(&config);
+            return is_okay ? 0 : EINVAL;
+        }
+        if ( is_catalog_record ) {
+            xfree(features);
+            delim = "";
+            node_snapshot_fmtcat_subset(&snapshot, &config, true, &features, &delim);
+            printf("%016llx %s\n", (unsigned long long)snapshot.catalog.fingerprint, features ? features : "");
+        } else {
+            unsigned int    n_dropped;
+            char            *published = feature_policy_apply(&config, features, &n_dropped);
+            
+            if ( n_dropped ) info("%s: %u features dropped by policy", argv[argi], n_dropped);
+            printf("%s:    %s\n", argv[argi], published ? published : "");
+            xfree(published);
+        }
+        xfree(features);
+    }
+    node_snapshot_reset(&snapshot);
+    cpuinfo_config_reset(&config);
+    return 0;
+}
+
+#endif /* NODE_FEATURE_CPUINFO_NO_MAIN */
+#else
+
+const char plugin_name[]        = "node_features cpuinfo plugin";
+const char plugin_type[]        = "node_features/cpuinfo";
+const uint32_t plugin_version   = SLURM_VERSION_NUMBER;
+
+/* Configuration lock: */
+static pthread_mutex_t config_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#ifdef NODE_FEATURE_CPUINFO_LOCK_STATS
+/* Nanoseconds the calling thread has spent waiting for config_mutex: */
+static __thread uint64_t config_mutex_wait_ns = 0;
+#endif
+
+/**
+ * @brief   Acquire the configuration lock
+ * @details When built with NODE_FEATURE_CPUINFO_LOCK_STATS the time spent
+ *          waiting for the lock is added to the calling thread's
+ *          config_mutex_wait_ns.
+ */
+static void
+config_mutex_lock(void)
+{
+#ifdef NODE_FEATURE_CPUINFO_LOCK_STATS
+    struct timespec     t0, t1;
+    
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    slurm_mutex_lock(&config_mutex);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    config_mutex_wait_ns += (uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000 + t1.tv_nsec - t0.tv_nsec;
+#else
+    slurm_mutex_lock(&config_mutex);
+#endif
+}
+
+/**
+ * @brief   Release the configuration lock
+ */
+static void
+config_mutex_unlock(void)
+{
+    slurm_mutex_unlock(&config_mutex);
+}
+
+/* Configuration parameters: */
+static cpuinfo_config_t plugin_config;
+static node_snapshot_t node_snapshot;
+static unsigned int plugin_features_dropped = 0;
+static node_modes_t plugin_modes;
+static bool plugin_reboot_history_checked = false;
+
+
+/**
+ * @brief   (Re)load the plugin configuration file
+ * @details The cpuinfo.conf file is sought alongside slurm.conf; if it is
+ *          not present the default configuration is used.
+ */
+static void
+plugin_config_load(void)
+{
+    char    *conf_file = get_extra_conf_path("cpuinfo.conf");
+    
+    cpuinfo_config_reset(&plugin_config);
+    if ( ! cpuinfo_config_parse_file(&plugin_config, conf_file) ) {
+        error("%s: errors in %s, some settings ignored", plugin_type, conf_file);
+    }
+    xfree(conf_file);
+}
+
+/* Hotplug listener state: */
+static pthread_mutex_t hotplug_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool hotplug_is_running = false;
+static pthread_t hotplug_thread;
+static int hotplug_socket = -1;
+static int hotplug_stop_pipe[2] = { -1, -1 };
+
+/**
+ * @brief   Current CLOCK_MONOTONIC time in milliseconds
+ */
+static uint64_t
+hotplug_now_ms(void)
+{
+    struct timespec     ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief   Re-run the probes affected by a batch of hotplug events
+ * @details The node's features are compared before and after so that a
+ *          change in the hardware is logged; the refreshed features are
+ *          reported the next time slurmd queries the plugin.
+ * @param   subsystems  mask of node_uevent_subsystem_t values
+ */
+static void
+hotplug_reprobe(
+    unsigned int        subsystems
+)
+{
+    char                *before = NULL, *after = NULL;
+    const char          *delim = "";
+    
+    config_mutex_lock();
+    node_snapshot_fmtcat(&node_snapshot, &plugin_config, &before, &delim);
+    if ( node_snapshot_refresh(&node_snapshot, &plugin_config, subsystems) ) {
+        delim = "";
+        node_snapshot_fmtcat(&node_snapshot, &plugin_config, &after, &delim);
+        if ( strcmp(before ? before : "", after ? after : "") ) {
+            info("%s: hotplug event changed node features to %s", plugin_type, after ? after : "(none)");
+        } else {
+            debug("%s: hotplug event left node features unchanged", plugin_type);
+        }
+    }
+    config_mutex_unlock();
+    xfree(before);
+    xfree(after);
+}
+
+/**
+ * @brief   Body of the hotplug listener thread
+ * @details Kernel uevents are read from the netlink socket until the stop
+ *          pipe becomes readable.  Interesting events accumulate into a
+ *          pending subsystem mask that is acted on once no further event
+ *          has arrived for HotplugDebounceMS; a continuous stream of events
+ *          delays the re-probe by at most five debounce periods.  If the
+ *          socket's receive buffer overflowed, events were lost and every
+ *          hotplug-sensitive probe is refreshed.
+ * @param   arg     unused
+ * @return  Always @a NULL
+ */
+static void*
+hotplug_listener_thread(
+    void                *arg
+)
+{
+    unsigned int        pending = 0;
+    uint64_t            deadline = 0, latest = 0;
+    
+    while ( true ) {
+        struct pollfd   fds[2] = { { hotplug_stop_pipe[0], POLLIN, 0 }, { hotplug_socket, POLLIN, 0 } };
+        int             timeout = -1, rc;
+        uint64_t        now;
+        
+        if ( pending ) {
+            now = hotplug_now_ms();
+            timeout = ( deadline > now ) ? (int)(deadline - now) : 0;
+        }
+        rc = poll(fds, 2, timeout);
+        if ( rc < 0 ) {
+            if ( errno == EINTR ) continue;
+            error("%s: hotplug listener poll failed: %m", plugin_type);
+            break;
+        }
+        if ( fds[0].revents ) break;
+        if ( fds[1].revents & POLLIN ) {
+            char                msg[8192];
+            struct sockaddr_nl  sender;
+            socklen_t           sender_len = sizeof(sender);
+            ssize_t             msg_len = recvfrom(hotplug_socket, msg, sizeof(msg), MSG_DONTWAIT, (struct sockaddr*)&sender, &sender_len);
+            unsigned int        subsystems = 0;
+            
+            if ( msg_len < 0 ) {
+                if ( errno == ENOBUFS ) {
+                    debug("%s: hotplug listener overran, refreshing all hotplug probes", plugin_type);
+                    subsystems = node_uevent_subsystem_cpu | node_uevent_subsystem_pci;
                 }
             }
-            by_vendor++;
+            /* Only messages from the kernel itself (port id 0) are trusted: */
+            else if ( sender_len == sizeof(sender) && sender.nl_pid == 0 ) {
+                subsystems = uevent_message_subsystems(msg, msg_len);
+            }
+            if ( subsystems ) {
+                unsigned int    debounce_ms;
+                
+                config_mutex_lock();
+                debounce_ms = plugin_config.hotplug_debounce_ms;
+                config_mutex_unlock();
+                now = hotplug_now_ms();
+                if ( ! pending ) latest = now + 5 * (uint64_t)debounce_ms;
+                deadline = now + debounce_ms;
+                if ( deadline > latest ) deadline = latest;
+                pending |= subsystems;
+            }
+        }
+        if ( pending && (hotplug_now_ms() >= deadline) ) {
+            hotplug_reprobe(pending);
+            pending = 0;
         }
     }
-    pci_iterator_destroy(iter);
-    if ( out_features ) {
-        *out_features = feature_list;
-    } else {
-        xfree(feature_list);
-    }
-    return true;
+    return NULL;
 }
 
 /**
- * @var     nvidia_gpu_devices
- * @brief   The list of NVIDIA GPU devices that exist in this cluster
+ * @brief   Start the hotplug listener thread if it is not running
+ * @details The netlink socket is subscribed only to the kernel's uevent
+ *          multicast group.
  */
-static pci_vendor_devices_t     nvidia_gpu_devices = {
-            .vendor_id = 0x10de, .device_features = {
-            /* P100 PCI, 12GB  */ { .device_id = 0x15f7, .feature_name = "PCI::GPU::P100" },
-            /* V100 SXM2, 32GB */ { .device_id = 0x1db5, .feature_name = "PCI::GPU::V100" },
-            /* V100 PCI, 32GB  */ { .device_id = 0x1db6, .feature_name = "PCI::GPU::V100" },
-            /* T4              */ { .device_id = 0x1eb8, .feature_name = "PCI::GPU::T4"   },
-            /* A100 PCI, 80GB  */ { .device_id = 0x20b5, .feature_name = "PCI::GPU::A100" },
-            /* A40             */ { .device_id = 0x2235, .feature_name = "PCI::GPU::A40"  },
-                                  { .device_id = 0x0000, .feature_name = NULL             }
-    } };
+static void
+hotplug_listener_start(void)
+{
+    struct sockaddr_nl  addr;
+    
+    slurm_mutex_lock(&hotplug_mutex);
+    if ( hotplug_is_running ) goto done;
+    
+    hotplug_socket = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if ( hotplug_socket < 0 ) {
+        error("%s: unable to open uevent socket: %m", plugin_type);
+        goto done;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1;
+    if ( bind(hotplug_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0 ) {
+        error("%s: unable to bind uevent socket: %m", plugin_type);
+        goto fail;
+    }
+    if ( pipe(hotplug_stop_pipe) < 0 ) {
+        error("%s: unable to create hotplug listener pipe: %m", plugin_type);
+        goto fail;
+    }
+    fd_set_close_on_exec(hotplug_stop_pipe[0]);
+    fd_set_close_on_exec(hotplug_stop_pipe[1]);
+    if ( pthread_create(&hotplug_thread, NULL, hotplug_listener_thread, NULL) ) {
+        error("%s: unable to start hotplug listener thread", plugin_type);
+        close(hotplug_stop_pipe[0]);
+        close(hotplug_stop_pipe[1]);
+        hotplug_stop_pipe[0] = hotplug_stop_pipe[1] = -1;
+        goto fail;
+    }
+    hotplug_is_running = true;
+    debug("%s: hotplug listener started", plugin_type);
+    goto done;
     
+fail:
+    close(hotplug_socket);
+    hotplug_socket = -1;
+done:
+    slurm_mutex_unlock(&hotplug_mutex);
+}
+
 /**
- * @var     amd_gpu_devices
- * @brief   The list of AMD GPU devices that exist in this cluster
+ * @brief   Stop the hotplug listener thread if it is running
+ * @details Must not be called with config_mutex held since the thread
+ *          may be waiting on it.
  */
-static pci_vendor_devices_t     amd_gpu_devices = {
-            .vendor_id = 0x1002, .device_features = {
-            /* Mi50     */ { .device_id = 0x66a1, .feature_name = "PCI::GPU::MI50"  },
-            /* Mi100    */ { .device_id = 0x738c, .feature_name = "PCI::GPU::MI100" },
-                           { .device_id = 0x0000, .feature_name = NULL              }
-    } };
-    
+static void
+hotplug_listener_stop(void)
+{
+    slurm_mutex_lock(&hotplug_mutex);
+    if ( hotplug_is_running ) {
+        if ( write(hotplug_stop_pipe[1], "", 1) != 1 ) error("%s: unable to signal hotplug listener: %m", plugin_type);
+        pthread_join(hotplug_thread, NULL);
+        close(hotplug_stop_pipe[0]);
+        close(hotplug_stop_pipe[1]);
+        close(hotplug_socket);
+        hotplug_stop_pipe[0] = hotplug_stop_pipe[1] = hotplug_socket = -1;
+        hotplug_is_running = false;
+        debug("%s: hotplug listener stopped", plugin_type);
+    }
+    slurm_mutex_unlock(&hotplug_mutex);
+}
+
+/*
+ * Controller-side registry of the nodes that have reported our features:
+ */
+#define REGISTRY_MAX_NAMESPACES     (sizeof(cpuinfo_feature_namespaces) / sizeof(cpuinfo_feature_namespaces[0]))
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bitstr_t *registry_namespace_nodes[REGISTRY_MAX_NAMESPACES] = { NULL };  /**< per-namespace node bitmaps */
+static bitstr_t *registry_nodes = NULL;                                         /**< union of the namespace bitmaps */
+
 /**
- * @var     pci_known_devices
- * @brief   The list of PCI vendors (and their devices) that exist in this cluster
+ * @brief   Ensure a registry bitmap exists and spans every node
+ * @details Nodes may be added to the controller at runtime, so bitmaps
+ *          are grown to node_record_count as needed.
+ * @param   bitmap  pointer to the bitmap to allocate or resize
  */
-static pci_vendor_devices_ptr   pci_known_devices[] = {
-                                    &nvidia_gpu_devices,
-                                    &amd_gpu_devices,
-                                    NULL
-                                };
+static void
+registry_bitmap_fit(
+    bitstr_t    **bitmap
+)
+{
+    if ( ! *bitmap ) {
+        *bitmap = bit_alloc(node_record_count);
+    }
+    else if ( bit_size(*bitmap) != node_record_count ) {
+        *bitmap = bit_realloc(*bitmap, node_record_count);
+    }
+}
 
 /**
- * @var     pci_known_device_class
- * @brief   The PCI device class we're interested in iterating
+ * @brief   Note which of our namespaces a feature list contains
+ * @param   features        comma-separated list of features
+ * @param   has_namespace   set true for each namespace present, indexed
+ *                          like cpuinfo_feature_namespaces
  */
-static const uint32_t           pci_known_device_class = 0x030000;
+static void
+registry_namespaces_find(
+    const char  *features,
+    bool        *has_namespace
+)
+{
+    const char  *p = features ? features : "";
+    int         i;
+    
+    while ( *p ) {
+        const char  *e = p;
+        
+        while ( *e && (*e != ',') ) e++;
+        for ( i = 0; cpuinfo_feature_namespaces[i]; i++ ) {
+            if ( str_startswith(p, cpuinfo_feature_namespaces[i], e - p) ) {
+                has_namespace[i] = true;
+                break;
+            }
+        }
+        p = *e ? e + 1 : e;
+    }
+}
 
 /**
- * @var     pci_known_device_class_mask
- * @brief   The bitmask for PCI device class components we're
- *          interested in iterating
+ * @brief   Recompute the union of the namespace bitmaps
+ * @details Must be called with registry_mutex held.
  */
-static const uint32_t           pci_known_device_class_mask = 0xFF0000;
+static void
+registry_union(void)
+{
+    int         i;
+    
+    registry_bitmap_fit(&registry_nodes);
+    bit_clear_all(registry_nodes);
+    for ( i = 0; cpuinfo_feature_namespaces[i]; i++ ) {
+        registry_bitmap_fit(&registry_namespace_nodes[i]);
+        bit_or(registry_nodes, registry_namespace_nodes[i]);
+    }
+}
 
+/**
+ * @var     registry_node_count
+ * @brief   node_record_count when the registry was last filled from the
+ *          node records, -1 if it never was
+ */
+static int registry_node_count = -1;
 
+/**
+ * @brief   Fill the registry from every node record's active features
+ * @details slurmctld only calls node_update() when a node's active
+ *          features change, not when an unchanged node registers or its
+ *          state is recovered, so after a restart the registry would stay
+ *          empty.  It is therefore rebuilt from the node records on first
+ *          use and whenever the number of nodes changes; node_update()
+ *          then maintains it incrementally.  Must be called with
+ *          registry_mutex held (and slurmctld's node records readable).
+ */
+static void
+registry_fill(void)
+{
+    int                 i, j;
+#if SLURM_VERSION_NUMBER >= SLURM_VERSION_NUM(22,5,0)
+    node_record_t       *node_ptr;
+#else
+    struct node_record  *node_ptr;
 #endif
+    
+    if ( registry_node_count == node_record_count ) return;
+    for ( i = 0; cpuinfo_feature_namespaces[i]; i++ ) {
+        registry_bitmap_fit(&registry_namespace_nodes[i]);
+        bit_clear_all(registry_namespace_nodes[i]);
+    }
+#if SLURM_VERSION_NUMBER >= SLURM_VERSION_NUM(22,5,0)
+    for ( i = 0; (node_ptr = next_node(&i)); i++ ) {
+#else
+    for ( i = 0, node_ptr = node_record_table_ptr; i < node_record_count; i++, node_ptr++ ) {
+#endif
+        bool            has_namespace[REGISTRY_MAX_NAMESPACES] = { false };
+        
+        registry_namespaces_find(node_ptr->features_act, has_namespace);
+        for ( j = 0; cpuinfo_feature_namespaces[j]; j++ ) if ( has_namespace[j] ) bit_set(registry_namespace_nodes[j], i);
+    }
+    registry_union();
+    registry_node_count = node_record_count;
+    debug("%s: registry filled from %d node records, %d report our features", plugin_type, node_record_count, bit_set_count(registry_nodes));
+}
 
-
-#ifdef NODE_FEATURE_CPUINFO_TESTING
-
-/*
- * Main program for testing the cpuinfo-scanning code
+/**
+ * @brief   Record which of our namespaces a set of nodes now reports
+ * @details Each namespace's bitmap gains @a node_bitmap if @a features
+ *          contains a feature in that namespace and loses it otherwise;
+ *          the union of all namespaces is then recomputed.  Must be
+ *          called with registry_mutex held.
+ * @param   features        comma-separated list of the nodes' features
+ * @param   node_bitmap     the nodes concerned
  */
-int
-main(
-    int         argc,
-    const char* argv[]
+static void
+registry_update(
+    const char  *features,
+    bitstr_t    *node_bitmap
 )
 {
-    cpuinfo_features_t  cif;
-    int                 argi = 1;
-    char                *pci_features = NULL;
-
-#ifdef HAVE_PCI_DETECTION
-    pci_device_lookup(pci_known_devices, pci_known_device_class, pci_known_device_class_mask, &pci_features);
-#endif
-
-    while ( argi < argc ) {
-        cpuinfo_features_init(&cif);
-        cpuinfo_parse_file(&cif, argv[argi]);
-        printf("%s:    %s%s", argv[argi], pci_features?pci_features:"", pci_features?",":"");
-        cpuinfo_features_summarize(&cif);
-        cpuinfo_features_reset(&cif);
-        argi++;
+    bool        has_namespace[REGISTRY_MAX_NAMESPACES] = { false };
+    int         i;
+    
+    registry_fill();
+    registry_namespaces_find(features, has_namespace);
+    for ( i = 0; cpuinfo_feature_namespaces[i]; i++ ) {
+        registry_bitmap_fit(&registry_namespace_nodes[i]);
+        if ( has_namespace[i] ) {
+            bit_or(registry_namespace_nodes[i], node_bitmap);
+        } else {
+            bit_and_not(registry_namespace_nodes[i], node_bitmap);
+        }
     }
-    return 0;
+    registry_union();
 }
 
-#else
-
-#include "slurm/slurm.h"
-
-#include "src/common/assoc_mgr.h"
-#include "src/common/bitstring.h"
-#include "src/common/fd.h"
-#include "src/common/gres.h"
-#include "src/common/list.h"
-#include "src/common/macros.h"
-#include "src/common/node_conf.h"
-#include "src/common/pack.h"
-#include "src/common/parse_config.h"
-#include "src/common/read_config.h"
-#include "src/common/slurm_protocol_api.h"
-#include "src/common/timers.h"
-#include "src/common/uid.h"
-#include "src/common/xmalloc.h"
-#include "src/common/xstring.h"
-#include "src/slurmctld/job_scheduler.h"
-#include "src/slurmctld/locks.h"
-#include "src/slurmctld/node_scheduler.h"
-#include "src/slurmctld/reservation.h"
-#include "src/slurmctld/slurmctld.h"
-#include "src/slurmctld/state_save.h"
-#include "src/slurmd/slurmd/req.h"
-
-const char plugin_name[]        = "node_features cpuinfo plugin";
-const char plugin_type[]        = "node_features/cpuinfo";
-const uint32_t plugin_version   = SLURM_VERSION_NUMBER;
+/**
+ * @brief   Dispose of every registry bitmap
+ */
+static void
+registry_reset(void)
+{
+    int         i;
+    
+    slurm_mutex_lock(&registry_mutex);
+    for ( i = 0; i < REGISTRY_MAX_NAMESPACES; i++ ) FREE_NULL_BITMAP(registry_namespace_nodes[i]);
+    FREE_NULL_BITMAP(registry_nodes);
+    registry_node_count = -1;
+    slurm_mutex_unlock(&registry_mutex);
+}
 
-/* Configuration lock: */
-static pthread_mutex_t config_mutex = PTHREAD_MUTEX_INITIALIZER;
+/**
+ * @brief   Longest fini() waits for helper threads, milliseconds
+ */
+#define PLUGIN_FINI_WAIT_MS         10000
 
-/* Configuration parameters: */
-static bool is_node_features_inited = false;
-static cpuinfo_features_t node_features;
+/**
+ * @brief   Wait for the plugin's detached helper threads to finish
+ * @details Probe helpers abandoned after ProbeTimeoutMS and a MODE::MEMCLEAN
+ *          helper that outlived MemCleanBudgetMS run code in this plugin,
+ *          so they must be gone before it is unloaded.  The wait is
+ *          bounded by @a timeout_ms; helpers still running afterwards are
+ *          logged and fini() keeps the plugin loaded for them.
+ * @param   timeout_ms  longest time to wait
+ * @return  Boolean true if no helper is running
+ */
+static bool
+plugin_helpers_wait(
+    unsigned int        timeout_ms
+)
+{
+    struct timespec     pause = { 0, 10000000 };
+    unsigned int        orphans, waited_ms = 0;
+    bool                is_memclean_running;
+    node_probe_t        *probe = node_probes;
+    
+    while ( true ) {
+        pthread_mutex_lock(&node_probe_orphans_mutex);
+        orphans = node_probe_orphans;
+        pthread_mutex_unlock(&node_probe_orphans_mutex);
+        pthread_mutex_lock(&memclean_running_mutex);
+        is_memclean_running = memclean_is_running;
+        pthread_mutex_unlock(&memclean_running_mutex);
+        if ( ! orphans && ! is_memclean_running ) return true;
+        if ( waited_ms >= timeout_ms ) break;
+        nanosleep(&pause, NULL);
+        waited_ms += 10;
+    }
+    while ( probe->name ) {
+        if ( orphans & (1 << (probe - node_probes)) ) error("%s: %s probe still running after %u ms", plugin_type, probe->name, timeout_ms);
+        probe++;
+    }
+    if ( is_memclean_running ) error("%s: MODE::MEMCLEAN helper still running after %u ms", plugin_type, timeout_ms);
+    return false;
+}
 
+/**
+ * @brief   Keep the plugin mapped after slurmd unloads it
+ * @details A helper still blocked in a probe or a MODE::MEMCLEAN pass would
+ *          otherwise return into unmapped code.  Reopening the plugin with
+ *          RTLD_NODELETE makes slurmd's dlclose() leave it in memory; the
+ *          helpers work on private copies, so the plugin state can still be
+ *          released.
+ */
+static void
+plugin_pin(void)
+{
+    Dl_info             dl_info;
+    
+    if ( ! dladdr((void*)plugin_pin, &dl_info) || ! dl_info.dli_fname || ! dlopen(dl_info.dli_fname, RTLD_NOW | RTLD_NOLOAD | RTLD_NODELETE) ) {
+        error("%s: unable to keep the plugin loaded, slurmd may crash when a helper returns", plugin_type);
+        return;
+    }
+    info("%s: plugin kept loaded until slurmd exits for the running helpers", plugin_type);
+}
 
 /**
  * @brief   Load plugin
@@ -1108,6 +9054,12 @@ extern int
 init(void)
 {
     debug("init");
+    config_mutex_lock();
+    cpuinfo_config_init(&plugin_config);
+    node_snapshot_init(&node_snapshot);
+    plugin_config_load();
+    node_snapshot_load_manifest(&node_snapshot, &plugin_config);
+    config_mutex_unlock();
     return SLURM_SUCCESS;
 }
 
@@ -1120,10 +9072,11 @@ extern int
 fini(void)
 {
     debug("fini");
-    if ( is_node_features_inited ) {
-        cpuinfo_features_reset(&node_features);
-        is_node_features_inited = false;
-    }
+    hotplug_listener_stop();
+    if ( ! plugin_helpers_wait(PLUGIN_FINI_WAIT_MS) ) plugin_pin();
+    registry_reset();
+    node_snapshot_reset(&node_snapshot);
+    cpuinfo_config_reset(&plugin_config);
 	return SLURM_SUCCESS;
 }
 
@@ -1134,13 +9087,18 @@ fini(void)
 extern int
 node_features_p_reconfig(void)
 {
+    bool    hotplug_listener;
+    
     debug("node_features_p_reconfig");
-	slurm_mutex_lock(&config_mutex);
-    if ( is_node_features_inited ) {
-        cpuinfo_features_reset(&node_features);
-        is_node_features_inited = false;
-    }
-	slurm_mutex_unlock(&config_mutex);
+	config_mutex_lock();
+    plugin_config_load();
+    node_snapshot_invalidate(&node_snapshot);
+    node_snapshot_load_manifest(&node_snapshot, &plugin_config);
+    node_mode_reboot_cache_clear();
+    hotplug_listener = plugin_config.hotplug_listener;
+	config_mutex_unlock();
+    /* Started on the next node_state call in slurmd: */
+    if ( ! hotplug_listener ) hotplug_listener_stop();
 	return SLURM_SUCCESS;
 }
 
@@ -1174,32 +9132,29 @@ node_features_p_node_state(
     char    **current_mode
 )
 {
+    bool    hotplug_listener;
+    
     if ( ! avail_modes || ! current_mode ) return;
     
     debug("node_features_p_node_state: avail_modes = %s", *avail_modes ? *avail_modes : "(null)");
     debug("node_features_p_node_state: current_mode = %s", *current_mode ? *current_mode : "(null)");
     
-	slurm_mutex_lock(&config_mutex);
-    if ( ! is_node_features_inited ) {
-        cpuinfo_features_init(&node_features);
-        is_node_features_inited = cpuinfo_parse_file(&node_features, "/proc/cpuinfo");
+	config_mutex_lock();
+    if ( ! plugin_reboot_history_checked ) {
+        reboot_history_complete(&plugin_config);
+        plugin_reboot_history_checked = true;
     }
-    if ( is_node_features_inited ) {
-        unsigned int        i = cpuinfo_flags_START, mask = 1;
-        char                *add_features = NULL;
+    if ( node_snapshot_update(&node_snapshot, &plugin_config) ) {
+        char                *add_features = NULL, *all_features = NULL;
         const char          *delim = "";
+        unsigned int        n_dropped;
         
-#ifdef HAVE_PCI_DETECTION
-        if ( pci_device_lookup(pci_known_devices, pci_known_device_class, pci_known_device_class_mask, &add_features) ) {
-            if ( add_features && *add_features ) delim = ",";
-        }
-#endif
-        if ( node_features.vendor_id ) xstrfmtcat(add_features, "%sVENDOR::%s", delim, node_features.vendor_id), delim = ",";
-        if ( node_features.model_name ) xstrfmtcat(add_features, "%sMODEL::%s", delim, node_features.model_name), delim = ",";
-        if ( node_features.model_name ) xstrfmtcat(add_features, "%sCACHE::%uKB", delim, node_features.cache_kb), delim = ",";
-        while ( i < cpuinfo_flags_MAX ) {
-            if ( (node_features.flags & mask) == mask ) xstrfmtcat(add_features, "%sISA::%s", delim, cpuinfo_flags_strings[i]), delim = ",";
-            i++, mask <<= 1;
+        node_snapshot_fmtcat(&node_snapshot, &plugin_config, &all_features, &delim);
+        add_features = feature_policy_apply(&plugin_config, all_features, &n_dropped);
+        xfree(all_features);
+        if ( n_dropped != plugin_features_dropped ) {
+            info("%s: feature policy drops %u features", plugin_type, n_dropped);
+            plugin_features_dropped = n_dropped;
         }
         if ( add_features && *add_features ) {
             if ( *avail_modes ) {
@@ -1215,20 +9170,52 @@ node_features_p_node_state(
             xfree(add_features);
         }
     }
-	slurm_mutex_unlock(&config_mutex);
+    {
+        char                *mode_avail = NULL, *mode_current = NULL;
+        const char          *avail_delim = "", *current_delim = "";
+        
+        node_modes_fmtcat(&plugin_config, &mode_avail, &avail_delim, &mode_current, &current_delim);
+        if ( mode_avail ) {
+            if ( *avail_modes ) {
+                xstrfmtcat(*avail_modes, ",%s", mode_avail);
+            } else {
+                *avail_modes = xstrdup(mode_avail);
+            }
+            xfree(mode_avail);
+        }
+        if ( mode_current ) {
+            if ( *current_mode ) {
+                xstrfmtcat(*current_mode, ",%s", mode_current);
+            } else {
+                *current_mode = xstrdup(mode_current);
+            }
+            xfree(mode_current);
+        }
+    }
+    hotplug_listener = plugin_config.hotplug_listener;
+	config_mutex_unlock();
+    
+    /* Only slurmd calls node_state, so the listener never runs in slurmctld: */
+    if ( hotplug_listener ) hotplug_listener_start();
 }
 
 /**
  * @brief   Is a job's feature specification valid?
  * @details This is NOT a check of whether or not the features are acceptable
- *          on the slurmd node itself, just a semantic check
+ *          on the slurmd node itself, just a semantic check:  any MODE::
+ *          features must be allowed and must not conflict.
  * @param   job_features    the list of requested features
  * @return  SLURM_SUCCESS if the list is acceptable, an error code otherwise
  */
 extern int node_features_p_job_valid(char *job_features)
 {
-    debug("node_features_p_job_valid");
-    return SLURM_SUCCESS;
+    bool    is_valid;
+    
+    debug("node_features_p_job_valid: job_features = %s", job_features ? job_features : "(null)");
+    config_mutex_lock();
+    is_valid = node_modes_validate(&plugin_config, job_features);
+    config_mutex_unlock();
+    return is_valid ? SLURM_SUCCESS : ESLURM_INVALID_FEATURE;
 }
 
 /**
@@ -1242,51 +9229,51 @@ node_features_p_job_xlate(
     char    *job_features
 )
 {
-    char    *out_features = NULL;
-    
     debug("node_features_p_job_xlate: job_features = %s", job_features ? job_features : "(null)");
-	if ( job_features && *job_features ) {
-        char    *copy = xstrdup(job_features),
-                *tokarg1 = copy, *tokptr, *save_ptr = NULL,
-                *delim = "";
-                
-        while ( (tokptr = strtok_r(tokarg1, "&", &save_ptr)) ) {
-            /* Reset tokarg1 to continue in the current string on subsequent iterations: */
-            tokarg1 = NULL;
-            
-            if ( cpuinfo_features_is_str_ours(tokptr, -1) ) xstrfmtcat(out_features, "%s%s", delim, tokptr), delim = ",";
-        }
-        if ( ! out_features ) {
-            out_features = copy;
-        } else {
-            xfree(copy);
-        }
-    }
-	return out_features;
+	return cpuinfo_job_features_xlate(job_features);
 }
 
 /**
  * @brief   Update node's active configuration based upon features in job
  *          constraints.
- * @details Executed by the slurmd daemon.
+ * @details Executed by the slurmd daemon.  Slurm has no matching call at job
+ *          end and only calls this when a job asks for features the node
+ *          does not have active, so every call runs the restore pass:  a
+ *          mode an earlier job changed stays in effect (for jobs that name
+ *          no mode, too) until a call that does not request it.
  * @param   active_features     the list of features required by a job
  * @return  SLURM_SUCCESS or an error code
  */
 extern int node_features_p_node_set(char *active_features)
 {
+    bool            is_okay;
+    unsigned int    subsystems;
+    
     debug("node_features_p_node_set: active_features = %s", active_features ? active_features : "(null)");
-    return SLURM_SUCCESS;
+    config_mutex_lock();
+    is_okay = node_modes_apply(&plugin_modes, &plugin_config, active_features, &subsystems);
+    /* Topology features (e.g. after an SMT change) are refreshed at once: */
+    if ( subsystems ) node_snapshot_refresh(&node_snapshot, &plugin_config, subsystems);
+    config_mutex_unlock();
+    return is_okay ? SLURM_SUCCESS : SLURM_ERROR;
 }
 
 /**
  * @brief   Does this plugin require PowerSave mode for booting nodes?
+ * @details Only if RebootPowerSave is set, for sites whose reboot modes
+ *          need a power cycle rather than a warm reboot.
  * @return  Returns boolean true if PowerSave mode is needed, false
  *          otherwise
  */
 extern bool
 node_features_p_node_power(void)
 {
-	return false;
+    bool    node_power;
+    
+    config_mutex_lock();
+    node_power = plugin_config.reboot_power_save;
+    config_mutex_unlock();
+	return node_power;
 }
 
 /**
@@ -1304,6 +9291,11 @@ node_features_p_node_update(
 )
 {
     debug("node_features_p_node_update: active_features = %s", active_features ? active_features : "(null)");
+    if ( node_bitmap ) {
+        slurm_mutex_lock(&registry_mutex);
+        registry_update(active_features, node_bitmap);
+        slurm_mutex_unlock(&registry_mutex);
+    }
     return SLURM_SUCCESS;
 }
 
@@ -1321,17 +9313,24 @@ node_features_p_node_update_valid(
 	update_node_msg_t   *update_node_msg
 )
 {
+    bool                is_valid;
+    
     debug("node_features_p_node_update_valid: node_names=%s, features=%s, features_act=%s",
                 update_node_msg->node_names ? update_node_msg->node_names : "(null)",
                 update_node_msg->features ? update_node_msg->features : "(null)",
                 update_node_msg->features_act ? update_node_msg->features_act : "(null)");
-    return false;
+    config_mutex_lock();
+    is_valid = node_modes_validate(&plugin_config, update_node_msg->features) && node_modes_validate(&plugin_config, update_node_msg->features_act);
+    config_mutex_unlock();
+    return is_valid;
 }
 
 /**
- * @brief   Is a feature name associated with this plugin?
+ * @brief   Can a feature be changed by node_set?
+ * @details Only the MODE:: features are; the rest describe hardware, and
+ *          the controller must never schedule a reboot to "change" them.
  * @param   feature     a feature name string
- * @result  Returns boolean true if @feature is owned by us
+ * @result  Returns boolean true if @feature is a MODE:: feature
  */
 extern bool
 node_features_p_changible_feature(
@@ -1339,7 +9338,7 @@ node_features_p_changible_feature(
 )
 {
     debug("node_features_p_changible_feature: feature = %s", feature ? feature : "(null)");
-	return cpuinfo_features_is_str_ours(feature, -1);
+	return ( feature && str_startswith(feature, "MODE::", -1) );
 }
 
 /**
@@ -1360,45 +9359,10 @@ node_features_p_node_xlate(
 	char        *avail_features
 )
 {
-    char        *out_features = NULL;
-    
     debug("node_features_p_node_xlate: new_features = %s", new_features ? new_features : "(null)");
     debug("node_features_p_node_xlate: orig_features = %s", orig_features ? orig_features : "(null)");
     debug("node_features_p_node_xlate: avail_features = %s", avail_features ? avail_features : "(null)");
-    
-    /* Short-circuit, no union necessary: */
-    if ( ! new_features || ! *new_features ) {
-        out_features = xstrdup(orig_features);
-    }
-    else if ( ! orig_features || ! *orig_features ) {
-        out_features = xstrdup(new_features);
-    }
-    else {
-        char    *tokptr, *saveptr = NULL, *delim = "";
-        char    *orig_copy, *tokarg1;
-        
-        /* Produce    new_features U (orig_features - our_features): */
-        out_features = xstrdup(new_features);
-        if ( *out_features ) delim = ",";
-        
-        orig_copy = xstrdup(orig_features);
-        tokarg1 = orig_copy;
-        while ( (tokptr = strtok_r(tokarg1, ",", &saveptr)) ) {
-            /* Reset tokarg1 to continue in the current string on subsequent iterations: */
-            tokarg1 = NULL;
-            
-            /* Only add those which don't belong to us: */
-            if ( ! cpuinfo_features_is_str_ours(tokptr, -1) ) {
-                /* Ensure it's not already in the list: */
-                if ( ! __contains_str(out_features, tokptr, ",") ) {
-                    xstrfmtcat(out_features, "%s%s", delim, tokptr);
-                    delim = ",";
-                }
-            }
-        }
-        xfree(orig_copy);
-    }
-    return out_features;
+    return cpuinfo_node_features_xlate(new_features, orig_features, avail_features);
 }
 
 /**
@@ -1421,6 +9385,12 @@ node_features_p_node_xlate2(
 
 /**
  * @brief   Perform set up for step launch
+ * @details Executed by slurmstepd before it starts the step's tasks.  When
+ *          MODE::LLC::exclusive is in effect slurmstepd joins the mode's
+ *          resctrl group, so the tasks it forks inherit the reserved ways.
+ *          Neither node_set nor this call is told which job it serves, so
+ *          every step on the node joins the group:  the mode is only
+ *          meaningful for jobs allocated whole nodes (--exclusive).
  * @param   mem_sort    trigger sort of memory pages (KNL zonesort)
  * @param   numa_bitmap NUMA nodes allocated to this job
  */
@@ -1430,12 +9400,18 @@ node_features_p_step_config(
     bitstr_t    *numa_bitmap
 )
 {
-    /* Unused by this plugin */
+    char        path[PATH_MAX], pid[32];
+    
+    if ( ! sysfs_path(path, sizeof(path), "/sys/fs/resctrl/" LLC_RESCTRL_GROUP "/tasks") || (access(path, W_OK) != 0) ) return;
+    snprintf(pid, sizeof(pid), "%ld", (long)getpid());
+    if ( ! sysfs_write_str(path, pid) ) error("%s: unable to join resctrl group %s", plugin_type, LLC_RESCTRL_GROUP);
 }
 
 /**
  * @brief   Determine if the specified user can modify the currently available node
  *          features
+ * @details root and SlurmUser always may; other users must be listed in
+ *          AllowedUsers.
  * @param   uid     the uid to test
  * @return  Boolean true if the user is allowed to reconfigure the node
  */
@@ -1444,19 +9420,42 @@ node_features_p_user_update(
     uid_t       uid
 )
 {
+    bool        is_allowed = false;
+    
     debug("node_features_p_user_update = %d", (int)uid);
-    /* No reconfiguration is ever necessary */
-    return false;
+    if ( (uid == 0) || (uid == slurm_get_slurm_user_id()) ) return true;
+    config_mutex_lock();
+    if ( plugin_config.mode_users && *plugin_config.mode_users ) {
+        char    *user = uid_to_string(uid);
+        size_t  user_len = strlen(user);
+        const char  *list = plugin_config.mode_users, *name;
+        size_t  name_len;
+        
+        while ( ! is_allowed && (name = feature_list_next(&list, &name_len)) ) {
+            is_allowed = ( (name_len == user_len) && ! strncmp(name, user, name_len) );
+        }
+        xfree(user);
+    }
+    config_mutex_unlock();
+    return is_allowed;
 }
 
 /**
  * @brief   Return estimated reboot time, in seconds
+ * @details The time reported is the slowest allowed mode transition
+ *          (measured where possible); a reboot mode counts its whole
+ *          reboot.
  */
 extern uint32_t
 node_features_p_boot_time(void)
 {
+    uint32_t    boot_time;
+    
     debug("node_features_p_boot_time");
-	return 0;
+    config_mutex_lock();
+    boot_time = node_modes_boot_time(&plugin_modes, &plugin_config);
+    config_mutex_unlock();
+	return boot_time;
 }
 
 #if SLURM_VERSION_NUMBER > SLURM_VERSION_NUM(18,0,0)
@@ -1478,6 +9477,8 @@ node_features_p_changeable_feature(
 /**
  * @brief   Construct a node bitmap indicating on which nodes this
  *          plugin functions
+ * @details Only nodes whose active features include at least one of ours
+ *          are included.
  * @return  A Slurm bitstr with applicable node indices bits set
  *          (caller is reponsible for xfree-ing it)
  */
@@ -1485,24 +9486,68 @@ extern bitstr_t*
 node_features_p_get_node_bitmap(void)
 {
 	bitstr_t *bitmap;
-	bitmap = bit_alloc(node_record_count);
-	bit_set_all(bitmap);
+    
+    slurm_mutex_lock(&registry_mutex);
+    registry_fill();
+	bitmap = bit_copy(registry_nodes);
+    slurm_mutex_unlock(&registry_mutex);
 	return bitmap;
 }
 
+/**
+ * @brief   Count the nodes in a bitmap on which this plugin functions
+ * @param   active_bitmap   the nodes to consider
+ * @return  The number of nodes in @a active_bitmap that have reported at
+ *          least one of our features
+ */
 extern int
 node_features_p_overlap(
     bitstr_t    *active_bitmap
 )
 {
-    /* Executed on slurmctld and not used by this plugin */
-    return bit_set_count(active_bitmap);
+    int         count;
+    
+    slurm_mutex_lock(&registry_mutex);
+    registry_fill();
+    count = bit_overlap(active_bitmap, registry_nodes);
+    slurm_mutex_unlock(&registry_mutex);
+    return count;
 }
 
+/**
+ * @brief   Node weight applied while a node is rebooting for a mode
+ * @return  The configured RebootWeight
+ */
 extern uint32_t
 node_features_p_reboot_weight(void)
 {
-        return 0;
+    uint32_t    reboot_weight;
+    
+    config_mutex_lock();
+    reboot_weight = plugin_config.reboot_weight;
+    config_mutex_unlock();
+    return reboot_weight;
+}
+
+/**
+ * @brief   Append a name-value pair to a configuration list
+ * @param   data    the list of config_key_pair_t
+ * @param   name    the configuration key
+ * @param   value   the value (allocated with a Slurm xmalloc etc.); ownership
+ *                  passes to the list
+ */
+static void
+plugin_config_key_pair_append(
+    List        data,
+    const char  *name,
+    char        *value
+)
+{
+    config_key_pair_t   *key_pair = xmalloc(sizeof(config_key_pair_t));
+    
+    key_pair->name = xstrdup(name);
+    key_pair->value = value;
+    list_append(data, key_pair);
 }
 
 /* Get node features plugin configuration */
@@ -1511,6 +9556,63 @@ node_features_p_get_config(
     config_plugin_params_t  *p
 )
 {
+    perf_component_t        c;
+    char                    *value = NULL, *name = NULL;
+    const char              *delim = "";
+    unsigned int            i;
+    
+    xassert(p);
+    xstrcat(p->name, plugin_type);
+    
+	config_mutex_lock();
+    plugin_config_key_pair_append(p->key_pairs, "PerfIndex", xstrdup(plugin_config.perf_index ? "yes" : "no"));
+    for ( c = perf_component_START; c < perf_component_MAX; c++ ) {
+        name = xstrdup_printf("PerfReference%s", perf_component_strings[c]);
+        plugin_config_key_pair_append(p->key_pairs, name, xstrdup_printf("%g", plugin_config.perf_reference[c]));
+        xfree(name);
+    }
+    for ( i = 0; i < plugin_config.perf_tiers.count; i++ ) {
+        xstrfmtcat(value, "%s%g", delim, plugin_config.perf_tiers.value[i]), delim = ",";
+    }
+    plugin_config_key_pair_append(p->key_pairs, "PerfTiers", value);
+    if ( node_snapshot.perf.is_valid ) {
+        for ( c = perf_component_START; c < perf_component_MAX; c++ ) {
+            name = xstrdup_printf("PerfScore%s", perf_component_strings[c]);
+            plugin_config_key_pair_append(p->key_pairs, name, xstrdup_printf("%.3f", node_snapshot.perf.score[c]));
+            xfree(name);
+        }
+        plugin_config_key_pair_append(p->key_pairs, "PerfScore", xstrdup_printf("%.3f", node_snapshot.perf.index));
+    }
+    plugin_config_key_pair_append(p->key_pairs, "EdacCeThreshold", xstrdup_printf("%u", plugin_config.edac_ce_threshold));
+    plugin_config_key_pair_append(p->key_pairs, "FeatureAllow", xstrdup(plugin_config.feature_allow ? plugin_config.feature_allow : "(null)"));
+    plugin_config_key_pair_append(p->key_pairs, "FeatureDeny", xstrdup(plugin_config.feature_deny ? plugin_config.feature_deny : "(null)"));
+    plugin_config_key_pair_append(p->key_pairs, "FeatureMax", xstrdup_printf("%u", plugin_config.feature_max));
+    plugin_config_key_pair_append(p->key_pairs, "IsaHighestOnly", xstrdup(plugin_config.isa_highest_only ? "yes" : "no"));
+    plugin_config_key_pair_append(p->key_pairs, "FeaturesDropped", xstrdup_printf("%u", plugin_features_dropped));
+    plugin_config_key_pair_append(p->key_pairs, "ManifestFile", xstrdup(plugin_config.manifest_file ? plugin_config.manifest_file : "(null)"));
+    plugin_config_key_pair_append(p->key_pairs, "HwlocXmlFile", xstrdup(plugin_config.hwloc_xml_file ? plugin_config.hwloc_xml_file : "(null)"));
+    plugin_config_key_pair_append(p->key_pairs, "CatalogFile", xstrdup(plugin_config.catalog_file ? plugin_config.catalog_file : "(null)"));
+    value = NULL, delim = "";
+    for ( i = 0; i < plugin_config.power_cap_tiers.count; i++ ) {
+        xstrfmtcat(value, "%s%g", delim, plugin_config.power_cap_tiers.value[i]), delim = ",";
+    }
+    plugin_config_key_pair_append(p->key_pairs, "PowerCapTiers", value);
+    plugin_config_key_pair_append(p->key_pairs, "AllowedModes", xstrdup(plugin_config.mode_allow ? plugin_config.mode_allow : "(null)"));
+    plugin_config_key_pair_append(p->key_pairs, "AllowedUsers", xstrdup(plugin_config.mode_users ? plugin_config.mode_users : "(null)"));
+    plugin_config_key_pair_append(p->key_pairs, "LlcWays", xstrdup_printf("%u", plugin_config.llc_ways));
+    plugin_config_key_pair_append(p->key_pairs, "LlcMbaPercent", xstrdup_printf("%u", plugin_config.llc_mba_percent));
+    plugin_config_key_pair_append(p->key_pairs, "MemCleanBudgetMS", xstrdup_printf("%u", plugin_config.memclean_budget_ms));
+    plugin_config_key_pair_append(p->key_pairs, "ModeStateFile", xstrdup(plugin_config.mode_state_file ? plugin_config.mode_state_file : "(null)"));
+    plugin_config_key_pair_append(p->key_pairs, "RebootCommand", xstrdup(plugin_config.reboot_command ? plugin_config.reboot_command : "(null)"));
+    plugin_config_key_pair_append(p->key_pairs, "RebootHistoryFile", xstrdup(plugin_config.reboot_history_file ? plugin_config.reboot_history_file : "(null)"));
+    plugin_config_key_pair_append(p->key_pairs, "RebootPowerSave", xstrdup(plugin_config.reboot_power_save ? "yes" : "no"));
+    plugin_config_key_pair_append(p->key_pairs, "RebootTime", xstrdup_printf("%u", plugin_config.reboot_time));
+    plugin_config_key_pair_append(p->key_pairs, "RebootWeight", xstrdup_printf("%u", plugin_config.reboot_weight));
+    plugin_config_key_pair_append(p->key_pairs, "FsPaths", xstrdup(plugin_config.fs_paths ? plugin_config.fs_paths : "(null)"));
+    if ( node_snapshot.rapl.pkg_cap_uw ) {
+        plugin_config_key_pair_append(p->key_pairs, "PowerCapW", xstrdup_printf("%g", 1e-6 * node_snapshot.rapl.pkg_cap_uw));
+    }
+	config_mutex_unlock();
 }
 
 #endif
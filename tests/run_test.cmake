@@ -0,0 +1,77 @@
+#
+# Run a test program and compare what it prints with the expected output.
+#
+#   cmake [-D<variable>=<value> ..] -P run_test.cmake -- <command> {<argument> ..}
+#
+# Variables:
+#
+#   EXPECTED        file holding the expected standard output
+#   OUTPUT          file in which to save the standard output
+#   SCRATCH_FROM    tree copied to SCRATCH before the run...
+#   SCRATCH         ...so the command may modify it
+#   SCRATCH_REMOVE  paths, relative to SCRATCH, removed from the copy
+#   SEED_FROM       template copied to SEED before the run, with @HOST@
+#   SEED            replaced by the host name and @THEN@ by the epoch time
+#   SEED_AGE        seconds before now that @THEN@ stands for (default 0)
+#   RESULT          file the command is expected to have written...
+#   RESULT_REGEX    ...whose content must match this regular expression
+#
+# The command runs in the current directory, so relative paths (which the
+# test program prints) do not depend on where the project was built.
+#
+CMAKE_MINIMUM_REQUIRED(VERSION 3.10)
+
+SET(TEST_COMMAND)
+SET(IS_COMMAND OFF)
+FOREACH (ARGI RANGE 1 ${CMAKE_ARGC})
+    IF (ARGI LESS CMAKE_ARGC)
+        IF (IS_COMMAND)
+            LIST(APPEND TEST_COMMAND "${CMAKE_ARGV${ARGI}}")
+        ELSEIF ("${CMAKE_ARGV${ARGI}}" STREQUAL "--")
+            SET(IS_COMMAND ON)
+        ENDIF (IS_COMMAND)
+    ENDIF (ARGI LESS CMAKE_ARGC)
+ENDFOREACH (ARGI)
+IF (NOT TEST_COMMAND)
+    MESSAGE(FATAL_ERROR "no command given after --")
+ENDIF (NOT TEST_COMMAND)
+
+IF (SCRATCH)
+    FILE(REMOVE_RECURSE ${SCRATCH})
+    FILE(COPY ${SCRATCH_FROM}/ DESTINATION ${SCRATCH})
+    FOREACH (REMOVE_PATH ${SCRATCH_REMOVE})
+        FILE(REMOVE_RECURSE ${SCRATCH}/${REMOVE_PATH})
+    ENDFOREACH (REMOVE_PATH)
+ENDIF (SCRATCH)
+
+IF (SEED)
+    CMAKE_HOST_SYSTEM_INFORMATION(RESULT HOST QUERY HOSTNAME)
+    STRING(TIMESTAMP NOW "%s" UTC)
+    IF (NOT SEED_AGE)
+        SET(SEED_AGE 0)
+    ENDIF (NOT SEED_AGE)
+    MATH(EXPR THEN "${NOW} - ${SEED_AGE}")
+    CONFIGURE_FILE(${SEED_FROM} ${SEED} @ONLY)
+ENDIF (SEED)
+
+EXECUTE_PROCESS(COMMAND ${TEST_COMMAND} RESULT_VARIABLE TEST_RC OUTPUT_VARIABLE TEST_OUTPUT)
+IF (NOT TEST_RC EQUAL 0)
+    MESSAGE(FATAL_ERROR "command exited with ${TEST_RC}:\n${TEST_OUTPUT}")
+ENDIF (NOT TEST_RC EQUAL 0)
+IF (OUTPUT)
+    FILE(WRITE ${OUTPUT} "${TEST_OUTPUT}")
+ENDIF (OUTPUT)
+
+IF (EXPECTED)
+    FILE(READ ${EXPECTED} EXPECTED_OUTPUT)
+    IF (NOT TEST_OUTPUT STREQUAL EXPECTED_OUTPUT)
+        MESSAGE(FATAL_ERROR "output differs from ${EXPECTED}\n--- expected\n${EXPECTED_OUTPUT}--- actual\n${TEST_OUTPUT}")
+    ENDIF (NOT TEST_OUTPUT STREQUAL EXPECTED_OUTPUT)
+ENDIF (EXPECTED)
+
+IF (RESULT)
+    FILE(READ ${RESULT} RESULT_CONTENT)
+    IF (NOT RESULT_CONTENT MATCHES "${RESULT_REGEX}")
+        MESSAGE(FATAL_ERROR "${RESULT} does not match ${RESULT_REGEX}:\n${RESULT_CONTENT}")
+    ENDIF (NOT RESULT_CONTENT MATCHES "${RESULT_REGEX}")
+ENDIF (RESULT)